@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.jmh;
+
+import java.io.File;
+import java.io.IOException;
+
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioContext;
+
+/**
+ * What the benchmarks share: the files go to the directory on the bench.dir property, ./target by default,
+ * so a run can be pointed to the device to be measured.
+ */
+final class Benchmarks {
+
+   private Benchmarks() {
+   }
+
+   static void checkLoaded() {
+      if (!LibaioContext.isLoaded()) {
+         throw new IllegalStateException("the native library is not loaded, check java.library.path");
+      }
+   }
+
+   static File newFile(String prefix) throws IOException {
+      checkLoaded();
+      File directory = new File(System.getProperty("bench.dir", "./target"));
+      directory.mkdirs();
+      return File.createTempFile(prefix, ".bin", directory);
+   }
+}
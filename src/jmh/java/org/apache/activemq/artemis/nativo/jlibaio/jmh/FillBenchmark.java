@@ -0,0 +1,94 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.jmh;
+
+import java.io.File;
+import java.util.concurrent.TimeUnit;
+
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioContext;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioFile;
+import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Level;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.TearDown;
+import org.openjdk.jmh.annotations.Warmup;
+
+/**
+ * Time to preallocate a new file of size bytes, with the zero writes of fill and with fallocate.
+ * Every operation gets a new file.
+ */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.SingleShotTime)
+@OutputTimeUnit(TimeUnit.MILLISECONDS)
+@Warmup(iterations = 2, batchSize = 1)
+@Measurement(iterations = 10, batchSize = 1)
+@Fork(1)
+public class FillBenchmark {
+
+   @Param({"10485760", "104857600"})
+   public long size;
+
+   @Param({"true", "false"})
+   public boolean direct;
+
+   private LibaioContext<SubmitInfo> context;
+   private LibaioFile<SubmitInfo> file;
+   private File path;
+
+   @Setup(Level.Trial)
+   public void setupContext() {
+      Benchmarks.checkLoaded();
+      context = new LibaioContext<>(16, false, true);
+   }
+
+   @Setup(Level.Invocation)
+   public void setupFile() throws Exception {
+      path = Benchmarks.newFile("fill");
+      file = context.openFile(path, direct);
+   }
+
+   @Benchmark
+   public void fill() {
+      file.fill(4096, size);
+   }
+
+   @Benchmark
+   public void fallocate() {
+      file.fallocate(size);
+   }
+
+   @TearDown(Level.Invocation)
+   public void tearDownFile() throws Exception {
+      file.close();
+      path.delete();
+   }
+
+   @TearDown(Level.Trial)
+   public void tearDownContext() {
+      context.close();
+   }
+}
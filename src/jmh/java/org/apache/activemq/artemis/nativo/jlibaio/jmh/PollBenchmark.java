@@ -0,0 +1,124 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.jmh;
+
+import java.io.File;
+import java.nio.ByteBuffer;
+import java.util.concurrent.TimeUnit;
+
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioContext;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioFile;
+import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.TearDown;
+import org.openjdk.jmh.annotations.Warmup;
+
+/**
+ * Completion latency of a single 4 KiB write in flight, from the submit to the callback.
+ * <br>
+ * The poll benchmark reaps on the submitting thread, the blockedPoll one waits for the callback called by
+ * the blocked poller thread, as a journal would.
+ */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.SampleTime)
+@OutputTimeUnit(TimeUnit.MICROSECONDS)
+@Warmup(iterations = 3, time = 2)
+@Measurement(iterations = 5, time = 2)
+@Fork(1)
+public class PollBenchmark {
+
+   @Param({"true", "false"})
+   public boolean direct;
+
+   @Param({"false", "true"})
+   public boolean forceSyscall;
+
+   private LibaioContext<SubmitInfo> context;
+   private LibaioContext<SubmitInfo> blockedContext;
+   private LibaioFile<SubmitInfo> file;
+   private LibaioFile<SubmitInfo> blockedFile;
+   private File path;
+   private ByteBuffer buffer;
+   private Thread poller;
+   private final SubmitInfo[] callbacks = new SubmitInfo[1];
+
+   private volatile long completions;
+
+   private final SubmitInfo callback = new SubmitInfo() {
+      @Override
+      public void onError(int errno, String message) {
+         throw new IllegalStateException("write failed: " + message);
+      }
+
+      @Override
+      public void done() {
+         completions++;
+      }
+   };
+
+   @Setup
+   public void setup() throws Exception {
+      LibaioContext.setForceSyscall(forceSyscall);
+      context = new LibaioContext<>(1, false, true);
+      blockedContext = new LibaioContext<>(1, false, true);
+      path = Benchmarks.newFile("poll");
+      file = context.openFile(path, direct);
+      blockedFile = blockedContext.openFile(path, direct);
+      file.fill(4096, 4096L * 4096);
+      buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      poller = new Thread(blockedContext::poll, "blocked-poll");
+      poller.start();
+   }
+
+   @Benchmark
+   public void poll() throws Exception {
+      file.write(0, 4096, buffer, callback);
+      context.poll(callbacks, 1, 1);
+   }
+
+   @Benchmark
+   public void blockedPoll() throws Exception {
+      long expected = completions + 1;
+      blockedFile.write(0, 4096, buffer, callback);
+      while (completions != expected) {
+         Thread.onSpinWait();
+      }
+   }
+
+   @TearDown
+   public void tearDown() throws Exception {
+      file.close();
+      blockedFile.close();
+      context.close();
+      // it stops the blocked poll
+      blockedContext.close();
+      poller.join();
+      LibaioContext.freeBuffer(buffer);
+      LibaioContext.setForceSyscall(false);
+      path.delete();
+   }
+}
@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.jmh;
+
+import java.io.File;
+import java.nio.ByteBuffer;
+import java.util.concurrent.TimeUnit;
+
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioContext;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioFile;
+import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
+import org.openjdk.jmh.annotations.Benchmark;
+import org.openjdk.jmh.annotations.BenchmarkMode;
+import org.openjdk.jmh.annotations.Fork;
+import org.openjdk.jmh.annotations.Measurement;
+import org.openjdk.jmh.annotations.Mode;
+import org.openjdk.jmh.annotations.OutputTimeUnit;
+import org.openjdk.jmh.annotations.Param;
+import org.openjdk.jmh.annotations.Scope;
+import org.openjdk.jmh.annotations.Setup;
+import org.openjdk.jmh.annotations.State;
+import org.openjdk.jmh.annotations.TearDown;
+import org.openjdk.jmh.annotations.Warmup;
+
+/**
+ * Submit throughput of 4 KiB writes, keeping the queue full: each operation is one write, and the poll only
+ * reaps (at least one completion) once there is no space left on the queue.
+ * <br>
+ * forceSyscall reaps with io_getevents instead of the completion ring.
+ */
+@State(Scope.Benchmark)
+@BenchmarkMode(Mode.Throughput)
+@OutputTimeUnit(TimeUnit.SECONDS)
+@Warmup(iterations = 3, time = 2)
+@Measurement(iterations = 5, time = 2)
+@Fork(1)
+public class SubmitBenchmark {
+
+   @Param({"16", "64", "256", "1024"})
+   public int queueSize;
+
+   @Param({"true", "false"})
+   public boolean direct;
+
+   @Param({"false", "true"})
+   public boolean forceSyscall;
+
+   private LibaioContext<SubmitInfo> context;
+   private LibaioFile<SubmitInfo> file;
+   private File path;
+   private ByteBuffer buffer;
+   private SubmitInfo[] callbacks;
+   private int inFlight;
+   private long position;
+
+   private static final SubmitInfo CALLBACK = new SubmitInfo() {
+      @Override
+      public void onError(int errno, String message) {
+         throw new IllegalStateException("write failed: " + message);
+      }
+
+      @Override
+      public void done() {
+      }
+   };
+
+   @Setup
+   public void setup() throws Exception {
+      LibaioContext.setForceSyscall(forceSyscall);
+      context = new LibaioContext<>(queueSize, false, true);
+      path = Benchmarks.newFile("submit");
+      file = context.openFile(path, direct);
+      // the writes go over the same 16 MiB, allocated up front
+      file.fill(4096, 4096L * 4096);
+      buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      callbacks = new SubmitInfo[queueSize];
+   }
+
+   @Benchmark
+   public void write() throws Exception {
+      if (inFlight == queueSize) {
+         inFlight -= context.poll(callbacks, 1, queueSize);
+      }
+      file.write(position, 4096, buffer, CALLBACK);
+      position = (position + 4096) % (4096L * 4096);
+      inFlight++;
+   }
+
+   @TearDown
+   public void tearDown() throws Exception {
+      while (inFlight > 0) {
+         inFlight -= context.poll(callbacks, 1, queueSize);
+      }
+      file.close();
+      context.close();
+      LibaioContext.freeBuffer(buffer);
+      LibaioContext.setForceSyscall(false);
+      path.delete();
+   }
+}
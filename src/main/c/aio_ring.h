@@ -0,0 +1,85 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AIO_RING_H
+#define AIO_RING_H
+
+#include <string.h>
+#include <libaio.h>
+
+/*
+ * The completion ring libaio shares with the kernel, so events can be reaped on user space.
+ *
+ * The header has no JNI dependencies on purpose, so it can be used by the benchmarks under ./bench
+ */
+
+//These should be used to check if the user-space io_getevents is supported:
+//Linux ABI for the ring buffer: https://elixir.bootlin.com/linux/v4.20.13/source/fs/aio.c#L54
+//aio_read_events_ring: https://elixir.bootlin.com/linux/v4.20.13/source/fs/aio.c#L1148
+
+// NOTE: if the kernel ever updates the structure, the RING-MAGIC will change and the code will switch back to normal IO calls
+#define AIO_RING_MAGIC	0xa10a10a1
+#define AIO_RING_INCOMPAT_FEATURES	0
+
+/** There is no defined aio_ring anywhere in an include,
+    This is an implementation detail, that is a binary contract.
+    it is safe to use the feature though. */
+struct aio_ring {
+	unsigned	id;	/* kernel internal index number */
+	unsigned	nr;	/* number of io_events */
+	unsigned	head;
+	unsigned	tail;
+
+	unsigned	magic;
+	unsigned	compat_features;
+	unsigned	incompat_features;
+	unsigned	header_length;	/* size of aio_ring */
+
+
+	struct io_event		io_events[0];
+}; /* 128 bytes + ring size */
+
+// Check if the implementation supports AIO_RING by checking this number directly.
+static inline int has_usable_ring(struct aio_ring *ring) {
+    return ring->magic == AIO_RING_MAGIC && ring->incompat_features == AIO_RING_INCOMPAT_FEATURES;
+}
+
+// Newer versions of the kernel (newer here being a relative word, a couple years already at the time
+// I am writing this), will have io_context_t as an opaque type, and the real type being the aio_ring.
+static inline struct aio_ring* to_aio_ring(io_context_t aio_ctx) {
+    return (struct aio_ring*) aio_ctx;
+}
+
+/**
+ * Copies nr events starting at head: the span up to the end of the ring and the wrapped span, as at most two memcpy.
+ * nr can't be more than ring->nr, and the caller is the one publishing the new head after the copy.
+ * @return the new head
+ */
+static inline unsigned aio_ring_copy(struct aio_ring *ring, unsigned head, unsigned nr, struct io_event *events) {
+    const unsigned ring_nr = ring->nr;
+    const unsigned contiguous = ring_nr - head;
+    if (nr <= contiguous) {
+        memcpy(events, &ring->io_events[head], nr * sizeof(struct io_event));
+        head += nr;
+        return head == ring_nr ? 0 : head;
+    }
+    memcpy(events, &ring->io_events[head], contiguous * sizeof(struct io_event));
+    memcpy(events + contiguous, &ring->io_events[0], (nr - contiguous) * sizeof(struct io_event));
+    return nr - contiguous;
+}
+
+#endif
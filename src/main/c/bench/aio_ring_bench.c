@@ -0,0 +1,127 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+// Reap cost per event of the user space reaper.
+// A fake completion ring is drained the way ringio_get_events does it, as full as the kernel would leave it
+// (nr - 1 events), starting from a different head every time so most drains wrap.
+// The bulk copy is compared to the previous event by event loop with a modulo on wrapping drains.
+//
+// usage: aio-ring-bench [events per run]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <libaio.h>
+
+#include "aio_ring.h"
+
+static volatile unsigned long sink;
+
+/* The event by event copy, as it was used before aio_ring_copy */
+static unsigned loop_copy(struct aio_ring * ring, unsigned head, unsigned nr, struct io_event * events) {
+    const unsigned ring_nr = ring->nr;
+    const int needMod = ((head + nr) >= ring_nr) ? 1 : 0;
+    unsigned i;
+    for (i = 0; i < nr; i++) {
+        events[i] = ring->io_events[head];
+        if (needMod == 1) {
+            head = (head + 1) % ring_nr;
+        } else {
+            head = (head + 1);
+        }
+    }
+    return head;
+}
+
+static double run(int bulk, struct aio_ring * ring, struct io_event * events, long totalEvents) {
+    struct timespec start, end;
+    const unsigned drain = ring->nr - 1;
+    unsigned head = 0;
+    unsigned long check = 0;
+    long reaped = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (reaped < totalEvents) {
+        head = bulk ? aio_ring_copy(ring, head, drain, events) : loop_copy(ring, head, drain, events);
+        // touch what was reaped, as the poll loop would
+        check += (unsigned long) events[0].res + (unsigned long) events[drain - 1].res;
+        reaped += drain;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sink = check;
+
+    double nanos = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+    return nanos / (double) reaped;
+}
+
+static int verify(struct aio_ring * ring, struct io_event * bulkEvents, struct io_event * loopEvents) {
+    unsigned head;
+    for (head = 0; head < ring->nr; head += ring->nr / 8 + 1) {
+        unsigned nr = ring->nr - 1;
+        if (aio_ring_copy(ring, head, nr, bulkEvents) != loop_copy(ring, head, nr, loopEvents) ||
+            memcmp(bulkEvents, loopEvents, nr * sizeof(struct io_event)) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    long totalEvents = argc > 1 ? atol(argv[1]) : 100000000L;
+    unsigned sizes[] = {64, 1024, 65536};
+    int s;
+    unsigned i;
+
+    fprintf(stdout, "%ld events per run\n", totalEvents);
+    fprintf(stdout, "%8s %20s %20s %8s\n", "nr", "loop (ns/event)", "bulk (ns/event)", "gain");
+    for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        unsigned nr = sizes[s];
+        struct aio_ring * ring = calloc(1, sizeof(struct aio_ring) + nr * sizeof(struct io_event));
+        struct io_event * events = malloc(nr * sizeof(struct io_event));
+        struct io_event * loopEvents = malloc(nr * sizeof(struct io_event));
+        if (ring == NULL || events == NULL || loopEvents == NULL) {
+            fprintf(stderr, "not enough memory for a ring of %u events\n", nr);
+            return 1;
+        }
+        ring->nr = nr;
+        ring->magic = AIO_RING_MAGIC;
+        for (i = 0; i < nr; i++) {
+            ring->io_events[i].res = i;
+            ring->io_events[i].obj = (struct iocb *) (unsigned long) (i + 1);
+        }
+
+        if (verify(ring, events, loopEvents) != 0) {
+            fprintf(stderr, "the bulk copy doesn't match the loop for nr=%u\n", nr);
+            return 1;
+        }
+
+        double loop = run(0, ring, events, totalEvents);
+        double bulk = run(1, ring, events, totalEvents);
+        fprintf(stdout, "%8u %20.3f %20.3f %7.2fx\n", nr, loop, bulk, loop / bulk);
+        fflush(stdout);
+
+        free(loopEvents);
+        free(events);
+        free(ring);
+    }
+    return 0;
+}
@@ -0,0 +1,328 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+// End to end benchmark of the native hot paths, on a real file and without the JNI boundary
+// (that is measured by the JMH benchmarks under src/jmh).
+// Everything is run on a file opened with O_DIRECT and on a buffered one:
+//
+// - submit throughput of 4 KiB writes against the queue size, always keeping the queue full
+// - completion latency of a single write in flight, blocking on io_getevents (as blockedPoll does)
+//   and spinning on the completion ring (as poll does)
+// - reap cost per event, from the completion ring and with io_getevents (FORCE_SYSCALL)
+// - posix_memalign cost, as newAlignedBuffer does
+// - fill rate with 1 MiB zero writes (fill) and with fallocate
+//
+// The numbers depend on the device and the kernel, compare runs of the same machine only.
+//
+// usage: io-bench [directory] [writes per run]
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <libaio.h>
+
+#include "aio_ring.h"
+
+#define BLOCK 4096
+#define ONE_MEGA 1048576L
+#define FILL_SIZE (64 * ONE_MEGA)
+
+static char path[4096];
+
+static long nanoTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+static int openFile(int direct) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | (direct ? O_DIRECT : 0), 0666);
+    if (fd < 0) {
+        return -errno;
+    }
+    return fd;
+}
+
+/* Reaps up to max events from the completion ring, the same way ringio_get_events does it */
+static int ringReap(io_context_t ctx, int max, struct io_event * events) {
+    struct aio_ring * ring = to_aio_ring(ctx);
+    unsigned head = ring->head;
+    unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    unsigned available = tail >= head ? tail - head : ring->nr - head + tail;
+    if (available == 0) {
+        return 0;
+    }
+    if (available > (unsigned) max) {
+        available = (unsigned) max;
+    }
+    head = aio_ring_copy(ring, head, available, events);
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    return (int) available;
+}
+
+static int reap(io_context_t ctx, int useRing, int min, int max, struct io_event * events) {
+    if (!useRing) {
+        return io_getevents(ctx, min, max, events, NULL);
+    }
+    int reaped = 0;
+    while (reaped < min) {
+        reaped += ringReap(ctx, max - reaped, events + reaped);
+    }
+    return reaped;
+}
+
+/*
+ * Keeps depth writes in flight until writes are completed
+ * @return the writes per second, or -errno
+ */
+static double submitThroughput(int fd, int depth, long writes, int useRing, void * buffer, long * reapCalls) {
+    io_context_t ctx = NULL;
+    int res = io_queue_init(depth, &ctx);
+    if (res < 0) {
+        return res;
+    }
+    if (useRing && !has_usable_ring(to_aio_ring(ctx))) {
+        io_queue_release(ctx);
+        return -ENOTSUP;
+    }
+
+    struct iocb * iocbs = calloc((size_t) depth, sizeof(struct iocb));
+    struct iocb ** idle = malloc(sizeof(struct iocb *) * (size_t) depth);
+    struct io_event * events = malloc(sizeof(struct io_event) * (size_t) depth);
+    int idleCount = depth;
+    int i;
+    for (i = 0; i < depth; i++) {
+        idle[i] = &iocbs[i];
+    }
+
+    long submitted = 0, completed = 0, calls = 0;
+    long start = nanoTime();
+    while (completed < writes) {
+        // the top of the idle stack is submitted at once
+        int batch = writes - submitted < idleCount ? (int) (writes - submitted) : idleCount;
+        struct iocb ** next = &idle[idleCount - batch];
+        for (i = 0; i < batch; i++) {
+            // writing over the same 16 MiB, so the buffered runs are not just measuring the page cache growing
+            io_prep_pwrite(next[i], fd, buffer, BLOCK, ((submitted + i) % 4096) * BLOCK);
+        }
+        if (batch > 0) {
+            res = io_submit(ctx, batch, next);
+            if (res < 0) {
+                break;
+            }
+            // what the kernel didn't take stays idle
+            memmove(next, next + res, sizeof(struct iocb *) * (size_t) (batch - res));
+            idleCount -= res;
+            submitted += res;
+        }
+        int got = reap(ctx, useRing, 1, depth, events);
+        if (got < 0) {
+            res = got;
+            break;
+        }
+        calls++;
+        for (i = 0; i < got; i++) {
+            idle[idleCount++] = events[i].obj;
+        }
+        completed += got;
+    }
+    long elapsed = nanoTime() - start;
+
+    // nothing can be left in flight when the context is released
+    while (completed < submitted) {
+        int got = io_getevents(ctx, 1, depth, events, NULL);
+        if (got <= 0) {
+            break;
+        }
+        completed += got;
+    }
+
+    io_queue_release(ctx);
+    free(events);
+    free(idle);
+    free(iocbs);
+    if (res < 0) {
+        return res;
+    }
+    *reapCalls = calls;
+    return (double) writes * 1e9 / (double) elapsed;
+}
+
+/*
+ * A single write in flight at a time
+ * @return the average latency in nanoseconds, or -errno
+ */
+static double completionLatency(int fd, long writes, int useRing, void * buffer) {
+    io_context_t ctx = NULL;
+    struct iocb iocb;
+    struct iocb * iocbp = &iocb;
+    struct io_event event;
+    int res = io_queue_init(1, &ctx);
+    if (res < 0) {
+        return res;
+    }
+    if (useRing && !has_usable_ring(to_aio_ring(ctx))) {
+        io_queue_release(ctx);
+        return -ENOTSUP;
+    }
+
+    long i;
+    long start = nanoTime();
+    for (i = 0; i < writes; i++) {
+        io_prep_pwrite(&iocb, fd, buffer, BLOCK, (i % 4096) * BLOCK);
+        res = io_submit(ctx, 1, &iocbp);
+        if (res != 1) {
+            break;
+        }
+        res = reap(ctx, useRing, 1, 1, &event);
+        if (res != 1) {
+            break;
+        }
+    }
+    long elapsed = nanoTime() - start;
+    io_queue_release(ctx);
+    if (res < 0) {
+        return res;
+    }
+    return (double) elapsed / (double) writes;
+}
+
+static double alignedAllocation(size_t size, long count) {
+    long i;
+    long start = nanoTime();
+    for (i = 0; i < count; i++) {
+        void * buffer;
+        if (posix_memalign(&buffer, BLOCK, size) != 0) {
+            return -ENOMEM;
+        }
+        // newAlignedBuffer zeroes what it allocates
+        memset(buffer, 0, size);
+        free(buffer);
+    }
+    return (double) (nanoTime() - start) / (double) count;
+}
+
+/*
+ * @return MiB/s of filling FILL_SIZE with zero writes, or with fallocate if zeroes is NULL
+ */
+static double fillRate(int fd, void * zeroes) {
+    long start = nanoTime();
+    if (zeroes != NULL) {
+        long position;
+        for (position = 0; position < FILL_SIZE; position += ONE_MEGA) {
+            if (pwrite(fd, zeroes, ONE_MEGA, position) < 0) {
+                return -errno;
+            }
+        }
+    } else if (fallocate(fd, 0, 0, FILL_SIZE) < 0) {
+        return -errno;
+    }
+    if (fsync(fd) < 0) {
+        return -errno;
+    }
+    double elapsed = (double) (nanoTime() - start);
+    // so the next fill allocates the blocks again
+    if (ftruncate(fd, 0) < 0) {
+        return -errno;
+    }
+    return (double) FILL_SIZE / ONE_MEGA * 1e9 / elapsed;
+}
+
+static void report(const char * name, const char * unit, double value) {
+    if (value < 0) {
+        fprintf(stdout, "%-40s %16s (%s)\n", name, "-", strerror((int) -value));
+    } else {
+        fprintf(stdout, "%-40s %16.1f %s\n", name, value, unit);
+    }
+    fflush(stdout);
+}
+
+static void run(int direct, long writes, void * buffer, void * zeroes) {
+    int depths[] = {16, 64, 256, 1024};
+    char name[64];
+    int fd = openFile(direct);
+    int d;
+
+    fprintf(stdout, "\n%s\n", direct ? "O_DIRECT" : "buffered");
+    if (fd < 0) {
+        report("open", "", fd);
+        return;
+    }
+
+    for (d = 0; d < (int) (sizeof(depths) / sizeof(depths[0])); d++) {
+        long ringCalls = 0, syscallCalls = 0;
+        double ring = submitThroughput(fd, depths[d], writes, 1, buffer, &ringCalls);
+        double syscall = submitThroughput(fd, depths[d], writes, 0, buffer, &syscallCalls);
+        snprintf(name, sizeof(name), "submit queue=%d, ring reap", depths[d]);
+        report(name, "writes/s", ring);
+        if (ring > 0 && ringCalls > 0) {
+            snprintf(name, sizeof(name), "  events per reap");
+            report(name, "", (double) writes / (double) ringCalls);
+        }
+        snprintf(name, sizeof(name), "submit queue=%d, io_getevents", depths[d]);
+        report(name, "writes/s", syscall);
+        if (syscall > 0 && syscallCalls > 0) {
+            snprintf(name, sizeof(name), "  events per reap");
+            report(name, "", (double) writes / (double) syscallCalls);
+        }
+    }
+
+    long latencyWrites = writes / 10 > 0 ? writes / 10 : 1;
+    report("latency, spinning on the ring (poll)", "ns", completionLatency(fd, latencyWrites, 1, buffer));
+    report("latency, io_getevents (blockedPoll)", "ns", completionLatency(fd, latencyWrites, 0, buffer));
+
+    report("fill, 1 MiB zero writes", "MiB/s", fillRate(fd, zeroes));
+    report("fill, fallocate", "MiB/s", fillRate(fd, NULL));
+
+    close(fd);
+}
+
+int main(int argc, char ** argv) {
+    const char * directory = argc > 1 ? argv[1] : ".";
+    long writes = argc > 2 ? atol(argv[2]) : 100000L;
+    void * buffer;
+    void * zeroes;
+
+    snprintf(path, sizeof(path), "%s/io-bench-%d.bin", directory, (int) getpid());
+    if (posix_memalign(&buffer, BLOCK, BLOCK) != 0 || posix_memalign(&zeroes, BLOCK, ONE_MEGA) != 0) {
+        fprintf(stderr, "not enough memory for the buffers\n");
+        return 1;
+    }
+    memset(buffer, 'a', BLOCK);
+    memset(zeroes, 0, ONE_MEGA);
+
+    fprintf(stdout, "%s, %ld writes per run\n", path, writes);
+    report("posix_memalign 4 KiB", "ns", alignedAllocation(BLOCK, 100000));
+    report("posix_memalign 64 KiB", "ns", alignedAllocation(64 * 1024, 100000));
+    report("posix_memalign 1 MiB", "ns", alignedAllocation(ONE_MEGA, 10000));
+
+    run(1, writes, buffer, zeroes);
+    run(0, writes, buffer, zeroes);
+
+    unlink(path);
+    free(zeroes);
+    free(buffer);
+    return 0;
+}
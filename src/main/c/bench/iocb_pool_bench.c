@@ -0,0 +1,224 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+// Contention benchmark for the iocb pool.
+// Each thread behaves like a submitter: it takes a few iocbs from the pool and puts them back, the same way
+// submitWrite / blockedPoll would do. The lock free pool is compared to the previous mutex protected ring.
+// It also measures the cost of creating and destroying the pool, slab versus one malloc per iocb.
+//
+// usage: iocb-pool-bench [queueSize] [seconds per run]
+
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <libaio.h>
+
+#include "iocb_pool.h"
+
+#define BURST 8
+
+static volatile int running;
+
+/* The mutex protected ring, as it was used before the lock free pool */
+struct mutex_pool {
+    pthread_mutex_t lock;
+    struct iocb ** iocb;
+    int queueSize;
+    int iocbPut;
+    int iocbGet;
+    int used;
+};
+
+static struct iocb * mutex_pool_get(struct mutex_pool * pool) {
+    struct iocb * iocb = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->used < pool->queueSize) {
+        pool->used++;
+        iocb = pool->iocb[pool->iocbGet++];
+        if (pool->iocbGet >= pool->queueSize) {
+            pool->iocbGet = 0;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return iocb;
+}
+
+static void mutex_pool_put(struct mutex_pool * pool, struct iocb * iocb) {
+    pthread_mutex_lock(&pool->lock);
+    pool->used--;
+    pool->iocb[pool->iocbPut++] = iocb;
+    if (pool->iocbPut >= pool->queueSize) {
+        pool->iocbPut = 0;
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+struct worker {
+    pthread_t thread;
+    int lockFree;
+    void * pool;
+    long operations;
+};
+
+static void * run_worker(void * arg) {
+    struct worker * worker = (struct worker *) arg;
+    struct iocb * taken[BURST];
+    long operations = 0;
+    int i, n;
+
+    while (running) {
+        for (n = 0; n < BURST; n++) {
+            taken[n] = worker->lockFree ? iocb_pool_get((struct iocb_pool *) worker->pool) : mutex_pool_get((struct mutex_pool *) worker->pool);
+            if (taken[n] == NULL) {
+                break;
+            }
+        }
+        for (i = 0; i < n; i++) {
+            if (worker->lockFree) {
+                iocb_pool_put((struct iocb_pool *) worker->pool, taken[i]);
+            } else {
+                mutex_pool_put((struct mutex_pool *) worker->pool, taken[i]);
+            }
+        }
+        operations += n;
+    }
+
+    worker->operations = operations;
+    return NULL;
+}
+
+static double run(int lockFree, void * pool, int threads, int seconds) {
+    struct worker * workers = calloc((size_t)threads, sizeof(struct worker));
+    struct timespec start, end;
+    long total = 0;
+    int i;
+
+    running = 1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threads; i++) {
+        workers[i].lockFree = lockFree;
+        workers[i].pool = pool;
+        pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+    }
+
+    sleep((unsigned)seconds);
+    running = 0;
+
+    for (i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        total += workers[i].operations;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    free(workers);
+
+    double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    return (double) total / elapsed;
+}
+
+static double elapsed_micros(struct timespec * start, struct timespec * end) {
+    return (double)(end->tv_sec - start->tv_sec) * 1e6 + (double)(end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static void run_lifecycle(int queueSize) {
+    struct timespec start, end;
+    struct iocb_pool pool;
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct iocb ** iocbs = malloc(sizeof(struct iocb *) * (size_t)queueSize);
+    for (i = 0; i < queueSize; i++) {
+        iocbs[i] = malloc(sizeof(struct iocb));
+    }
+    for (i = 0; i < queueSize; i++) {
+        free(iocbs[i]);
+    }
+    free(iocbs);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double mallocs = elapsed_micros(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (iocb_pool_init(&pool, queueSize, -1, 0) == 0) {
+        iocb_pool_destroy(&pool);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double slab = elapsed_micros(&start, &end);
+
+    fprintf(stdout, "%8d %20.1f %20.1f\n", queueSize, mallocs, slab);
+}
+
+int main(int argc, char ** argv) {
+    int queueSize = argc > 1 ? atoi(argv[1]) : 4096;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    int threadCounts[] = {1, 4, 16};
+    int t, i;
+
+    struct iocb_pool lockFreePool;
+    if (iocb_pool_init(&lockFreePool, queueSize, -1, 0)) {
+        fprintf(stderr, "could not initialize the pool\n");
+        return 1;
+    }
+
+    // the mutex ring uses individually allocated iocbs, as it used to be
+    struct mutex_pool mutexPool;
+    pthread_mutex_init(&mutexPool.lock, 0);
+    mutexPool.iocb = malloc(sizeof(struct iocb *) * (size_t)queueSize);
+    if (mutexPool.iocb == NULL) {
+        fprintf(stderr, "not enough memory for %d iocbs\n", queueSize);
+        return 1;
+    }
+    for (i = 0; i < queueSize; i++) {
+        mutexPool.iocb[i] = malloc(sizeof(struct iocb));
+    }
+    mutexPool.queueSize = queueSize;
+    mutexPool.iocbPut = 0;
+    mutexPool.iocbGet = 0;
+    mutexPool.used = 0;
+
+    fprintf(stdout, "queueSize=%d, %d seconds per run, burst=%d\n", queueSize, seconds, BURST);
+    fprintf(stdout, "%8s %20s %20s %8s\n", "threads", "mutex (ops/s)", "lock free (ops/s)", "gain");
+    for (t = 0; t < (int)(sizeof(threadCounts) / sizeof(threadCounts[0])); t++) {
+        double mutexOps = run(0, &mutexPool, threadCounts[t], seconds);
+        double lockFreeOps = run(1, &lockFreePool, threadCounts[t], seconds);
+        fprintf(stdout, "%8d %20.0f %20.0f %7.2fx\n", threadCounts[t], mutexOps, lockFreeOps, lockFreeOps / mutexOps);
+        fflush(stdout);
+    }
+
+    int lifecycleSizes[] = {1024, 4096, 65536};
+    fprintf(stdout, "\n%8s %20s %20s\n", "iocbs", "mallocs (us)", "slab (us)");
+    for (t = 0; t < (int)(sizeof(lifecycleSizes) / sizeof(lifecycleSizes[0])); t++) {
+        run_lifecycle(lifecycleSizes[t]);
+    }
+
+    if (iocb_pool_used(&lockFreePool) != 0 || mutexPool.used != 0) {
+        fprintf(stderr, "pool accounting is broken: lock free used=%d, mutex used=%d\n", iocb_pool_used(&lockFreePool), mutexPool.used);
+        return 1;
+    }
+
+    iocb_pool_destroy(&lockFreePool);
+    pthread_mutex_destroy(&mutexPool.lock);
+    for (i = 0; i < queueSize; i++) {
+        free(mutexPool.iocb[i]);
+    }
+    free(mutexPool.iocb);
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "numa_node.h"
+
+/*
+ * A pool of aligned buffers, for O_DIRECT.
+ *
+ * Buffers are grouped in power of 2 size classes, starting at the alignment.
+ * Each class has its own free list, so buffers of different sizes don't contend with each other.
+ * A class with buffers smaller than a slab is refilled by carving a whole slab (2MB, the size of a huge page)
+ * into buffers, bigger buffers take a slab each.
+ * Slabs are only given back to the system when the pool is destroyed.
+ * Every slab belongs to a class, and it knows which of its buffers are outstanding, so a release of a buffer that
+ * is not outstanding on the pool (from somewhere else, a slice, or released twice) is refused.
+ *
+ * When using huge pages the slabs are mapped with MAP_HUGETLB, or with madvise(MADV_HUGEPAGE) if there are no huge pages reserved.
+ * The slabs of a pool with a NUMA node prefer the pages of that node.
+ * Mapped memory is zeroed by the kernel; when BUFFER_POOL_ZERO is set buffers are also zeroed every time they are acquired.
+ *
+ * The header has no JNI dependencies on purpose, so it can be used by the benchmarks under ./bench
+ */
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+
+// back the slabs with huge pages
+#define BUFFER_POOL_HUGE_PAGES 1
+// zero the buffers when they are acquired
+#define BUFFER_POOL_ZERO 2
+
+#define BUFFER_POOL_SLAB_SIZE (2 * 1024 * 1024)
+
+// up to 1GB buffers
+#define BUFFER_POOL_MAX_SHIFT 30
+
+struct buffer_pool_slab {
+    char * memory;
+    size_t size;
+    int mapped;
+    // one per buffer of the slab, 1 while it is outstanding
+    unsigned char * outstanding;
+};
+
+struct buffer_pool_class {
+    pthread_mutex_t lock;
+    void ** free;
+    int freeCount;
+    int freeCapacity;
+    // the slabs of the class sorted by address, for the lookup of released buffers
+    struct buffer_pool_slab ** slabs;
+    int slabCount;
+    int slabCapacity;
+};
+
+struct buffer_pool {
+    size_t alignment;
+    int minShift;
+    int flags;
+    // the NUMA node of the slabs, or -1
+    int node;
+
+    // the lock of a class also guards its slabs
+    struct buffer_pool_class classes[BUFFER_POOL_MAX_SHIFT + 1];
+
+    // bytes given to the users, bytes waiting on the free lists, and bytes reserved from the system
+    long outstandingBytes;
+    long pooledBytes;
+    long reservedBytes;
+};
+
+/**
+ * @param node the NUMA node of the slabs, -1 for no preference
+ * @return 0 if OK, -1 on an invalid alignment or if it could not initialize the locks
+ */
+static inline int buffer_pool_init(struct buffer_pool * pool, size_t alignment, int flags, int node) {
+    int i;
+
+    // the alignment needs to be a power of 2
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > BUFFER_POOL_SLAB_SIZE) {
+        return -1;
+    }
+
+    memset(pool, 0, sizeof(struct buffer_pool));
+    pool->alignment = alignment;
+    pool->flags = flags;
+    pool->node = node;
+    while (((size_t)1 << pool->minShift) < alignment) {
+        pool->minShift++;
+    }
+
+    for (i = 0; i <= BUFFER_POOL_MAX_SHIFT; i++) {
+        if (pthread_mutex_init(&pool->classes[i].lock, 0)) {
+            while (--i >= 0) {
+                pthread_mutex_destroy(&pool->classes[i].lock);
+            }
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Releases all the memory of the pool, including the buffers that were not released back.
+ */
+static inline void buffer_pool_destroy(struct buffer_pool * pool) {
+    int i, j;
+
+    for (i = 0; i <= BUFFER_POOL_MAX_SHIFT; i++) {
+        struct buffer_pool_class * bufferClass = &pool->classes[i];
+        for (j = 0; j < bufferClass->slabCount; j++) {
+            struct buffer_pool_slab * slab = bufferClass->slabs[j];
+            if (slab->mapped) {
+                munmap(slab->memory, slab->size);
+            } else {
+                free(slab->memory);
+            }
+            free(slab->outstanding);
+            free(slab);
+        }
+        free(bufferClass->slabs);
+        bufferClass->slabs = NULL;
+        bufferClass->slabCount = 0;
+        free(bufferClass->free);
+        bufferClass->free = NULL;
+        pthread_mutex_destroy(&bufferClass->lock);
+    }
+}
+
+/**
+ * @return the size class for size, or -1 if it's too big to be pooled
+ */
+static inline int buffer_pool_class_of(struct buffer_pool * pool, size_t size) {
+    int shift = pool->minShift;
+    while (((size_t)1 << shift) < size) {
+        shift++;
+        if (shift > BUFFER_POOL_MAX_SHIFT) {
+            return -1;
+        }
+    }
+    return shift;
+}
+
+/**
+ * The slab of bufferClass holding buffer, it needs to be called holding the lock of the class
+ * @return the slab, or NULL if buffer is not on any of them
+ */
+static inline struct buffer_pool_slab * buffer_pool_slab_of(struct buffer_pool_class * bufferClass, void * buffer) {
+    int low = 0;
+    int high = bufferClass->slabCount - 1;
+    char * address = (char *) buffer;
+
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        struct buffer_pool_slab * slab = bufferClass->slabs[middle];
+        if (address < slab->memory) {
+            high = middle - 1;
+        } else if (address >= slab->memory + slab->size) {
+            low = middle + 1;
+        } else {
+            return slab;
+        }
+    }
+    return NULL;
+}
+
+// it needs to be called holding the lock of the class
+static inline int buffer_pool_add_slab(struct buffer_pool_class * bufferClass, struct buffer_pool_slab * slab) {
+    int i;
+    if (bufferClass->slabCount == bufferClass->slabCapacity) {
+        int capacity = bufferClass->slabCapacity == 0 ? 16 : bufferClass->slabCapacity * 2;
+        struct buffer_pool_slab ** newSlabs = (struct buffer_pool_slab **) realloc(bufferClass->slabs, sizeof(struct buffer_pool_slab *) * (size_t) capacity);
+        if (newSlabs == NULL) {
+            return -1;
+        }
+        bufferClass->slabs = newSlabs;
+        bufferClass->slabCapacity = capacity;
+    }
+    for (i = bufferClass->slabCount; i > 0 && bufferClass->slabs[i - 1]->memory > slab->memory; i--) {
+        bufferClass->slabs[i] = bufferClass->slabs[i - 1];
+    }
+    bufferClass->slabs[i] = slab;
+    bufferClass->slabCount++;
+    return 0;
+}
+
+/**
+ * Reserves a slab of size bytes for the class shift, it needs to be called holding the lock of the class
+ * @return the slab, all of its buffers not outstanding, or NULL if there is no memory
+ */
+static inline struct buffer_pool_slab * buffer_pool_reserve(struct buffer_pool * pool, int shift, size_t size) {
+    struct buffer_pool_slab * slab = (struct buffer_pool_slab *) malloc(sizeof(struct buffer_pool_slab));
+    void * memory = NULL;
+    if (slab == NULL) {
+        return NULL;
+    }
+    slab->outstanding = (unsigned char *) calloc(size >> shift, 1);
+    if (slab->outstanding == NULL) {
+        free(slab);
+        return NULL;
+    }
+
+    slab->mapped = 0;
+    if ((pool->flags & BUFFER_POOL_HUGE_PAGES) && pool->alignment <= (size_t) sysconf(_SC_PAGESIZE)) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            // no huge pages reserved on the system, transparent huge pages are the next best thing
+            memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory != MAP_FAILED) {
+                madvise(memory, size, MADV_HUGEPAGE);
+            }
+        }
+        if (memory == MAP_FAILED) {
+            memory = NULL;
+        } else {
+            slab->mapped = 1;
+        }
+    }
+
+    if (memory == NULL && posix_memalign(&memory, pool->alignment, size) != 0) {
+        memory = NULL;
+    }
+
+    slab->memory = (char *) memory;
+    slab->size = size;
+
+    if (memory == NULL || buffer_pool_add_slab(&pool->classes[shift], slab) != 0) {
+        if (memory != NULL && slab->mapped) {
+            munmap(memory, size);
+        } else {
+            free(memory);
+        }
+        free(slab->outstanding);
+        free(slab);
+        return NULL;
+    }
+
+    if (pool->node >= 0) {
+        // before the buffers are carved, the pages of a fresh slab are not touched yet
+        numa_node_bind(memory, size, pool->node);
+    }
+
+    __atomic_add_fetch(&pool->reservedBytes, (long) size, __ATOMIC_RELAXED);
+    return slab;
+}
+
+// it needs to be called holding the lock of the class
+static inline int buffer_pool_push(struct buffer_pool_class * bufferClass, void * buffer) {
+    if (bufferClass->freeCount == bufferClass->freeCapacity) {
+        int capacity = bufferClass->freeCapacity == 0 ? 16 : bufferClass->freeCapacity * 2;
+        void ** newFree = (void **) realloc(bufferClass->free, sizeof(void *) * (size_t) capacity);
+        if (newFree == NULL) {
+            return -1;
+        }
+        bufferClass->free = newFree;
+        bufferClass->freeCapacity = capacity;
+    }
+    bufferClass->free[bufferClass->freeCount++] = buffer;
+    return 0;
+}
+
+/**
+ * @return an aligned buffer with at least size bytes, or NULL if there is no memory or the size is too big
+ */
+static inline void * buffer_pool_acquire(struct buffer_pool * pool, size_t size) {
+    int shift = buffer_pool_class_of(pool, size);
+    void * buffer = NULL;
+    int i;
+
+    if (shift < 0) {
+        return NULL;
+    }
+
+    size_t classSize = (size_t)1 << shift;
+    struct buffer_pool_class * bufferClass = &pool->classes[shift];
+
+    pthread_mutex_lock(&bufferClass->lock);
+    if (bufferClass->freeCount > 0) {
+        buffer = bufferClass->free[--bufferClass->freeCount];
+        struct buffer_pool_slab * slab = buffer_pool_slab_of(bufferClass, buffer);
+        slab->outstanding[((char *) buffer - slab->memory) >> shift] = 1;
+        __atomic_sub_fetch(&pool->pooledBytes, (long) classSize, __ATOMIC_RELAXED);
+    } else if (classSize < BUFFER_POOL_SLAB_SIZE) {
+        struct buffer_pool_slab * slab = buffer_pool_reserve(pool, shift, BUFFER_POOL_SLAB_SIZE);
+        if (slab != NULL) {
+            int count = (int) (BUFFER_POOL_SLAB_SIZE / classSize);
+            buffer = slab->memory;
+            slab->outstanding[0] = 1;
+            // the rest of the slab goes to the free list
+            for (i = count - 1; i >= 1; i--) {
+                if (buffer_pool_push(bufferClass, slab->memory + classSize * (size_t) i) != 0) {
+                    break;
+                }
+                __atomic_add_fetch(&pool->pooledBytes, (long) classSize, __ATOMIC_RELAXED);
+            }
+        }
+    } else {
+        struct buffer_pool_slab * slab = buffer_pool_reserve(pool, shift, classSize);
+        if (slab != NULL) {
+            buffer = slab->memory;
+            slab->outstanding[0] = 1;
+        }
+    }
+    pthread_mutex_unlock(&bufferClass->lock);
+
+    if (buffer == NULL) {
+        return NULL;
+    }
+
+    __atomic_add_fetch(&pool->outstandingBytes, (long) classSize, __ATOMIC_RELAXED);
+
+    if (pool->flags & BUFFER_POOL_ZERO) {
+        memset(buffer, 0, size);
+    }
+
+    return buffer;
+}
+
+/**
+ * Gives a buffer back to the pool, size is the same size used to acquire it.
+ * @return 0 if OK, -1 if it could not be pooled, -2 if it is not an outstanding buffer of this pool
+ */
+static inline int buffer_pool_release(struct buffer_pool * pool, void * buffer, size_t size) {
+    int shift = buffer_pool_class_of(pool, size);
+    int result;
+    if (shift < 0 || buffer == NULL) {
+        return -2;
+    }
+
+    size_t classSize = (size_t)1 << shift;
+    struct buffer_pool_class * bufferClass = &pool->classes[shift];
+
+    pthread_mutex_lock(&bufferClass->lock);
+    struct buffer_pool_slab * slab = buffer_pool_slab_of(bufferClass, buffer);
+    size_t offset = slab == NULL ? 0 : (size_t) ((char *) buffer - slab->memory);
+    if (slab == NULL || (offset & (classSize - 1)) != 0 || !slab->outstanding[offset >> shift]) {
+        pthread_mutex_unlock(&bufferClass->lock);
+        return -2;
+    }
+    slab->outstanding[offset >> shift] = 0;
+    result = buffer_pool_push(bufferClass, buffer);
+    pthread_mutex_unlock(&bufferClass->lock);
+
+    // even if there was no memory for the free list the buffer is not outstanding any longer, it will be released on destroy
+    __atomic_sub_fetch(&pool->outstandingBytes, (long) classSize, __ATOMIC_RELAXED);
+    if (result == 0) {
+        __atomic_add_fetch(&pool->pooledBytes, (long) classSize, __ATOMIC_RELAXED);
+    }
+    return result;
+}
+
+#endif
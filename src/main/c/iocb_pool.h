@@ -0,0 +1,328 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IOCB_POOL_H
+#define IOCB_POOL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <libaio.h>
+
+#include "locked_memory.h"
+
+/*
+ * A lock free pool of iocbs.
+ *
+ * This is a bounded multi-producer / multi-consumer queue (Dmitry Vyukov's design):
+ * every cell has a sequence number that tells producers and consumers whether the cell is ready for them,
+ * so getIOCB (submitting threads) and putIOCB (the poller) only need a CAS on their own position.
+ *
+ * The capacity is rounded up to a power of 2, and since the pool never holds more iocbs than queueSize
+ * a put can never find the queue full.
+ *
+ * The used counter is the admission control: an iocb is reserved on it before being taken out of the queue,
+ * so a get never fails because a concurrent put has claimed a cell but not yet published it.
+ *
+ * All the iocbs are carved out of a single cache aligned slab, one slot per iocb.
+ * A slot is padded to the cache line so the producers and the poller never touch the same line
+ * when working on neighbouring iocbs, and it can be extended with per iocb state.
+ *
+ * The header has no JNI dependencies on purpose, so it can be used by the benchmarks under ./bench
+ */
+
+#define IOCB_POOL_CACHE_LINE 64
+
+// linux/fs.h is not included as it conflicts with sys/mount.h on some distributions
+#ifndef RWF_DSYNC
+#define RWF_DSYNC 0x00000002
+#endif
+
+// libaio before 0.3.111 didn't name the rw flags of the iocb, they are in the same place
+#ifdef HAVE_AIO_RW_FLAGS
+#define iocb_rw_flags(iocb) ((iocb)->aio_rw_flags)
+#else
+#define iocb_rw_flags(iocb) ((iocb)->__pad2)
+#endif
+
+// how many times we spin on a cell that is about to be published before yielding the CPU
+#define IOCB_POOL_SPINS 64
+
+// the write was asked to be durable but RWF_DSYNC is not available, it needs a fdatasync before its completion is released
+#define IOCB_SLOT_SYNC 1
+
+// a zero write of a fill, iocb->data points to its fill_control and it is never delivered to the Java side
+#define IOCB_SLOT_FILL 2
+
+// submitNanos was taken when the iocb was submitted, the completion goes to the stats of the context
+#define IOCB_SLOT_TIMED 4
+
+// the iocb holds an in flight slot of the limit of its file, given back when the iocb goes back to the pool
+#define IOCB_SLOT_LIMITED 8
+
+// the completion is delivered in the order of sequence, on a context with ordered delivery
+#define IOCB_SLOT_ORDERED 16
+
+// a stage of a chain, iocb->data points to its chain_control and it is never delivered to the Java side
+#define IOCB_SLOT_CHAIN 32
+
+// a vectored submit keeps its iovecs in the slot; 3 of them still fit on the 2 cache lines of a slot
+#define IOCB_SLOT_IOVECS 3
+
+/* the iocb has to be the first member, as the kernel gives us back the iocb pointer on the completion */
+struct iocb_slot {
+    struct iocb iocb;
+    // IOCB_SLOT_ flags, cleared when the iocb goes back to the pool
+    int flags;
+    // the submit order, for IOCB_SLOT_ORDERED. It takes the padding before submitNanos, the slot stays on 2 cache lines
+    unsigned sequence;
+    // CLOCK_MONOTONIC at submit, for IOCB_SLOT_TIMED
+    long submitNanos;
+    // used by IO_CMD_PWRITEV / IO_CMD_PREADV, so nothing is allocated per submit
+    struct iovec iovecs[IOCB_SLOT_IOVECS];
+} __attribute__((aligned(IOCB_POOL_CACHE_LINE)));
+
+static inline struct iocb_slot * iocb_slot_of(struct iocb * iocb) {
+    return (struct iocb_slot *) iocb;
+}
+
+struct iocb_pool_cell {
+    unsigned long sequence;
+    struct iocb * iocb;
+};
+
+struct iocb_pool {
+    struct iocb_slot * slots;
+    // the mapping of the slots when they are on huge pages, otherwise they were allocated with posix_memalign
+    struct locked_memory slabMemory;
+    struct iocb_pool_cell * cells;
+    unsigned long mask;
+    int size;
+
+    // the positions and the used counter are written by different threads, they are kept on different cache lines
+    char pad0[IOCB_POOL_CACHE_LINE];
+    unsigned long putPosition;
+    char pad1[IOCB_POOL_CACHE_LINE - sizeof(unsigned long)];
+    unsigned long getPosition;
+    char pad2[IOCB_POOL_CACHE_LINE - sizeof(unsigned long)];
+    int used;
+    char pad3[IOCB_POOL_CACHE_LINE - sizeof(int)];
+};
+
+static inline void iocb_pool_destroy_slab(struct iocb_pool * pool) {
+    if (pool->slabMemory.memory != NULL) {
+        locked_memory_unmap(&pool->slabMemory);
+    } else {
+        free(pool->slots);
+    }
+    pool->slots = NULL;
+}
+
+/**
+ * Initializes the pool with size iocbs allocated on a single slab, all of them available.
+ * @param node      the NUMA node of the slab and the queue, -1 for no preference
+ * @param hugePages the slab is mapped on huge pages, prefaulted and locked, see locked_memory.h
+ * @return 0 if OK, -1 if it could not allocate memory
+ */
+static inline int iocb_pool_init(struct iocb_pool * pool, int size, int node, int hugePages) {
+    unsigned long capacity = 1;
+    unsigned long i;
+    void * slab;
+
+    while (capacity < (unsigned long)size) {
+        capacity <<= 1;
+    }
+
+    memset(&pool->slabMemory, 0, sizeof(struct locked_memory));
+    if (hugePages) {
+        // zeroed by the kernel
+        if (locked_memory_map(&pool->slabMemory, sizeof(struct iocb_slot) * (size_t)size, node) != 0) {
+            return -1;
+        }
+        slab = pool->slabMemory.memory;
+    } else {
+        if (numa_node_memalign(&slab, IOCB_POOL_CACHE_LINE, sizeof(struct iocb_slot) * (size_t)size, node) != 0) {
+            return -1;
+        }
+        memset(slab, 0, sizeof(struct iocb_slot) * (size_t)size);
+    }
+    pool->slots = (struct iocb_slot *) slab;
+
+    if (numa_node_memalign(&slab, IOCB_POOL_CACHE_LINE, sizeof(struct iocb_pool_cell) * capacity, node) != 0) {
+        iocb_pool_destroy_slab(pool);
+        return -1;
+    }
+    pool->cells = (struct iocb_pool_cell *) slab;
+
+    pool->mask = capacity - 1;
+    pool->size = size;
+
+    for (i = 0; i < capacity; i++) {
+        if (i < (unsigned long)size) {
+            // this cell is already written, ready to be consumed at position i
+            pool->cells[i].sequence = i + 1;
+            pool->cells[i].iocb = &(pool->slots[i].iocb);
+        } else {
+            pool->cells[i].sequence = i;
+            pool->cells[i].iocb = NULL;
+        }
+    }
+
+    pool->putPosition = (unsigned long)size;
+    pool->getPosition = 0;
+    pool->used = 0;
+
+    return 0;
+}
+
+/**
+ * Releases the queue and the slab with all the iocbs
+ */
+static inline void iocb_pool_destroy(struct iocb_pool * pool) {
+    free(pool->cells);
+    pool->cells = NULL;
+    iocb_pool_destroy_slab(pool);
+}
+
+/**
+ * Reserves count iocbs on the used counter. returns 0 if there isn't enough of them.
+ */
+static inline int iocb_pool_reserve(struct iocb_pool * pool, int count) {
+    int used = __atomic_load_n(&pool->used, __ATOMIC_RELAXED);
+    do {
+        if (used + count > pool->size) {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&pool->used, &used, used + count, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return 1;
+}
+
+/**
+ * Takes an iocb out of the queue. It must have been reserved before, so it will always find one.
+ */
+static inline struct iocb * iocb_pool_take(struct iocb_pool * pool) {
+    struct iocb_pool_cell * cell;
+    unsigned long position = __atomic_load_n(&pool->getPosition, __ATOMIC_RELAXED);
+    int spins = 0;
+
+    for (;;) {
+        cell = &pool->cells[position & pool->mask];
+        unsigned long sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        long diff = (long) sequence - (long) (position + 1);
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->getPosition, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // position was updated by the failed CAS
+        } else if (diff < 0) {
+            // a put has the cell but didn't publish it yet, it will be there soon as we have a reservation
+            if (++spins >= IOCB_POOL_SPINS) {
+                spins = 0;
+                sched_yield();
+            }
+            position = __atomic_load_n(&pool->getPosition, __ATOMIC_RELAXED);
+        } else {
+            position = __atomic_load_n(&pool->getPosition, __ATOMIC_RELAXED);
+        }
+    }
+
+    struct iocb * iocb = cell->iocb;
+    // the cell is free for the put that will happen one lap later
+    __atomic_store_n(&cell->sequence, position + pool->mask + 1, __ATOMIC_RELEASE);
+    return iocb;
+}
+
+/**
+ * remove an iocb from the pool. Returns NULL if there is none available.
+ */
+static inline struct iocb * iocb_pool_get(struct iocb_pool * pool) {
+    if (!iocb_pool_reserve(pool, 1)) {
+        return NULL;
+    }
+    return iocb_pool_take(pool);
+}
+
+/**
+ * Put an iocb back on the pool.
+ */
+static inline void iocb_pool_put(struct iocb_pool * pool, struct iocb * iocb) {
+    struct iocb_pool_cell * cell;
+    unsigned long position = __atomic_load_n(&pool->putPosition, __ATOMIC_RELAXED);
+    int spins = 0;
+
+    for (;;) {
+        cell = &pool->cells[position & pool->mask];
+        unsigned long sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        long diff = (long) sequence - (long) position;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&pool->putPosition, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else {
+            // diff < 0 would mean the queue is full, what can't happen as we never have more than queueSize iocbs.
+            // It can still be a slow consumer that has claimed the cell but not yet released it, so we just retry
+            if (diff < 0 && ++spins >= IOCB_POOL_SPINS) {
+                spins = 0;
+                sched_yield();
+            }
+            position = __atomic_load_n(&pool->putPosition, __ATOMIC_RELAXED);
+        }
+    }
+
+    iocb_slot_of(iocb)->flags = 0;
+    cell->iocb = iocb;
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+    // only after the iocb is published it can be reserved again
+    __atomic_fetch_sub(&pool->used, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Put count iocbs back on the pool.
+ */
+static inline void iocb_pool_put_all(struct iocb_pool * pool, struct iocb ** iocbs, int count) {
+    int i;
+    for (i = 0; i < count; i++) {
+        iocb_pool_put(pool, iocbs[i]);
+    }
+}
+
+/**
+ * remove count iocbs from the pool. It is all or nothing, returns 0 if there weren't enough iocbs for the whole batch.
+ */
+static inline int iocb_pool_get_all(struct iocb_pool * pool, struct iocb ** iocbs, int count) {
+    int i;
+    if (!iocb_pool_reserve(pool, count)) {
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        iocbs[i] = iocb_pool_take(pool);
+    }
+    return count;
+}
+
+/**
+ * The number of iocbs currently taken from the pool
+ */
+static inline int iocb_pool_used(struct iocb_pool * pool) {
+    return __atomic_load_n(&pool->used, __ATOMIC_RELAXED);
+}
+
+#endif
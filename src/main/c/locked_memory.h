@@ -0,0 +1,93 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LOCKED_MEMORY_H
+#define LOCKED_MEMORY_H
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "numa_node.h"
+
+/*
+ * Memory for the structures the poll loop touches on every round (the events array, the iocb slab), mapped on huge pages,
+ * prefaulted and locked when it is allocated, so polling never takes a page fault or a TLB miss per 4KB page.
+ *
+ * The mapping uses MAP_HUGETLB, or madvise(MADV_HUGEPAGE) if there are no huge pages reserved. mlock is limited by
+ * RLIMIT_MEMLOCK: when it fails the memory is still prefaulted, it could just be swapped out.
+ *
+ * The header has no JNI dependencies on purpose, so it can be used by the benchmarks under ./bench
+ */
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+
+#define LOCKED_MEMORY_HUGE_PAGE (2 * 1024 * 1024)
+
+struct locked_memory {
+    void * memory;
+    // the size of the mapping, rounded to huge pages
+    size_t size;
+    int locked;
+};
+
+/**
+ * Maps size bytes of zeroed memory, on the pages of node if it is not -1.
+ * @return 0 or -errno
+ */
+static inline int locked_memory_map(struct locked_memory * locked, size_t size, int node) {
+    size_t mapped = (size + LOCKED_MEMORY_HUGE_PAGE - 1) & ~((size_t) LOCKED_MEMORY_HUGE_PAGE - 1);
+    void * memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory == MAP_FAILED) {
+        // no huge pages reserved on the system, transparent huge pages are the next best thing
+        memory = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return -errno;
+        }
+        madvise(memory, mapped, MADV_HUGEPAGE);
+    }
+
+    if (node >= 0) {
+        // before the pages are faulted
+        numa_node_bind(memory, mapped, node);
+    }
+
+    locked->memory = memory;
+    locked->size = mapped;
+    // mlock faults every page in, touching them does the same without it
+    locked->locked = mlock(memory, mapped) == 0;
+    if (!locked->locked) {
+        memset(memory, 0, mapped);
+    }
+    return 0;
+}
+
+static inline void locked_memory_unmap(struct locked_memory * locked) {
+    if (locked->memory != NULL) {
+        munmap(locked->memory, locked->size);
+        locked->memory = NULL;
+        locked->size = 0;
+        locked->locked = 0;
+    }
+}
+
+#endif
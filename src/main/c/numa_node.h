@@ -0,0 +1,194 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NUMA_NODE_H
+#define NUMA_NODE_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+/*
+ * Placement of memory and threads on a NUMA node, with the mbind and set_mempolicy system calls,
+ * so there is no dependency on libnuma.
+ *
+ * The policy is MPOL_PREFERRED: the memory is taken from the node while it has free pages, and from the others after that,
+ * so a busy node never fails an allocation. A kernel without NUMA support (ENOSYS) leaves everything where it was.
+ *
+ * The header has no JNI dependencies on purpose, so it can be used by the benchmarks under ./bench
+ */
+
+#ifndef MPOL_DEFAULT
+#define MPOL_DEFAULT 0
+#endif
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+#ifndef MPOL_MF_MOVE
+#define MPOL_MF_MOVE (1 << 1)
+#endif
+
+// nodes above this are not supported, the masks are kept on the stack
+#define NUMA_NODE_MAX 1024
+
+#define NUMA_NODE_MASK_BITS (8 * sizeof(unsigned long))
+
+#define NUMA_NODE_SYSFS "/sys/devices/system/node"
+
+/**
+ * A kernel without NUMA support has no node directories at all, node 0 is then the only one.
+ * @return 1 if node is a node of this machine
+ */
+static inline int numa_node_valid(int node) {
+    char path[64];
+    if (node < 0 || node >= NUMA_NODE_MAX) {
+        return 0;
+    }
+    snprintf(path, sizeof(path), NUMA_NODE_SYSFS "/node%d", node);
+    if (access(path, F_OK) == 0) {
+        return 1;
+    }
+    return node == 0 && access(NUMA_NODE_SYSFS, F_OK) != 0;
+}
+
+/**
+ * Prefers node for the whole pages within [address, address + size), moving the ones that were already touched.
+ * @return 0 or -errno
+ */
+static inline int numa_node_bind(void * address, size_t size, int node) {
+    unsigned long mask[NUMA_NODE_MAX / NUMA_NODE_MASK_BITS];
+    unsigned long page = (unsigned long) sysconf(_SC_PAGESIZE);
+    unsigned long start = ((unsigned long) address + page - 1) & ~(page - 1);
+    unsigned long end = ((unsigned long) address + size) & ~(page - 1);
+
+    if (end <= start) {
+        return 0;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[node / NUMA_NODE_MASK_BITS] |= 1UL << (node % NUMA_NODE_MASK_BITS);
+    if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED, mask, (unsigned long) NUMA_NODE_MAX + 1, MPOL_MF_MOVE) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+/**
+ * The same as posix_memalign, with the memory preferring node. node < 0 is a plain posix_memalign.
+ * On a node the memory takes whole pages, so nothing else shares them, and it is still released with free.
+ * @return 0 or the error of posix_memalign
+ */
+static inline int numa_node_memalign(void ** memory, size_t alignment, size_t size, int node) {
+    if (node < 0) {
+        return posix_memalign(memory, alignment, size);
+    }
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    int result = posix_memalign(memory, alignment > page ? alignment : page, (size + page - 1) & ~(page - 1));
+    if (result == 0) {
+        // failing is not fatal, the memory is just not local
+        numa_node_bind(*memory, (size + page - 1) & ~(page - 1), node);
+    }
+    return result;
+}
+
+/**
+ * Parses the cpulist of node, such as 0-7,16-23
+ * @return 0 or -errno
+ */
+static inline int numa_node_cpus(int node, cpu_set_t * cpus) {
+    char path[64];
+    char list[4096];
+    snprintf(path, sizeof(path), NUMA_NODE_SYSFS "/node%d/cpulist", node);
+
+    FILE * file = fopen(path, "r");
+    if (file == NULL) {
+        return -errno;
+    }
+    size_t read = fread(list, 1, sizeof(list) - 1, file);
+    fclose(file);
+    list[read] = 0;
+
+    CPU_ZERO(cpus);
+    char * next = list;
+    while (*next >= '0' && *next <= '9') {
+        long first = strtol(next, &next, 10);
+        long last = first;
+        if (*next == '-') {
+            last = strtol(next + 1, &next, 10);
+        }
+        for (; first <= last && first < CPU_SETSIZE; first++) {
+            CPU_SET((int) first, cpus);
+        }
+        if (*next != ',') {
+            break;
+        }
+        next++;
+    }
+    return CPU_COUNT(cpus) > 0 ? 0 : -ENOENT;
+}
+
+/**
+ * The memory policy of a thread, to be restored after a temporary change
+ */
+struct numa_node_policy {
+    int mode;
+    unsigned long mask[NUMA_NODE_MAX / NUMA_NODE_MASK_BITS];
+};
+
+/**
+ * @return 0 or -errno
+ */
+static inline int numa_node_get_policy(struct numa_node_policy * policy) {
+    memset(policy, 0, sizeof(struct numa_node_policy));
+    if (syscall(SYS_get_mempolicy, &policy->mode, policy->mask, (unsigned long) NUMA_NODE_MAX + 1, NULL, 0UL) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+/**
+ * @return 0 or -errno
+ */
+static inline int numa_node_restore_policy(struct numa_node_policy * policy) {
+    if (syscall(SYS_set_mempolicy, policy->mode, policy->mask, (unsigned long) NUMA_NODE_MAX + 1) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+/**
+ * Sets the memory policy of the calling thread, the kernel and the allocator take new pages from node.
+ * @return 0 or -errno
+ */
+static inline int numa_node_set_policy(int node) {
+    struct numa_node_policy policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.mode = MPOL_PREFERRED;
+    policy.mask[node / NUMA_NODE_MASK_BITS] |= 1UL << (node % NUMA_NODE_MASK_BITS);
+    return numa_node_restore_policy(&policy);
+}
+
+#endif
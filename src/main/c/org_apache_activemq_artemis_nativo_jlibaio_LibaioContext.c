@@ -29,50 +29,270 @@
 #include <sys/types.h>
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sched.h>
 #include <limits.h>
+#include <time.h>
 
 // This file is generated by maven compilation
 // it will be included under ./target/include starting from the root of the project
 // you need to run mvn install before you have access to this include file
 #include "org_apache_activemq_artemis_nativo_jlibaio_LibaioContext.h"
 #include "exception_helper.h"
+#include "iocb_pool.h"
+#include "uring.h"
+#include "buffer_pool.h"
+#include "aio_ring.h"
+#include "numa_node.h"
+#include "locked_memory.h"
 
-//x86 has a strong memory model and there is no need of HW fences if just Write-Back (WB) memory is used
-#define mem_barrier() __asm__ __volatile__ ("":::"memory")
-#define read_barrier()	__asm__ __volatile__("":::"memory")
-#define store_barrier()	__asm__ __volatile__("":::"memory")
+// -1 if we don't know yet if the kernel supports RWF_DSYNC on aio, 0 if it doesn't, 1 if it does
+int dsyncSupported = -1;
+
+#define ENGINE_LIBAIO org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ENGINE_LIBAIO
+#define ENGINE_IO_URING org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ENGINE_IO_URING
+
+#if org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_BUFFER_POOL_HUGE_PAGES != BUFFER_POOL_HUGE_PAGES || org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_BUFFER_POOL_ZERO != BUFFER_POOL_ZERO
+#error "The buffer pool flags on LibaioContext.java don't match buffer_pool.h"
+#endif
+
+#if org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_MAX_VECTORED_BUFFERS != IOCB_SLOT_IOVECS
+#error "MAX_VECTORED_BUFFERS on LibaioContext.java doesn't match IOCB_SLOT_IOVECS"
+#endif
+
+// The alignment of a file is an array of ints filled by getAlignment, see BlockAlignment.java
+#define ALIGNMENT_LOGICAL org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_LOGICAL
+#define ALIGNMENT_PHYSICAL org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_PHYSICAL
+#define ALIGNMENT_OPTIMAL_IO org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_OPTIMAL_IO
+#define ALIGNMENT_DIO_MEMORY org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_DIO_MEMORY
+#define ALIGNMENT_DIO_OFFSET org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_DIO_OFFSET
+#define ALIGNMENT_FILE_SYSTEM org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_FILE_SYSTEM
+#define ALIGNMENT_LENGTH org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_ALIGNMENT_LENGTH
+
+// The stats of a context are an array of longs shared with the Java side as a direct buffer, see LibaioStats.java
+#define STATS_READS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_READS
+#define STATS_WRITES org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_WRITES
+#define STATS_READ_NANOS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_READ_NANOS
+#define STATS_WRITE_NANOS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_WRITE_NANOS
+#define STATS_IN_FLIGHT_READS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_IN_FLIGHT_READS
+#define STATS_IN_FLIGHT_WRITES org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_IN_FLIGHT_WRITES
+#define STATS_MAX_IN_FLIGHT org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_MAX_IN_FLIGHT
+#define STATS_RING_REAPS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_RING_REAPS
+#define STATS_SYSCALL_REAPS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_SYSCALL_REAPS
+#define STATS_SUBMIT_EAGAIN org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_SUBMIT_EAGAIN
+#define STATS_READ_HISTOGRAM org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_READ_HISTOGRAM
+#define STATS_WRITE_HISTOGRAM org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_WRITE_HISTOGRAM
+#define STATS_BUCKETS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_BUCKETS
+#define STATS_LENGTH org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_STATS_LENGTH
+
+#if STATS_SYSCALL_REAPS != STATS_RING_REAPS + 1 || STATS_WRITE_HISTOGRAM != STATS_READ_HISTOGRAM + STATS_BUCKETS || STATS_LENGTH < STATS_WRITE_HISTOGRAM + STATS_BUCKETS
+#error "The stats layout on LibaioContext.java is not the one expected here"
+#endif
+
+// a completion held by the reorder window of a context with ordered delivery
+struct order_entry {
+    struct io_event event;
+    // ORDER_EMPTY, ORDER_DONE or ORDER_SKIPPED
+    int state;
+};
+
+#define ORDER_EMPTY 0
+// the iocb completed, the event is waiting for the sequences before it
+#define ORDER_DONE 1
+// the submit of the iocb failed, there is nothing to deliver but the iocb goes back to the pool once it is reached
+#define ORDER_SKIPPED 2
+
+// the in flight limit of a file, indexed by fd
+struct file_limit {
+    // 0 for no limit
+    int limit;
+    int inFlight;
+};
 
 struct io_control {
+    // ENGINE_LIBAIO uses ioContext, ENGINE_IO_URING uses uring
+    int engine;
+    // the NUMA node of the context memory, or -1
+    int numaNode;
     io_context_t ioContext;
+    struct uring uring;
     struct io_event * events;
+    // the mapping of events with CONTEXT_HUGE_PAGES, otherwise it was allocated with posix_memalign
+    struct locked_memory eventsMemory;
 
-    jobject thisObject;
+    // the distinct files of a round of events, for the group commit
+    int * syncFds;
 
-    // This is used to make sure we don't return IOCB while something else is using them
-    // this is to guarantee the submits could be done concurrently with polling
-    pthread_mutex_t iocbLock;
+    jobject thisObject;
 
     pthread_mutex_t pollLock;
 
-    // a reusable pool of iocb
-    struct iocb ** iocb;
     int queueSize;
-    int iocbPut;
-    int iocbGet;
-    int used;
 
+    // a reusable pool of iocb, it is lock free so submits could be done concurrently with polling.
+    // The pool owns the slab where all the iocbs of this context are allocated
+    struct iocb_pool iocbPool;
+
+    // when set, iocb->data holds a slot id from the Java side instead of a GlobalRef to the callback
+    int callbackSlots;
+
+    // hybrid poll: how long the poller spins on the ring before blocking on io_getevents. 0 and 0 disables it
+    int spinIterations;
+    long spinNanos;
+
+    // how many times the hybrid poll found events while spinning, and how many times it had to block
+    long spinHits;
+    long parks;
+
+    // how many fdatasync calls the group commit did
+    long syncs;
+
+    // signaled on every completion when the context was created with CONTEXT_EVENTFD, -1 otherwise
+    int eventFd;
+
+    // iocbs left for the submits from the Java side, out of queueSize. A callback of a fill or a chain takes one as well,
+    // and so do their writes on a context without a fill reserve
+    int queueIocbs;
+    // iocbs left for the writes of fills and chains, on top of queueSize. Guarded by fillLock, that also guards the chains
+    int fillIocbs;
+    // FILL_IOCBS with CONTEXT_FILL_RESERVE, otherwise 0 and the writes of fills and chains take from queueIocbs
+    int fillReserve;
+    pthread_mutex_t fillLock;
+
+    // set by deleteContext, the blocked poll gives up at the next round of events or timeout
+    int stopping;
+
+    // admission control: a submit with no iocb left, or with its file at its in flight limit,
+    // spins admissionSpins times and then parks for up to admissionWaitNanos before giving up. 0 gives up right away
+    int admissionSpins;
+    long admissionWaitNanos;
+    // parked submitters, putIOCB wakes them up
+    int admissionWaiters;
+    pthread_mutex_t admissionLock;
+    pthread_cond_t admissionCond;
+
+    // the in flight limits per fd (up to FILE_LIMITS), NULL until the first one is set
+    struct file_limit * fileLimits;
+
+    // ordered delivery (CONTEXT_ORDERED): the reads and writes get a sequence when submitted, and the poll only delivers
+    // the completed prefix of the sequences. The window has a power of 2 entries, at least as many as iocbs on the pool,
+    // as an iocb is only given back once its sequence is delivered. NULL when the delivery is not ordered
+    struct order_entry * orderWindow;
+    unsigned orderMask;
+    // taken by the submitters
+    unsigned nextSequence;
+    // the next sequence to be delivered, only used by the poller
+    unsigned nextDelivery;
+
+    // when set, submits are timed and completions go to stats
+    int statsEnabled;
+    // the counters are written with relaxed atomics and read from Java without stopping the I/O
+    long stats[STATS_LENGTH];
+
+};
+
+// iocbs on top of queueSize that can only be used by the zero writes of fills and the stages of chains,
+// so they never take space from the Java side, and the Java side never takes them (queueIocbs).
+// Only the contexts created with CONTEXT_FILL_RESERVE have them
+#define FILL_IOCBS org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_FILL_IOCBS
+
+#define MAX_CHAIN_WRITES org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_MAX_CHAIN_WRITES
+
+#if MAX_CHAIN_WRITES > FILL_IOCBS
+#error "a chain needs to fit on the iocbs of fills"
+#endif
+
+// files with a bigger fd can't have an in flight limit
+#define FILE_LIMITS 4096
+
+// a parked submitter checks again at least this often, so a wake up that raced with parking is not lost for long
+#define ADMISSION_PARK_NANOS 1000000L
+
+#define SUBMIT_OK org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_SUBMIT_OK
+#define SUBMIT_QUEUE_FULL org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_SUBMIT_QUEUE_FULL
+#define SUBMIT_FILE_LIMIT org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_SUBMIT_FILE_LIMIT
+
+#define CONTEXT_ORDERED org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_CONTEXT_ORDERED
+#define CONTEXT_HUGE_PAGES org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_CONTEXT_HUGE_PAGES
+#define CONTEXT_FILL_RESERVE org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_CONTEXT_FILL_RESERVE
+
+#if SUBMIT_OK != 0
+#error "SUBMIT_OK needs to be 0, the negative statuses are errnos"
+#endif
+
+#ifndef FALLOC_FL_KEEP_SIZE
+#define FALLOC_FL_KEEP_SIZE 0x01
+#endif
+
+#ifndef FALLOC_FL_PUNCH_HOLE
+#define FALLOC_FL_PUNCH_HOLE 0x02
+#endif
+
+#ifndef FALLOC_FL_ZERO_RANGE
+#define FALLOC_FL_ZERO_RANGE 0x10
+#endif
+
+// the block device ioctls of linux/fs.h, that is not included as it conflicts with sys/mount.h on some distributions
+#ifndef BLKSSZGET
+#define BLKSSZGET _IO(0x12, 104)
+#endif
+
+#ifndef BLKIOOPT
+#define BLKIOOPT _IO(0x12, 121)
+#endif
+
+#ifndef BLKPBSZGET
+#define BLKPBSZGET _IO(0x12, 123)
+#endif
+
+#ifndef BLKGETSIZE64
+#define BLKGETSIZE64 _IOR(0x12, 114, size_t)
+#endif
+
+struct fill_control {
+    int fd;
+    long size;
+    // the final chunk starts at last, it is only submitted once everything before it is written, with the callback of the fill
+    long last;
+    // the next offset to be written
+    long next;
+    int inFlight;
+    // the first errno of the fill
+    int error;
+    // the callback: a GlobalRef, or a slot in callback slot mode
+    void * data;
 };
 
-//These should be used to check if the user-space io_getevents is supported:
-//Linux ABI for the ring buffer: https://elixir.bootlin.com/linux/v4.20.13/source/fs/aio.c#L54
-//aio_read_events_ring: https://elixir.bootlin.com/linux/v4.20.13/source/fs/aio.c#L1148
+/*
+ * A chain of writes with a barrier: the writes before the barrier, then a fdatasync once they all completed,
+ * then the writes after it once the fdatasync completed. The stages are submitted from the poller.
+ */
+struct chain_control {
+    int fd;
+    // the iocbs: the writes before the barrier, the fdatasync at barrier, the writes after it
+    int total;
+    int barrier;
+    // the first iocb not submitted yet
+    int next;
+    int inFlight;
+    // the first errno of the chain
+    int error;
+    // the callback: a GlobalRef, or a slot in callback slot mode
+    void * data;
+    struct iocb * iocbs[];
+};
 
-// NOTE: if the kernel ever updates the structure, the RING-MAGIC will change and the code will switch back to normal IO calls
-#define AIO_RING_MAGIC	0xa10a10a1
-#define AIO_RING_INCOMPAT_FEATURES	0
+// In callback slot mode iocb->data holds slot + 1, so NULL still means an invalid element
+// and -1 is still free for the dumb write
+#define SLOT_TO_DATA(slot) ((void *) (intptr_t) ((slot) + 1))
+#define DATA_TO_SLOT(data) ((int) ((intptr_t) (data) - 1))
 
 // set this to 0 if you want to stop using ring reaping
 #define RING_REAPER 1
@@ -100,47 +320,23 @@ JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_Libai
 }
 
 
-/** There is no defined aio_ring anywhere in an include,
-    This is an implementation detail, that is a binary contract.
-    it is safe to use the feature though. */
-struct aio_ring {
-	unsigned	id;	/* kernel internal index number */
-	unsigned	nr;	/* number of io_events */
-	unsigned	head;
-	unsigned	tail;
-
-	unsigned	magic;
-	unsigned	compat_features;
-	unsigned	incompat_features;
-	unsigned	header_length;	/* size of aio_ring */
-
-
-	struct io_event		io_events[0];
-}; /* 128 bytes + ring size */
-
-// Check if the implementation supports AIO_RING by checking this number directly.
-static inline int has_usable_ring(struct aio_ring *ring) {
-    return ring->magic == AIO_RING_MAGIC && ring->incompat_features == AIO_RING_INCOMPAT_FEATURES;
-}
-
-// Newer versions of the kernel (newer here being a relative word, a couple years already at the time
-// I am writing this), will have io_context_t as an opaque type, and the real type being the aio_ring.
-static inline struct aio_ring* to_aio_ring(io_context_t aio_ctx) {
-    return (struct aio_ring*) aio_ctx;
-}
-
 //It implements a user space batch read io events implementation that attempts to read io avoiding any sys calls
 // This implementation will look at the internal structure (aio_ring) and move along the memory result
+/**
+ * reaps, when not NULL, counts the calls that were completed on user space (reaps[0]) and through io_getevents (reaps[1])
+ */
 static int ringio_get_events(io_context_t aio_ctx, long min_nr, long max,
-                                                       struct io_event *events, struct timespec *timeout) {
+                                                       struct io_event *events, struct timespec *timeout, long * reaps) {
     struct aio_ring *ring = to_aio_ring(aio_ctx);
     //checks if it could be completed in user space, saving a sys call
     if (RING_REAPER && !forceSysCall && has_usable_ring(ring)) {
         const unsigned ring_nr = ring->nr;
-        // We're assuming to be the exclusive writer to head, so we just need a compiler barrier
+        // We're assuming to be the exclusive writer to head, so it doesn't need any ordering
         unsigned head = ring->head;
-        mem_barrier();
-        const unsigned tail = ring->tail;
+        //the kernel writes the events before publishing ring->tail (smp_wmb on aio_complete):
+        //the load acquire pairs with it, so the events read below are never older than tail.
+        //On x86 this is a plain load, as its memory model is strong enough, but it needs a barrier on weakly ordered CPUs (aarch64, ppc64)
+        const unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
         int available = tail - head;
         if (available < 0) {
             //a wrap has occurred
@@ -161,9 +357,12 @@ static int ringio_get_events(io_context_t aio_ctx, long min_nr, long max,
                //
                // On the race available would eventually be >= max, while ring->tail was invalid
                // we could work around by waiting ring-tail to change:
-               // while (ring->tail == tail) mem_barrier();
+               // while (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == tail);
                //
                // however eventually we could have available==max in a legal situation what could lead to infinite loop here
+               if (reaps) {
+                   __atomic_add_fetch(&reaps[1], 1, __ATOMIC_RELAXED);
+               }
                return io_getevents(aio_ctx, min_nr, max, events, timeout);
 
                // also: I could have called io_getevents to the one at the end of this method
@@ -171,27 +370,19 @@ static int ringio_get_events(io_context_t aio_ctx, long min_nr, long max,
                //       and I did not want to create another memory flag to stop the rest of the code
             }
 
-            //the kernel has written ring->tail from an interrupt:
-            //we need to load acquire the completed events here
-            read_barrier();
             const int available_nr = available < max? available : max;
-            //if isn't needed to wrap we can avoid % operations that are quite expansive
-            const int needMod = ((head + available_nr) >= ring_nr) ? 1 : 0;
-            for (int i = 0; i<available_nr; i++) {
-                events[i] = ring->io_events[head];
-                if (needMod == 1) {
-                    head = (head + 1) % ring_nr;
-                } else {
-                    head = (head + 1);
-                }
-            }
+            //the events are contiguous up to the end of the ring, so it is at most two bulk copies
+            head = aio_ring_copy(ring, head, (unsigned) available_nr, events);
             //it allow the kernel to build its own view of the ring buffer size
-            //and push new events if there are any
-            store_barrier();
-            ring->head = head;
+            //and push new events if there are any.
+            //The store release makes sure the events were copied before the kernel is allowed to reuse their space.
+            __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
             #ifdef DEBUG
                 fprintf(stdout, "consumed non sys-call = %d\n", available_nr);
             #endif
+            if (reaps) {
+                __atomic_add_fetch(&reaps[0], 1, __ATOMIC_RELAXED);
+            }
             return available_nr;
         }
     } else {
@@ -199,6 +390,9 @@ static int ringio_get_events(io_context_t aio_ctx, long min_nr, long max,
             fprintf(stdout, "The kernel is not supoprting the ring buffer any longer\n");
         #endif
     }
+    if (reaps) {
+        __atomic_add_fetch(&reaps[1], 1, __ATOMIC_RELAXED);
+    }
     // if this next line ever needs to be changed, beware of a duplicate code on this method
     // I explain why I duplicated the call instead of reuse it there ^^^^
     int sys_call_events = io_getevents(aio_ctx, min_nr, max, events, timeout);
@@ -208,11 +402,231 @@ static int ringio_get_events(io_context_t aio_ctx, long min_nr, long max,
     return sys_call_events;
 }
 
-// We need a fast and reliable way to stop the blocked poller
-// for that we need a dumb file,
-// We are using a temporary file for this.
-int dumbWriteHandler = 0;
-char dumbPath[PATH_MAX];
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __asm__ __volatile__("pause":::"memory")
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield":::"memory")
+#else
+#define cpu_relax() __asm__ __volatile__("":::"memory")
+#endif
+
+// after this many spins the hybrid poll gives the CPU away with sched_yield between checks
+#define SPIN_YIELD_AFTER 1024
+
+// the clock is only checked every this many spins
+#define SPIN_CLOCK_CHECK 32
+
+static inline long nanoTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * io_submit for the engine of the context
+ */
+static inline int engineSubmitOnly(struct io_control * control, long nr, struct iocb ** iocbs) {
+    if (control->engine == ENGINE_IO_URING) {
+        // the eventfd is registered on the ring
+        return uring_submit(&control->uring, iocbs, (int)nr);
+    }
+    if (control->eventFd >= 0) {
+        long i;
+        for (i = 0; i < nr; i++) {
+            io_set_eventfd(iocbs[i], control->eventFd);
+        }
+    }
+    return io_submit(control->ioContext, nr, iocbs);
+}
+
+static inline int isReadOpcode(struct iocb * iocb) {
+    return iocb->aio_lio_opcode == IO_CMD_PREAD || iocb->aio_lio_opcode == IO_CMD_PREADV;
+}
+
+/**
+ * engineSubmitOnly, timing the iocbs when the stats are enabled.
+ * The iocbs are timed before the submit, as they could complete before it returns.
+ */
+static inline int engineSubmit(struct io_control * control, long nr, struct iocb ** iocbs) {
+    if (!__atomic_load_n(&control->statsEnabled, __ATOMIC_RELAXED)) {
+        return engineSubmitOnly(control, nr, iocbs);
+    }
+
+    long i;
+    long reads = 0;
+    long now = nanoTime();
+    for (i = 0; i < nr; i++) {
+        struct iocb_slot * slot = iocb_slot_of(iocbs[i]);
+        slot->submitNanos = now;
+        slot->flags |= IOCB_SLOT_TIMED;
+        reads += isReadOpcode(iocbs[i]);
+    }
+    long inFlight = __atomic_add_fetch(&control->stats[STATS_IN_FLIGHT_READS], reads, __ATOMIC_RELAXED) +
+                    __atomic_add_fetch(&control->stats[STATS_IN_FLIGHT_WRITES], nr - reads, __ATOMIC_RELAXED);
+    long maxInFlight = __atomic_load_n(&control->stats[STATS_MAX_IN_FLIGHT], __ATOMIC_RELAXED);
+    while (inFlight > maxInFlight &&
+           !__atomic_compare_exchange_n(&control->stats[STATS_MAX_IN_FLIGHT], &maxInFlight, inFlight, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    int result = engineSubmitOnly(control, nr, iocbs);
+
+    if (result == -EAGAIN) {
+        __atomic_add_fetch(&control->stats[STATS_SUBMIT_EAGAIN], 1, __ATOMIC_RELAXED);
+    }
+    // the ones not taken by the kernel are not in flight, and nobody else could be looking at them
+    for (i = result < 0 ? 0 : result; i < nr; i++) {
+        iocb_slot_of(iocbs[i])->flags &= ~IOCB_SLOT_TIMED;
+        if (isReadOpcode(iocbs[i])) {
+            __atomic_sub_fetch(&control->stats[STATS_IN_FLIGHT_READS], 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_sub_fetch(&control->stats[STATS_IN_FLIGHT_WRITES], 1, __ATOMIC_RELAXED);
+        }
+    }
+    return result;
+}
+
+/**
+ * The histogram bucket of a latency: log-linear, with 4 buckets per power of 2 (values are within 25% of their bucket).
+ * LibaioStats.bucketLowerBound on the Java side is the inverse of this.
+ */
+static inline int statsBucket(long nanos) {
+    if (nanos < 4) {
+        return nanos < 0 ? 0 : (int) nanos;
+    }
+    int exponent = 63 - __builtin_clzl((unsigned long) nanos);
+    int bucket = (exponent - 1) * 4 + (int) ((nanos >> (exponent - 2)) & 3);
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+/**
+ * Accounts the timed events of a round of completions, before the poll loops get to them
+ */
+static inline void statsCompleted(struct io_control * control, int nr, struct io_event * events) {
+    int i;
+    long now = 0;
+    for (i = 0; i < nr; i++) {
+        struct iocb * iocb = events[i].obj;
+        struct iocb_slot * slot = iocb_slot_of(iocb);
+        if (!(slot->flags & IOCB_SLOT_TIMED)) {
+            continue;
+        }
+        slot->flags &= ~IOCB_SLOT_TIMED;
+        if (now == 0) {
+            now = nanoTime();
+        }
+        long latency = now - slot->submitNanos;
+        int read = isReadOpcode(iocb);
+        __atomic_sub_fetch(&control->stats[read ? STATS_IN_FLIGHT_READS : STATS_IN_FLIGHT_WRITES], 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&control->stats[read ? STATS_READS : STATS_WRITES], 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&control->stats[read ? STATS_READ_NANOS : STATS_WRITE_NANOS], latency, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&control->stats[(read ? STATS_READ_HISTOGRAM : STATS_WRITE_HISTOGRAM) + statsBucket(latency)], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * io_getevents for the engine of the context, timeoutNanos < 0 waits for min_nr events without a timeout
+ */
+static inline int engineGetEvents(struct io_control * control, long min_nr, long max, struct io_event * events, long timeoutNanos) {
+    long * reaps = __atomic_load_n(&control->statsEnabled, __ATOMIC_RELAXED) ? &control->stats[STATS_RING_REAPS] : NULL;
+    if (control->engine == ENGINE_IO_URING) {
+        if (reaps) {
+            // the completion queue is always on user space, it's only a system call when it has to wait
+            __atomic_add_fetch(&reaps[uring_ready(&control->uring) >= min_nr ? 0 : 1], 1, __ATOMIC_RELAXED);
+        }
+        return uring_get_events(&control->uring, min_nr, max, events, timeoutNanos);
+    }
+    if (timeoutNanos < 0) {
+        return ringio_get_events(control->ioContext, min_nr, max, events, 0, reaps);
+    }
+    struct timespec timeout;
+    timeout.tv_sec = timeoutNanos / 1000000000L;
+    timeout.tv_nsec = timeoutNanos % 1000000000L;
+    return ringio_get_events(control->ioContext, min_nr, max, events, &timeout, reaps);
+}
+
+/**
+ * The number of completions that could be reaped without a system call, or -1 if that can't be known
+ */
+static inline int engineReadyEvents(struct io_control * control) {
+    if (control->engine == ENGINE_IO_URING) {
+        return uring_ready(&control->uring);
+    }
+    struct aio_ring *ring = to_aio_ring(control->ioContext);
+    if (!RING_REAPER || forceSysCall || !has_usable_ring(ring)) {
+        return -1;
+    }
+    // the poller is the only one moving head, tail is moved by the kernel
+    unsigned head = ring->head;
+    unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    int available = tail - head;
+    if (available < 0) {
+        available += ring->nr;
+    }
+    return available;
+}
+
+static inline void engineRelease(struct io_control * control) {
+    if (control->engine == ENGINE_IO_URING) {
+        uring_destroy(&control->uring);
+    } else {
+        io_queue_release(control->ioContext);
+    }
+    if (control->eventFd >= 0) {
+        close(control->eventFd);
+        control->eventFd = -1;
+    }
+}
+
+/**
+ * engineGetEvents with the hybrid poll: when blocking would be needed, it spins on the completion ring
+ * for spinIterations and/or spinNanos before parking on the kernel.
+ * The spin counts against timeoutNanos, when it's not negative.
+ */
+static int pollEngineEvents(struct io_control * control, long min_nr, long max, struct io_event * events, long timeoutNanos) {
+    int spinIterations = __atomic_load_n(&control->spinIterations, __ATOMIC_RELAXED);
+    long spinNanos = __atomic_load_n(&control->spinNanos, __ATOMIC_RELAXED);
+
+    if ((spinIterations > 0 || spinNanos > 0) && min_nr > 0 && timeoutNanos != 0 && engineReadyEvents(control) >= 0) {
+        long start = nanoTime();
+        if (timeoutNanos > 0 && (spinNanos <= 0 || spinNanos > timeoutNanos)) {
+            spinNanos = timeoutNanos;
+        }
+        long deadline = spinNanos > 0 ? start + spinNanos : 0;
+        int spins;
+        for (spins = 0; ; spins++) {
+            if (engineReadyEvents(control) >= min_nr) {
+                __atomic_store_n(&control->spinHits, control->spinHits + 1, __ATOMIC_RELAXED);
+                return engineGetEvents(control, min_nr, max, events, -1);
+            }
+            if (spinIterations > 0 && spins >= spinIterations) {
+                break;
+            }
+            if (deadline && spins % SPIN_CLOCK_CHECK == 0 && nanoTime() >= deadline) {
+                break;
+            }
+            if (spins < SPIN_YIELD_AFTER) {
+                cpu_relax();
+            } else {
+                sched_yield();
+            }
+        }
+        __atomic_store_n(&control->parks, control->parks + 1, __ATOMIC_RELAXED);
+        if (timeoutNanos > 0) {
+            timeoutNanos -= nanoTime() - start;
+            if (timeoutNanos < 0) {
+                timeoutNanos = 0;
+            }
+        }
+    }
+
+    return engineGetEvents(control, min_nr, max, events, timeoutNanos);
+}
+
+// We need a fast and reliable way to stop the blocked poller when it waits without a timeout:
+// a zero length write on the write end of a pipe completes right away, without creating any file.
+// The read end is kept open so the write is never EPIPE.
+int dumbWriteHandler = -1;
+int dumbReadHandler = -1;
 
 #define ONE_MEGA 1048576l
 void * oneMegaBuffer = 0;
@@ -223,6 +637,7 @@ jclass submitClass = NULL;
 jmethodID errorMethod = NULL;
 jmethodID doneMethod = NULL;
 jmethodID libaioContextDone = NULL;
+jmethodID libaioContextDoneBatch = NULL;
 
 jclass libaioContextClass = NULL;
 jclass runtimeExceptionClass = NULL;
@@ -306,19 +721,19 @@ jint JNI_OnLoad(JavaVM* vm, void* reserved) {
              fprintf(stderr, "could not initialize mutex on on_load, %d", res);
              return JNI_ERR;
         }
-        sprintf (dumbPath, "%s/artemisJLHandler_XXXXXX", P_tmpdir);
-        dumbWriteHandler = mkstemp (dumbPath);
+        int dumbPipe[2];
+        if (pipe2(dumbPipe, O_CLOEXEC) < 0) {
+           fprintf (stderr, "couldn't create stop pipe handler: %s\n", strerror(errno));
+           return JNI_ERR;
+        }
+        dumbReadHandler = dumbPipe[0];
+        dumbWriteHandler = dumbPipe[1];
 
         #ifdef DEBUG
-           fprintf (stdout, "Creating temp file %s for dumb writes\n", dumbPath);
+           fprintf (stdout, "Created pipe %d for dumb writes\n", dumbWriteHandler);
            fflush(stdout);
         #endif
 
-        if (dumbWriteHandler < 0) {
-           fprintf (stderr, "couldn't create stop file handler %s\n", dumbPath);
-           return JNI_ERR;
-        }
-
         //
         // Accordingly to previous experiences we must hold Global Refs on Classes
         // And
@@ -380,18 +795,24 @@ jint JNI_OnLoad(JavaVM* vm, void* reserved) {
            return JNI_ERR;
         }
 
+        libaioContextDoneBatch = (*env)->GetMethodID(env, libaioContextClass, "doneBatch", "(I)V");
+        if (libaioContextDoneBatch == NULL) {
+           return JNI_ERR;
+        }
+
         return JNI_VERSION_1_6;
     }
 }
 
 static inline void closeDumbHandlers() {
-    if (dumbWriteHandler != 0) {
+    if (dumbWriteHandler >= 0) {
         #ifdef DEBUG
-           fprintf (stdout, "Closing and removing dump handler %s\n", dumbPath);
+           fprintf (stdout, "Closing dump handler %d\n", dumbWriteHandler);
         #endif
-        dumbWriteHandler = 0;
         close(dumbWriteHandler);
-        unlink(dumbPath);
+        close(dumbReadHandler);
+        dumbWriteHandler = -1;
+        dumbReadHandler = -1;
     }
 }
 
@@ -443,329 +864,2047 @@ static inline struct io_control * getIOControl(JNIEnv* env, jobject pointer) {
 }
 
 /**
- * remove an iocb from the pool of IOCBs. Returns null if full
+ * Takes count of the queueSize iocbs of the Java side, the iocbs of fills and chains are not counted here
+ * @return 1 if taken, 0 if there are not that many left
  */
-static inline struct iocb * getIOCB(struct io_control * control) {
-    struct iocb * iocb = 0;
+static inline int reserveQueue(struct io_control * control, int count) {
+    int left = __atomic_load_n(&control->queueIocbs, __ATOMIC_RELAXED);
+    do {
+        if (left < count) {
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&control->queueIocbs, &left, left - count, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return 1;
+}
 
-    pthread_mutex_lock(&(control->iocbLock));
+static inline void releaseQueue(struct io_control * control, int count) {
+    __atomic_add_fetch(&control->queueIocbs, count, __ATOMIC_RELEASE);
+}
 
+/**
+ * remove an iocb from the pool of IOCBs, out of the queueSize of the Java side. Returns null if full
+ */
+static inline struct iocb * getIOCB(struct io_control * control) {
     #ifdef DEBUG
-       fprintf (stdout, "getIOCB::used=%d, queueSize=%d, get=%d, put=%d\n", control->used, control->queueSize, control->iocbGet, control->iocbPut);
+       fprintf (stdout, "getIOCB::used=%d, queueSize=%d\n", iocb_pool_used(&(control->iocbPool)), control->queueSize);
     #endif
 
-    if (control->used < control->queueSize) {
-        control->used++;
-        iocb = control->iocb[control->iocbGet++];
+    if (!reserveQueue(control, 1)) {
+        return NULL;
+    }
+    struct iocb * iocb = iocb_pool_get(&(control->iocbPool));
+    if (iocb == NULL) {
+        releaseQueue(control, 1);
+    }
+    return iocb;
+}
 
-        if (control->iocbGet >= control->queueSize) {
-           control->iocbGet = 0;
-        }
+/**
+ * Gives back the in flight slot an admitted iocb had on its file.
+ * The admission sets aio_fildes to the admitted fd, so it is right even if the iocb was never prepared
+ */
+static inline void releaseFileLimit(struct io_control * control, struct iocb * iocb) {
+    struct file_limit * limits = __atomic_load_n(&control->fileLimits, __ATOMIC_ACQUIRE);
+    int fd = iocb->aio_fildes;
+    if (limits != NULL && fd >= 0 && fd < FILE_LIMITS) {
+        __atomic_sub_fetch(&limits[fd].inFlight, 1, __ATOMIC_RELEASE);
     }
+}
 
-    pthread_mutex_unlock(&(control->iocbLock));
-    return iocb;
+static inline void wakeAdmission(struct io_control * control) {
+    if (__atomic_load_n(&control->admissionWaiters, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&control->admissionLock);
+        pthread_cond_broadcast(&control->admissionCond);
+        pthread_mutex_unlock(&control->admissionLock);
+    }
 }
 
 /**
  * Put an iocb back on the pool of IOCBs
  */
 static inline void putIOCB(struct io_control * control, struct iocb * iocbBack) {
-    pthread_mutex_lock(&(control->iocbLock));
-
     #ifdef DEBUG
-       fprintf (stdout, "putIOCB::used=%d, queueSize=%d, get=%d, put=%d\n", control->used, control->queueSize, control->iocbGet, control->iocbPut);
+       fprintf (stdout, "putIOCB::used=%d, queueSize=%d\n", iocb_pool_used(&(control->iocbPool)), control->queueSize);
     #endif
 
-    control->used--;
-    control->iocb[control->iocbPut++] = iocbBack;
-    if (control->iocbPut >= control->queueSize) {
-       control->iocbPut = 0;
+    int limited = iocb_slot_of(iocbBack)->flags & IOCB_SLOT_LIMITED;
+    if (limited) {
+        // before the iocb goes back, as the pool clears its flags
+        releaseFileLimit(control, iocbBack);
     }
-    pthread_mutex_unlock(&(control->iocbLock));
+    iocb_pool_put(&(control->iocbPool), iocbBack);
+    releaseQueue(control, 1);
+    wakeAdmission(control);
 }
 
-static inline short submit(JNIEnv * env, struct io_control * theControl, struct iocb * iocb) {
-    int result = io_submit(theControl->ioContext, 1, &iocb);
-
-    if (result < 0) {
-        // Putting the Global Ref and IOCB back in case of a failure
-        if (iocb->data != NULL && iocb->data != (void *) -1) {
-            (*env)->DeleteGlobalRef(env, (jobject)iocb->data);
-        }
-        putIOCB(theControl, iocb);
-
-        throwIOExceptionErrorNo(env, "Error while submitting IO: ", -result);
+/**
+ * Takes count iocbs for the writes of fills and chains: from the fill reserve, or out of queueSize without one.
+ * It needs to be called holding fillLock.
+ * @return 1 if taken, 0 if there are not that many left
+ */
+static inline int reserveInternal(struct io_control * control, int count) {
+    if (control->fillReserve == 0) {
+        return reserveQueue(control, count);
+    }
+    if (control->fillIocbs < count) {
         return 0;
     }
-
+    control->fillIocbs -= count;
     return 1;
 }
 
-static inline void * getBuffer(JNIEnv* env, jobject pointer) {
-    return (*env)->GetDirectBufferAddress(env, pointer);
-}
-
-JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_lock
-  (JNIEnv * env, jclass  clazz, jint handle) {
-    return flock(handle, LOCK_EX | LOCK_NB) == 0;
-}
-
-
 /**
- * Destroys the individual members of the IOCB pool
- * @param theControl the IO Control structure containing an IOCB pool
- * @param upperBound the number of elements contained within the pool
+ * Gives back what reserveInternal took, once the iocbs are back on the pool. It needs to be called holding fillLock.
  */
-static inline void iocb_destroy_members(struct io_control * theControl, int upperBound) {
-    for (int i = 0; i < upperBound; i++) {
-        free(theControl->iocb[i]);
+static inline void releaseInternal(struct io_control * control, int count) {
+    if (control->fillReserve == 0) {
+        releaseQueue(control, count);
+        wakeAdmission(control);
+    } else {
+        control->fillIocbs += count;
     }
 }
 
-
 /**
- * Destroys an IOCB pool and its members up to a certain limit. Should be used when the IOCB
- * pool fails to initialize completely
- * @param theControl the IO Control structure containing an IOCB pool
- * @param upperBound the number of elements contained within the pool
+ * getIOCB for the writes of fills and chains, that the caller accounts with reserveInternal
  */
-static inline void iocb_destroy_bounded(struct io_control * theControl, int upperBound) {
-    iocb_destroy_members(theControl, upperBound);
-    free(theControl->iocb);
+static inline struct iocb * getInternalIOCB(struct io_control * control) {
+    return iocb_pool_get(&(control->iocbPool));
 }
 
-
 /**
- * Destroys an IOCB pool and all its members
- * @param theControl
+ * putIOCB for an iocb taken with getInternalIOCB
  */
-static inline void iocb_destroy(struct io_control * theControl) {
-    iocb_destroy_bounded(theControl, theControl->queueSize);
+static inline void putInternalIOCB(struct io_control * control, struct iocb * iocbBack) {
+    iocb_pool_put(&(control->iocbPool), iocbBack);
 }
 
 /**
- * Everything that is allocated here will be freed at deleteContext when the class is unloaded.
+ * remove count iocbs from the pool of IOCBs, out of the queueSize of the Java side.
+ * It is all or nothing: returns 0 if there isn't enough space for the whole batch.
  */
-JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_newContext(JNIEnv* env, jobject thisObject, jint queueSize) {
-    int i = 0;
-
+static inline int getIOCBs(struct io_control * control, struct iocb ** iocbs, int count) {
     #ifdef DEBUG
-        fprintf (stdout, "Initializing context\n");
+       fprintf (stdout, "getIOCBs::count=%d, used=%d, queueSize=%d\n", count, iocb_pool_used(&(control->iocbPool)), control->queueSize);
     #endif
 
-	struct io_control * theControl = (struct io_control *) malloc(sizeof(struct io_control));
-    if (theControl == NULL) {
-        throwOutOfMemoryError(env);
-        return NULL;
+    if (!reserveQueue(control, count)) {
+        return 0;
     }
-
-	int res = io_queue_init(queueSize, &theControl->ioContext);
-	if (res) {
-		// Error, so need to release whatever was done before
-        io_queue_release(theControl->ioContext);
-        free(theControl);
-
-		throwRuntimeExceptionErrorNo(env, "Cannot initialize queue:", res);
-		return NULL;
-	}
-
-    theControl->iocb = (struct iocb **)malloc((sizeof(struct iocb *) * (size_t)queueSize));
-    if (theControl->iocb == NULL) {
-        io_queue_release(theControl->ioContext);
-        free(theControl);
-
-        throwOutOfMemoryError(env);
-        return NULL;
+    if (!iocb_pool_get_all(&(control->iocbPool), iocbs, count)) {
+        releaseQueue(control, count);
+        return 0;
     }
+    return 1;
+}
 
-    for (i = 0; i < queueSize; i++) {
-        theControl->iocb[i] = (struct iocb *)malloc(sizeof(struct iocb));
-        if (theControl->iocb[i] == NULL) {
-
-           // It may not have been fully initialized, therefore limit the cleanup up to 'i' members.
-           iocb_destroy_bounded(theControl, i);
-
-           io_queue_release(theControl->ioContext);
-           free(theControl);
+/**
+ * Put count iocbs back on the pool of IOCBs
+ */
+static inline void putIOCBs(struct io_control * control, struct iocb ** iocbsBack, int count) {
+    #ifdef DEBUG
+       fprintf (stdout, "putIOCBs::count=%d, used=%d, queueSize=%d\n", count, iocb_pool_used(&(control->iocbPool)), control->queueSize);
+    #endif
 
-           throwOutOfMemoryError(env);
-           return NULL;
-       }
+    int i;
+    for (i = 0; i < count; i++) {
+        if (iocb_slot_of(iocbsBack[i])->flags & IOCB_SLOT_LIMITED) {
+            releaseFileLimit(control, iocbsBack[i]);
+        }
     }
-    theControl->queueSize = queueSize;
-
-
-    res = pthread_mutex_init(&(theControl->iocbLock), 0);
-    if (res) {
-        iocb_destroy(theControl);
-
-        io_queue_release(theControl->ioContext);
-        free(theControl);
+    iocb_pool_put_all(&(control->iocbPool), iocbsBack, count);
+    releaseQueue(control, count);
+    wakeAdmission(control);
+}
 
-        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext:", res);
-        return NULL;
+/**
+ * Gives sequences to iocbs about to be submitted, on a context with ordered delivery
+ */
+static inline void orderIOCBs(struct io_control * control, struct iocb ** iocbs, int nr) {
+    if (control->orderWindow == NULL) {
+        return;
     }
+    unsigned sequence = __atomic_fetch_add(&control->nextSequence, (unsigned) nr, __ATOMIC_RELAXED);
+    int i;
+    for (i = 0; i < nr; i++) {
+        struct iocb_slot * slot = iocb_slot_of(iocbs[i]);
+        slot->sequence = sequence + (unsigned) i;
+        slot->flags |= IOCB_SLOT_ORDERED;
+    }
+}
 
-    res = pthread_mutex_init(&(theControl->pollLock), 0);
-    if (res) {
-        iocb_destroy(theControl);
-
-        io_queue_release(theControl->ioContext);
-        free(theControl);
-
-        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext:", res);
-        return NULL;
+/**
+ * The counterpart of putIOCB for an iocb that could not be submitted: an ordered iocb has its sequence skipped,
+ * and it only goes back to the pool when the poller reaches it.
+ */
+static inline void releaseUnsubmitted(struct io_control * control, struct iocb * iocb) {
+    struct iocb_slot * slot = iocb_slot_of(iocb);
+    if (!(slot->flags & IOCB_SLOT_ORDERED)) {
+        putIOCB(control, iocb);
+        return;
     }
+    struct order_entry * entry = &control->orderWindow[slot->sequence & control->orderMask];
+    entry->event.obj = iocb;
+    __atomic_store_n(&entry->state, ORDER_SKIPPED, __ATOMIC_RELEASE);
+}
 
-    theControl->events = (struct io_event *)malloc(sizeof(struct io_event) * (size_t)queueSize);
-    if (theControl->events == NULL) {
-        iocb_destroy(theControl);
+/**
+ * @return if the poller can deliver at least one held completion without reaping
+ */
+static inline int orderReady(struct io_control * control) {
+    if (control->orderWindow == NULL) {
+        return 0;
+    }
+    struct order_entry * entry = &control->orderWindow[control->nextDelivery & control->orderMask];
+    return __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) != ORDER_EMPTY;
+}
 
-        io_queue_release(theControl->ioContext);
-        free(theControl);
+/**
+ * Turns the nr events just reaped into the events to deliver: the unordered ones stay as they are (fills and the dumb write),
+ * the ordered ones go to the window and the completed prefix of the window is appended, up to max events.
+ * What doesn't fit stays on the window for the next poll.
+ */
+static int orderEvents(struct io_control * control, int nr, long max, struct io_event * events) {
+    const unsigned mask = control->orderMask;
+    struct order_entry * window = control->orderWindow;
+    int delivered = 0;
+    int i;
 
-        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext (not enough memory for the events member): ", res);
-        return NULL;
+    for (i = 0; i < nr; i++) {
+        struct iocb_slot * slot = iocb_slot_of(events[i].obj);
+        if (slot->flags & IOCB_SLOT_ORDERED) {
+            struct order_entry * entry = &window[slot->sequence & mask];
+            entry->event = events[i];
+            __atomic_store_n(&entry->state, ORDER_DONE, __ATOMIC_RELAXED);
+        } else {
+            events[delivered++] = events[i];
+        }
     }
 
+    while (delivered < max) {
+        struct order_entry * entry = &window[control->nextDelivery & mask];
+        int state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+        if (state == ORDER_EMPTY) {
+            break;
+        }
+        control->nextDelivery++;
+        __atomic_store_n(&entry->state, ORDER_EMPTY, __ATOMIC_RELAXED);
+        if (state == ORDER_SKIPPED) {
+            putIOCB(control, entry->event.obj);
+        } else {
+            events[delivered++] = entry->event;
+        }
+    }
+    return delivered;
+}
+
+static inline int pollEvents(struct io_control * control, long min_nr, long max, struct io_event * events, long timeoutNanos) {
+    if (orderReady(control)) {
+        // held completions can be delivered, this round doesn't wait for the kernel
+        min_nr = 0;
+        timeoutNanos = 0;
+    }
+    int result = pollEngineEvents(control, min_nr, max, events, timeoutNanos);
+    if (result > 0) {
+        statsCompleted(control, result, events);
+    }
+    if (control->orderWindow != NULL && result >= 0) {
+        result = orderEvents(control, result, max, events);
+        if (control->eventFd >= 0 && orderReady(control)) {
+            // what didn't fit is not going to signal the eventfd again
+            eventfd_write(control->eventFd, 1);
+        }
+    }
+    return result;
+}
+
+/**
+ * Takes an in flight slot of fd
+ * @return 1 if taken, 0 if the file has no limit, -1 if the file is at its limit
+ */
+static inline int reserveFileLimit(struct io_control * control, int fd) {
+    struct file_limit * limits = __atomic_load_n(&control->fileLimits, __ATOMIC_ACQUIRE);
+    if (limits == NULL || fd < 0 || fd >= FILE_LIMITS) {
+        return 0;
+    }
+    struct file_limit * file = &limits[fd];
+    int limit = __atomic_load_n(&file->limit, __ATOMIC_RELAXED);
+    if (limit <= 0) {
+        return 0;
+    }
+    int inFlight = __atomic_load_n(&file->inFlight, __ATOMIC_RELAXED);
+    do {
+        if (inFlight >= limit) {
+            return -1;
+        }
+    } while (!__atomic_compare_exchange_n(&file->inFlight, &inFlight, inFlight + 1, 1, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+    return 1;
+}
+
+static inline void parkAdmission(struct io_control * control, long deadline) {
+    struct timespec until;
+    long now = nanoTime();
+    long park = deadline - now < ADMISSION_PARK_NANOS ? deadline - now : ADMISSION_PARK_NANOS;
+    if (park <= 0) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_sec += (until.tv_nsec + park) / 1000000000L;
+    until.tv_nsec = (until.tv_nsec + park) % 1000000000L;
+
+    pthread_mutex_lock(&control->admissionLock);
+    __atomic_add_fetch(&control->admissionWaiters, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_timedwait(&control->admissionCond, &control->admissionLock, &until);
+    __atomic_sub_fetch(&control->admissionWaiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&control->admissionLock);
+}
+
+/**
+ * One more round of the admission control after attempt failed: spins, and then parks until the deadline
+ * @return 0 when the submit has to give up
+ */
+static inline int admissionWait(struct io_control * control, int attempt, int spins, long waitNanos, long * deadline) {
+    if (waitNanos <= 0) {
+        return 0;
+    }
+    if (attempt < spins) {
+        cpu_relax();
+        return 1;
+    }
+    long now = nanoTime();
+    if (*deadline == 0) {
+        *deadline = now + waitNanos;
+    } else if (now >= *deadline) {
+        return 0;
+    }
+    parkAdmission(control, *deadline);
+    return 1;
+}
+
+/**
+ * getIOCB with the admission control of the context: the file needs to be under its in flight limit, and there needs to be an iocb left.
+ * It spins and then parks up to the admission settings while it can't have both.
+ * @return the iocb, or NULL with status set to SUBMIT_QUEUE_FULL or SUBMIT_FILE_LIMIT
+ */
+static struct iocb * admitIOCB(struct io_control * control, int fd, int * status) {
+    int spins = __atomic_load_n(&control->admissionSpins, __ATOMIC_RELAXED);
+    long waitNanos = __atomic_load_n(&control->admissionWaitNanos, __ATOMIC_RELAXED);
+    long deadline = 0;
+    int i;
+
+    for (i = 0; ; i++) {
+        int reserved = reserveFileLimit(control, fd);
+        if (reserved >= 0) {
+            struct iocb * iocb = getIOCB(control);
+            if (iocb != NULL) {
+                if (reserved) {
+                    // io_prep_* sets the same fd again, until then it is the one the slot is given back to
+                    iocb->aio_fildes = fd;
+                    iocb_slot_of(iocb)->flags |= IOCB_SLOT_LIMITED;
+                }
+                *status = SUBMIT_OK;
+                return iocb;
+            }
+            if (reserved) {
+                __atomic_sub_fetch(&control->fileLimits[fd].inFlight, 1, __ATOMIC_RELEASE);
+            }
+            *status = SUBMIT_QUEUE_FULL;
+        } else {
+            *status = SUBMIT_FILE_LIMIT;
+        }
+
+        if (!admissionWait(control, i, spins, waitNanos, &deadline)) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * admitIOCB for a batch, all or nothing: an iocb for every write, and an in flight slot on the file of every write.
+ * fds is NULL when every write goes to fd. A batch with more writes than the limit of its file is never admitted.
+ * @return 1 with the iocbs taken, or 0 with status set to SUBMIT_QUEUE_FULL or SUBMIT_FILE_LIMIT
+ */
+static int admitIOCBs(struct io_control * control, int fd, jint * fds, struct iocb ** iocbs, int count, int * status) {
+    int spins = __atomic_load_n(&control->admissionSpins, __ATOMIC_RELAXED);
+    long waitNanos = __atomic_load_n(&control->admissionWaitNanos, __ATOMIC_RELAXED);
+    long deadline = 0;
+    int i, j;
+
+    for (i = 0; ; i++) {
+        if (getIOCBs(control, iocbs, count)) {
+            for (j = 0; j < count; j++) {
+                int reserved = reserveFileLimit(control, fds == NULL ? fd : fds[j]);
+                if (reserved < 0) {
+                    break;
+                }
+                if (reserved) {
+                    iocbs[j]->aio_fildes = fds == NULL ? fd : fds[j];
+                    iocb_slot_of(iocbs[j])->flags |= IOCB_SLOT_LIMITED;
+                }
+            }
+            if (j == count) {
+                *status = SUBMIT_OK;
+                return 1;
+            }
+            // the iocbs are not prepared yet, so the slots are given back on the fds here
+            while (j-- > 0) {
+                if (iocb_slot_of(iocbs[j])->flags & IOCB_SLOT_LIMITED) {
+                    __atomic_sub_fetch(&control->fileLimits[fds == NULL ? fd : fds[j]].inFlight, 1, __ATOMIC_RELEASE);
+                    iocb_slot_of(iocbs[j])->flags &= ~IOCB_SLOT_LIMITED;
+                }
+            }
+            putIOCBs(control, iocbs, count);
+            *status = SUBMIT_FILE_LIMIT;
+        } else {
+            *status = SUBMIT_QUEUE_FULL;
+        }
+
+        if (!admissionWait(control, i, spins, waitNanos, &deadline)) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * Initializes the lock and the condition the admission control parks on, the condition on the monotonic clock
+ * @return 0 or the error of pthread
+ */
+static int initAdmission(struct io_control * control) {
+    pthread_condattr_t attr;
+    int res = pthread_mutex_init(&control->admissionLock, 0);
+    if (res) {
+        return res;
+    }
+    res = pthread_condattr_init(&attr);
+    if (res == 0) {
+        res = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        if (res == 0) {
+            res = pthread_cond_init(&control->admissionCond, &attr);
+        }
+        pthread_condattr_destroy(&attr);
+    }
+    if (res) {
+        pthread_mutex_destroy(&control->admissionLock);
+    }
+    return res;
+}
+
+static void destroyAdmission(struct io_control * control) {
+    pthread_cond_destroy(&control->admissionCond);
+    pthread_mutex_destroy(&control->admissionLock);
+    free(control->fileLimits);
+    control->fileLimits = NULL;
+}
+
+static inline void throwAdmission(JNIEnv * env, int status) {
+    if (status == SUBMIT_FILE_LIMIT) {
+        throwIOException(env, "Too many requests in flight on the file");
+    } else {
+        throwIOException(env, "Not enough space in libaio queue");
+    }
+}
+
+/**
+ * Makes the write durable: with RWF_DSYNC when the kernel supports it,
+ * or with a fdatasync before the completion is released otherwise.
+ */
+static inline void prepDurable(struct iocb * iocb) {
+    if (__atomic_load_n(&dsyncSupported, __ATOMIC_RELAXED) != 0) {
+        iocb_rw_flags(iocb) |= RWF_DSYNC;
+    } else {
+        iocb_slot_of(iocb)->flags |= IOCB_SLOT_SYNC;
+    }
+}
+
+/**
+ * engineSubmit of a single iocb, falling back to fdatasync when RWF_DSYNC is not supported
+ * @return 1 if OK or -errno
+ */
+static inline int submitOne(struct io_control * theControl, struct iocb * iocb) {
+    if (iocb->data != (void *) -1) {
+        // the dumb write of deleteContext needs to stop the poller right away, it is never held behind other completions
+        orderIOCBs(theControl, &iocb, 1);
+    }
+    int result = engineSubmit(theControl, 1, &iocb);
+
+    if (iocb_rw_flags(iocb) & RWF_DSYNC) {
+        if (result == -EINVAL && __atomic_load_n(&dsyncSupported, __ATOMIC_RELAXED) != 1) {
+            // it could be an old kernel (< 4.13) without RWF_DSYNC, we retry with the fdatasync fallback
+            iocb_rw_flags(iocb) &= ~RWF_DSYNC;
+            iocb_slot_of(iocb)->flags |= IOCB_SLOT_SYNC;
+            result = engineSubmit(theControl, 1, &iocb);
+            if (result >= 0) {
+                #ifdef DEBUG
+                   fprintf (stdout, "RWF_DSYNC is not supported, using fdatasync for durable writes\n");
+                #endif
+                __atomic_store_n(&dsyncSupported, 0, __ATOMIC_RELAXED);
+            }
+        } else if (result >= 0) {
+            __atomic_store_n(&dsyncSupported, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return result;
+}
+
+static inline short submit(JNIEnv * env, struct io_control * theControl, struct iocb * iocb) {
+    int result = submitOne(theControl, iocb);
+
+    if (result < 0) {
+        // Putting the Global Ref and IOCB back in case of a failure
+        if (!theControl->callbackSlots && iocb->data != NULL && iocb->data != (void *) -1) {
+            (*env)->DeleteGlobalRef(env, (jobject)iocb->data);
+        }
+        releaseUnsubmitted(theControl, iocb);
+
+        throwIOExceptionErrorNo(env, "Error while submitting IO: ", -result);
+        return 0;
+    }
+
+    return 1;
+}
+
+static inline void * getBuffer(JNIEnv* env, jobject pointer) {
+    return (*env)->GetDirectBufferAddress(env, pointer);
+}
+
+/**
+ * Submits the next zero write of a fill, from the oneMegaBuffer.
+ * It needs to be called holding fillLock, so the completion can't be handled before the fill is updated.
+ */
+static inline int fillChunk(struct io_control * control, struct fill_control * fill, struct iocb * iocb) {
+    long chunk = fill->last - fill->next;
+    if (chunk > ONE_MEGA) {
+        chunk = ONE_MEGA;
+    }
+
+    io_prep_pwrite(iocb, fill->fd, oneMegaBuffer, (size_t)chunk, fill->next);
+    iocb_slot_of(iocb)->flags = IOCB_SLOT_FILL;
+    iocb->data = fill;
+
+    int result = engineSubmit(control, 1, &iocb);
+    if (result < 0) {
+        return result;
+    }
+
+    fill->next += chunk;
+    fill->inFlight++;
+    return 0;
+}
+
+/**
+ * The zero writes of a fill are resubmitted from the poller until the file is filled, and they are never delivered.
+ * When the last one completes its iocb is reused for the final chunk, with the callback of the fill.
+ * If the fill failed the final chunk is not written: the event is turned into the completion of the callback, with the error.
+ *
+ * @return 1 if the event was taken by a fill, 0 if it needs to be delivered
+ */
+static inline int fillEvent(struct io_control * control, struct io_event * event) {
+    struct iocb * iocbp = event->obj;
+    if (!(iocb_slot_of(iocbp)->flags & IOCB_SLOT_FILL)) {
+        return 0;
+    }
+
+    struct fill_control * fill = (struct fill_control *) iocbp->data;
+    long res = (long)event->res;
+    int result;
+
+    pthread_mutex_lock(&(control->fillLock));
+    fill->inFlight--;
+    if (fill->error == 0 && res < 0) {
+        fill->error = (int)-res;
+    } else if (fill->error == 0 && res != (long)iocbp->u.c.nbytes) {
+        fill->error = EIO;
+    }
+
+    if (fill->error == 0 && fill->next < fill->last) {
+        result = fillChunk(control, fill, iocbp);
+        if (result == 0) {
+            pthread_mutex_unlock(&(control->fillLock));
+            return 1;
+        }
+        fill->error = -result;
+    }
+
+    if (fill->inFlight > 0) {
+        // the writes still in flight will finish the fill
+        putInternalIOCB(control, iocbp);
+        releaseInternal(control, 1);
+        pthread_mutex_unlock(&(control->fillLock));
+        return 1;
+    }
+    // the last write of the fill carries the callback on this iocb, that counts on the Java side
+    releaseInternal(control, 1);
+    pthread_mutex_unlock(&(control->fillLock));
+
+    int error = fill->error;
+    iocb_slot_of(iocbp)->flags = 0;
+    io_prep_pwrite(iocbp, fill->fd, oneMegaBuffer, (size_t)(fill->size - fill->last), fill->last);
+    iocbp->data = fill->data;
+    free(fill);
+
+    if (error == 0) {
+        result = engineSubmit(control, 1, &iocbp);
+        if (result >= 0) {
+            return 1;
+        }
+        error = -result;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "fill failed: %s\n", strerror(error));
+    #endif
+    event->res = (unsigned long)(long)-error;
+    return 0;
+}
+
+/**
+ * Fills the file with zeros through the queue of the context, with up to depth writes in flight,
+ * and the callback is completed with the final chunk.
+ * Everything but the final chunk can be zeroed with fallocate(FALLOC_FL_ZERO_RANGE) instead, when the file system supports it.
+ */
+static inline void submitFill(JNIEnv * env, struct io_control * theControl, jint fileHandle, jint alignment, jlong size,
+                              jint depth, jboolean zeroRange, jobject callback, jint slot) {
+    if (size <= 0 || depth <= 0) {
+        throwIOException(env, "Invalid size or depth for fill");
+        return;
+    }
+
+    if (verifyBuffer(alignment) < 0) {
+        throwOutOfMemoryError(env);
+        return;
+    }
+
+    struct fill_control * fill = (struct fill_control *) malloc(sizeof(struct fill_control));
+    if (fill == NULL) {
+        throwOutOfMemoryError(env);
+        return;
+    }
+
+    // the callback takes an iocb of the Java side until it is completed, whatever iocb carries it in the end
+    if (!reserveQueue(theControl, 1)) {
+        free(fill);
+        throwIOException(env, "Not enough space in libaio queue");
+        return;
+    }
+
+    fill->fd = fileHandle;
+    fill->size = size;
+    fill->last = ((size - 1) / ONE_MEGA) * ONE_MEGA;
+    fill->next = 0;
+    fill->inFlight = 0;
+    fill->error = 0;
+
+    if (zeroRange && fill->last > 0 && fallocate(fileHandle, FALLOC_FL_ZERO_RANGE, 0, (off_t)fill->last) == 0) {
+        fill->next = fill->last;
+    }
+
+    int result = 0;
+    if (fill->next < fill->last) {
+        fill->data = theControl->callbackSlots ? SLOT_TO_DATA(slot) : (void *) (*env)->NewGlobalRef(env, callback);
+
+        pthread_mutex_lock(&(theControl->fillLock));
+        while (fill->inFlight < depth && fill->next < fill->last && reserveInternal(theControl, 1)) {
+            struct iocb * iocb = getInternalIOCB(theControl);
+            if (iocb == NULL) {
+                releaseInternal(theControl, 1);
+                break;
+            }
+            result = fillChunk(theControl, fill, iocb);
+            if (result < 0) {
+                putInternalIOCB(theControl, iocb);
+                releaseInternal(theControl, 1);
+                break;
+            }
+        }
+
+        if (fill->inFlight > 0) {
+            if (result < 0) {
+                // the writes in flight will complete the callback with the error
+                fill->error = -result;
+            }
+            pthread_mutex_unlock(&(theControl->fillLock));
+            return;
+        }
+        pthread_mutex_unlock(&(theControl->fillLock));
+
+        if (!theControl->callbackSlots) {
+            (*env)->DeleteGlobalRef(env, (jobject)fill->data);
+        }
+
+        if (result < 0) {
+            free(fill);
+            releaseQueue(theControl, 1);
+            throwIOExceptionErrorNo(env, "Error while submitting IO: ", -result);
+            return;
+        }
+
+        // other fills are using all the iocbs, so this one is written right here
+        #ifdef DEBUG
+           fprintf (stdout, "No iocbs left for fill, writing %ld bytes on the caller\n", fill->last - fill->next);
+        #endif
+        while (fill->next < fill->last) {
+            long chunk = fill->last - fill->next;
+            if (chunk > ONE_MEGA) {
+                chunk = ONE_MEGA;
+            }
+            if (pwrite(fileHandle, oneMegaBuffer, (size_t)chunk, fill->next) < 0) {
+                free(fill);
+                releaseQueue(theControl, 1);
+                throwIOExceptionErrorNo(env, "Cannot initialize file: ", errno);
+                return;
+            }
+            fill->next += chunk;
+        }
+    }
+
+    // the iocb of the Java side was already taken
+    struct iocb * iocb = getInternalIOCB(theControl);
+    if (iocb == NULL) {
+        free(fill);
+        releaseQueue(theControl, 1);
+        throwIOException(env, "Not enough space in libaio queue");
+        return;
+    }
+
+    io_prep_pwrite(iocb, fileHandle, oneMegaBuffer, (size_t)(fill->size - fill->last), fill->last);
+    iocb->data = theControl->callbackSlots ? SLOT_TO_DATA(slot) : (void *) (*env)->NewGlobalRef(env, callback);
+    free(fill);
+
+    submit(env, theControl, iocb);
+}
+
+/**
+ * Submits the next stage of a chain, the fdatasync is done right here if the kernel can't do it asynchronously (< 4.18).
+ * It needs to be called holding fillLock, so the completions can't be handled before the chain is updated.
+ * @return 0 or -errno; the iocbs of the stage that were submitted before an error are still in flight
+ */
+static int chainStage(struct io_control * control, struct chain_control * chain) {
+    while (chain->next < chain->total) {
+        int end = chain->next < chain->barrier ? chain->barrier : chain->next == chain->barrier ? chain->barrier + 1 : chain->total;
+        while (chain->next < end) {
+            int result = engineSubmit(control, end - chain->next, chain->iocbs + chain->next);
+            if (result == -EINTR) {
+                continue;
+            }
+            if (result == -EINVAL && chain->next == chain->barrier) {
+                #ifdef DEBUG
+                   fprintf (stdout, "IOCB_CMD_FDSYNC is not supported, the chain is using fdatasync\n");
+                #endif
+                if (fdatasync(chain->fd) < 0) {
+                    return -errno;
+                }
+                // the iocb of the fdatasync is not needed anymore
+                putInternalIOCB(control, chain->iocbs[chain->next]);
+                releaseInternal(control, 1);
+                chain->next++;
+                continue;
+            }
+            if (result <= 0) {
+                // io_submit returns 0 when it could not take anything
+                return result < 0 ? result : -EAGAIN;
+            }
+            chain->next += result;
+            chain->inFlight += result;
+        }
+        if (chain->inFlight > 0) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * The stages of a chain are never delivered: each one is submitted once the previous one completed.
+ * When the last one completes its iocb carries the completion of the callback, with the first error if anything failed.
+ *
+ * @return 1 if the event was taken by a chain, 0 if it needs to be delivered
+ */
+static inline int chainEvent(struct io_control * control, struct io_event * event) {
+    struct iocb * iocbp = event->obj;
+    if (!(iocb_slot_of(iocbp)->flags & IOCB_SLOT_CHAIN)) {
+        return 0;
+    }
+
+    struct chain_control * chain = (struct chain_control *) iocbp->data;
+    long res = (long)event->res;
+    int i;
+
+    pthread_mutex_lock(&(control->fillLock));
+    chain->inFlight--;
+    if (chain->error == 0 && res < 0) {
+        chain->error = (int)-res;
+    } else if (chain->error == 0 && iocbp->aio_lio_opcode == IO_CMD_PWRITE && res != (long)iocbp->u.c.nbytes) {
+        chain->error = EIO;
+    }
+
+    if (chain->inFlight == 0 && chain->error == 0 && chain->next < chain->total) {
+        int result = chainStage(control, chain);
+        if (result < 0) {
+            chain->error = -result;
+        }
+    }
+
+    if (chain->inFlight > 0) {
+        // the stage in flight will carry on with the chain
+        putInternalIOCB(control, iocbp);
+        releaseInternal(control, 1);
+        pthread_mutex_unlock(&(control->fillLock));
+        return 1;
+    }
+
+    // the chain is over, what was not submitted goes back
+    for (i = chain->next; i < chain->total; i++) {
+        putInternalIOCB(control, chain->iocbs[i]);
+    }
+    releaseInternal(control, chain->total - chain->next);
+    pthread_mutex_unlock(&(control->fillLock));
+
+    int error = chain->error;
+    iocb_slot_of(iocbp)->flags = 0;
+    iocbp->data = chain->data;
+    free(chain);
+
+    #ifdef DEBUG
+       if (error) {
+          fprintf (stdout, "chain failed: %s\n", strerror(error));
+       }
+    #endif
+    event->res = (unsigned long)(long)-error;
+    return 0;
+}
+
+/**
+ * The events of fills and chains, handled by the native layer
+ * @return 1 if the event was taken, 0 if it needs to be delivered
+ */
+static inline int internalEvent(struct io_control * control, struct io_event * event) {
+    return fillEvent(control, event) || chainEvent(control, event);
+}
+
+/**
+ * Builds a chain of count writes with a fdatasync after the first barrier of them, and submits its first stage.
+ * The callback takes space from the Java side, the other iocbs come from the fill reserve if the context has one.
+ */
+static inline void submitChain(JNIEnv * env, struct io_control * theControl, jint fileHandle, jlongArray positions, jintArray sizes,
+                               jobjectArray buffers, jint count, jint barrier, jobject callback, jint slot) {
+    int i;
+    if (count <= 0 || count > MAX_CHAIN_WRITES || barrier < 0 || barrier > count) {
+        throwIOException(env, "Invalid count or barrier for chain");
+        return;
+    }
+
+    struct chain_control * chain = (struct chain_control *) malloc(sizeof(struct chain_control) + sizeof(struct iocb *) * (size_t)(count + 1));
+    if (chain == NULL) {
+        throwOutOfMemoryError(env);
+        return;
+    }
+    chain->fd = fileHandle;
+    chain->total = count + 1;
+    chain->barrier = barrier;
+    chain->next = 0;
+    chain->inFlight = 0;
+    chain->error = 0;
+
+    pthread_mutex_lock(&(theControl->fillLock));
+    if (!reserveInternal(theControl, count)) {
+        pthread_mutex_unlock(&(theControl->fillLock));
+        free(chain);
+        throwIOException(env, "Not enough space in libaio queue");
+        return;
+    }
+    pthread_mutex_unlock(&(theControl->fillLock));
+
+    // the iocb the callback is completed with counts on the Java side
+    if (!reserveQueue(theControl, 1)) {
+        pthread_mutex_lock(&(theControl->fillLock));
+        releaseInternal(theControl, count);
+        pthread_mutex_unlock(&(theControl->fillLock));
+        free(chain);
+        throwIOException(env, "Not enough space in libaio queue");
+        return;
+    }
+
+    if (!iocb_pool_get_all(&(theControl->iocbPool), chain->iocbs, chain->total)) {
+        releaseQueue(theControl, 1);
+        pthread_mutex_lock(&(theControl->fillLock));
+        releaseInternal(theControl, count);
+        pthread_mutex_unlock(&(theControl->fillLock));
+        free(chain);
+        throwIOException(env, "Not enough space in libaio queue");
+        return;
+    }
+
+    jlong * positionElements = (*env)->GetLongArrayElements(env, positions, NULL);
+    jint * sizeElements = (*env)->GetIntArrayElements(env, sizes, NULL);
+    int valid = positionElements != NULL && sizeElements != NULL;
+
+    for (i = 0; i < count && valid; i++) {
+        struct iocb * iocb = chain->iocbs[i < barrier ? i : i + 1];
+        jobject buffer = (*env)->GetObjectArrayElement(env, buffers, i);
+        void * data = buffer == NULL ? NULL : getBuffer(env, buffer);
+        if (buffer != NULL) {
+            (*env)->DeleteLocalRef(env, buffer);
+        }
+        if (data == NULL) {
+            valid = 0;
+            break;
+        }
+        io_prep_pwrite(iocb, fileHandle, data, (size_t)sizeElements[i], positionElements[i]);
+        iocb_slot_of(iocb)->flags = IOCB_SLOT_CHAIN;
+        iocb->data = chain;
+    }
+    io_prep_fdsync(chain->iocbs[barrier], fileHandle);
+    iocb_slot_of(chain->iocbs[barrier])->flags = IOCB_SLOT_CHAIN;
+    chain->iocbs[barrier]->data = chain;
+
+    if (positionElements != NULL) {
+        (*env)->ReleaseLongArrayElements(env, positions, positionElements, JNI_ABORT);
+    }
+    if (sizeElements != NULL) {
+        (*env)->ReleaseIntArrayElements(env, sizes, sizeElements, JNI_ABORT);
+    }
+
+    if (!valid) {
+        iocb_pool_put_all(&(theControl->iocbPool), chain->iocbs, chain->total);
+        releaseQueue(theControl, 1);
+        pthread_mutex_lock(&(theControl->fillLock));
+        releaseInternal(theControl, count);
+        pthread_mutex_unlock(&(theControl->fillLock));
+        free(chain);
+        if (!(*env)->ExceptionCheck(env)) {
+            throwRuntimeException(env, "Invalid Buffer used, libaio requires NativeBuffer instead of Java ByteBuffer");
+        }
+        return;
+    }
+
+    chain->data = theControl->callbackSlots ? SLOT_TO_DATA(slot) : (void *) (*env)->NewGlobalRef(env, callback);
+
+    pthread_mutex_lock(&(theControl->fillLock));
+    int result = chainStage(theControl, chain);
+    if (chain->inFlight > 0) {
+        if (result < 0) {
+            // the writes in flight will complete the callback with the error
+            chain->error = -result;
+        }
+        pthread_mutex_unlock(&(theControl->fillLock));
+        return;
+    }
+
+    // nothing went to the kernel: the chain can only have failed on its first submit
+    for (i = chain->next; i < chain->total; i++) {
+        putInternalIOCB(theControl, chain->iocbs[i]);
+    }
+    releaseInternal(theControl, count - chain->next);
+    pthread_mutex_unlock(&(theControl->fillLock));
+    releaseQueue(theControl, 1);
+
+    if (!theControl->callbackSlots) {
+        (*env)->DeleteGlobalRef(env, (jobject)chain->data);
+    }
+    free(chain);
+    throwIOExceptionErrorNo(env, "Error while submitting IO: ", result < 0 ? -result : EIO);
+}
+
+JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_lock
+  (JNIEnv * env, jclass  clazz, jint handle) {
+    return flock(handle, LOCK_EX | LOCK_NB) == 0;
+}
+
+
+static inline void freeEvents(struct io_control * theControl) {
+    if (theControl->eventsMemory.memory != NULL) {
+        locked_memory_unmap(&theControl->eventsMemory);
+    } else {
+        free(theControl->events);
+    }
+    theControl->events = NULL;
+}
+
+/**
+ * Everything that is allocated here will be freed at deleteContext when the class is unloaded.
+ */
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_newContext(JNIEnv* env, jobject thisObject, jint queueSize, jint flags, jint numaNode) {
+    #ifdef DEBUG
+        fprintf (stdout, "Initializing context, NUMA node %d\n", numaNode);
+    #endif
+
+    if (numaNode >= 0 && !numa_node_valid(numaNode)) {
+        throwRuntimeException(env, "Invalid NUMA node");
+        return NULL;
+    }
+    if (queueSize <= 0 || queueSize > INT_MAX - FILL_IOCBS) {
+        throwRuntimeException(env, "Invalid queue size");
+        return NULL;
+    }
+    if (numaNode < 0) {
+        numaNode = -1;
+    }
+    int fillReserve = (flags & CONTEXT_FILL_RESERVE) ? FILL_IOCBS : 0;
+
+    void * memory;
+    if (numa_node_memalign(&memory, IOCB_POOL_CACHE_LINE, sizeof(struct io_control), numaNode) != 0) {
+        throwOutOfMemoryError(env);
+        return NULL;
+    }
+	struct io_control * theControl = (struct io_control *) memory;
+
+    int res;
+    theControl->engine = ENGINE_LIBAIO;
+    theControl->numaNode = numaNode;
+    memset(&theControl->eventsMemory, 0, sizeof(struct locked_memory));
+    theControl->ioContext = NULL;
+    theControl->eventFd = -1;
+    theControl->stopping = 0;
+    theControl->statsEnabled = 0;
+    theControl->admissionSpins = 0;
+    theControl->admissionWaitNanos = 0;
+    theControl->admissionWaiters = 0;
+    theControl->fileLimits = NULL;
+    theControl->orderWindow = NULL;
+    theControl->orderMask = 0;
+    theControl->nextSequence = 0;
+    theControl->nextDelivery = 0;
+    memset(theControl->stats, 0, sizeof(theControl->stats));
+
+    // the rings are allocated by the kernel, following the memory policy of this thread
+    struct numa_node_policy policy;
+    int restorePolicy = numaNode >= 0 && numa_node_get_policy(&policy) == 0 && numa_node_set_policy(numaNode) == 0;
+
+    if ((flags & org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_CONTEXT_IO_URING) && uring_supported()) {
+        res = uring_init(&theControl->uring, (unsigned)(queueSize + fillReserve));
+        if (res == 0) {
+            theControl->engine = ENGINE_IO_URING;
+        } else {
+            // libaio is the fallback
+            #ifdef DEBUG
+                fprintf (stdout, "Could not initialize io_uring, using libaio: %s\n", strerror(-res));
+            #endif
+        }
+    }
+
+    if (theControl->engine == ENGINE_LIBAIO) {
+        res = io_queue_init(queueSize + fillReserve, &theControl->ioContext);
+        if (restorePolicy) {
+            numa_node_restore_policy(&policy);
+            restorePolicy = 0;
+        }
+        if (res) {
+            // Error, so need to release whatever was done before
+            io_queue_release(theControl->ioContext);
+            free(theControl);
+
+            throwRuntimeExceptionErrorNo(env, "Cannot initialize queue:", res);
+            return NULL;
+        }
+    }
+
+    if (restorePolicy) {
+        numa_node_restore_policy(&policy);
+    }
+
+    if (flags & org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_CONTEXT_EVENTFD) {
+        theControl->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        res = theControl->eventFd < 0 ? -errno : 0;
+        if (res == 0 && theControl->engine == ENGINE_IO_URING) {
+            res = uring_register_eventfd(&theControl->uring, theControl->eventFd);
+        }
+        if (res) {
+            engineRelease(theControl);
+            free(theControl);
+
+            throwRuntimeExceptionErrorNo(env, "Cannot initialize eventfd:", res);
+            return NULL;
+        }
+    }
+
+    theControl->queueSize = queueSize;
+    theControl->callbackSlots = (flags & org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_CONTEXT_CALLBACK_SLOTS) != 0;
+    theControl->spinIterations = 0;
+    theControl->spinNanos = 0;
+    theControl->spinHits = 0;
+    theControl->parks = 0;
+    theControl->syncs = 0;
+    theControl->queueIocbs = queueSize;
+    theControl->fillIocbs = fillReserve;
+    theControl->fillReserve = fillReserve;
+
+    // a single cache aligned slab for all the iocbs
+    if (iocb_pool_init(&(theControl->iocbPool), queueSize + fillReserve, numaNode, (flags & CONTEXT_HUGE_PAGES) != 0)) {
+        engineRelease(theControl);
+        free(theControl);
+
+        throwOutOfMemoryError(env);
+        return NULL;
+    }
+
+    res = pthread_mutex_init(&(theControl->pollLock), 0);
+    if (res) {
+        iocb_pool_destroy(&(theControl->iocbPool));
+
+        engineRelease(theControl);
+        free(theControl);
+
+        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext:", res);
+        return NULL;
+    }
+
+    res = pthread_mutex_init(&(theControl->fillLock), 0);
+    if (res) {
+        pthread_mutex_destroy(&(theControl->pollLock));
+        iocb_pool_destroy(&(theControl->iocbPool));
+
+        engineRelease(theControl);
+        free(theControl);
+
+        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext:", res);
+        return NULL;
+    }
+
+    res = initAdmission(theControl);
+    if (res) {
+        pthread_mutex_destroy(&(theControl->fillLock));
+        pthread_mutex_destroy(&(theControl->pollLock));
+        iocb_pool_destroy(&(theControl->iocbPool));
+
+        engineRelease(theControl);
+        free(theControl);
+
+        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext:", res);
+        return NULL;
+    }
+
+    if (flags & CONTEXT_HUGE_PAGES) {
+        // every drain of the ring is copied here, it can't take page faults once polling started
+        res = -locked_memory_map(&theControl->eventsMemory, sizeof(struct io_event) * (size_t)(queueSize + fillReserve), numaNode);
+        memory = theControl->eventsMemory.memory;
+    } else {
+        res = numa_node_memalign(&memory, IOCB_POOL_CACHE_LINE, sizeof(struct io_event) * (size_t)(queueSize + fillReserve), numaNode);
+    }
+    theControl->events = res == 0 ? (struct io_event *) memory : NULL;
+    if (theControl->events == NULL) {
+        destroyAdmission(theControl);
+        pthread_mutex_destroy(&(theControl->fillLock));
+        pthread_mutex_destroy(&(theControl->pollLock));
+        iocb_pool_destroy(&(theControl->iocbPool));
+
+        engineRelease(theControl);
+        free(theControl);
+
+        throwRuntimeExceptionErrorNo(env, "Can't initialize mutext (not enough memory for the events member): ", res);
+        return NULL;
+    }
+
+    theControl->syncFds = numa_node_memalign(&memory, IOCB_POOL_CACHE_LINE, sizeof(int) * (size_t)(queueSize + fillReserve), numaNode) == 0 ? (int *) memory : NULL;
+    if (theControl->syncFds == NULL) {
+        freeEvents(theControl);
+        destroyAdmission(theControl);
+        pthread_mutex_destroy(&(theControl->fillLock));
+        pthread_mutex_destroy(&(theControl->pollLock));
+        iocb_pool_destroy(&(theControl->iocbPool));
+
+        engineRelease(theControl);
+        free(theControl);
+
+        throwOutOfMemoryError(env);
+        return NULL;
+    }
+
+    if (flags & CONTEXT_ORDERED) {
+        unsigned windowSize = 1;
+        while (windowSize < (unsigned)(queueSize + fillReserve)) {
+            windowSize <<= 1;
+        }
+        if (numa_node_memalign(&memory, IOCB_POOL_CACHE_LINE, sizeof(struct order_entry) * windowSize, numaNode) == 0) {
+            memset(memory, 0, sizeof(struct order_entry) * windowSize);
+            theControl->orderWindow = (struct order_entry *) memory;
+        }
+        if (theControl->orderWindow == NULL) {
+            free(theControl->syncFds);
+            freeEvents(theControl);
+            destroyAdmission(theControl);
+            pthread_mutex_destroy(&(theControl->fillLock));
+            pthread_mutex_destroy(&(theControl->pollLock));
+            iocb_pool_destroy(&(theControl->iocbPool));
+
+            engineRelease(theControl);
+            free(theControl);
+
+            throwOutOfMemoryError(env);
+            return NULL;
+        }
+        theControl->orderMask = windowSize - 1;
+    }
+
+    theControl->thisObject = (*env)->NewGlobalRef(env, thisObject);
+
+    return (*env)->NewDirectByteBuffer(env, theControl, sizeof(struct io_control));
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_deleteContext(JNIEnv* env, jclass clazz, jobject contextPointer) {
+    int i;
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    // a blocked poll with a timeout would give up by itself at the next timeout
+    __atomic_store_n(&theControl->stopping, 1, __ATOMIC_RELEASE);
+
+    struct iocb * iocb = getIOCB(theControl);
+
+    if (iocb == NULL) {
+        throwIOException(env, "Not enough space in libaio queue");
+        return;
+    }
+
+    // Submitting a dumb write so a loop with no timeout finishes
+    io_prep_pwrite(iocb, dumbWriteHandler, 0, 0, 0);
+    iocb->data = (void *) -1;
+    if (!submit(env, theControl, iocb)) {
+        return;
+    }
+
+    // to make sure the poll has finished
+    pthread_mutex_lock(&(theControl->pollLock));
+    pthread_mutex_unlock(&(theControl->pollLock));
+
+    // To return any pending IOCBs
+    int result = engineGetEvents(theControl, 0, 1, theControl->events, 0);
+    for (i = 0; i < result; i++) {
+        struct io_event * event = &(theControl->events[i]);
+        struct iocb * iocbp = event->obj;
+        putIOCB(theControl, iocbp);
+    }
+
+    engineRelease(theControl);
+
+    destroyAdmission(theControl);
+    pthread_mutex_destroy(&(theControl->fillLock));
+    pthread_mutex_destroy(&(theControl->pollLock));
+
+    iocb_pool_destroy(&(theControl->iocbPool));
+
+    (*env)->DeleteGlobalRef(env, theControl->thisObject);
+
+    free(theControl->orderWindow);
+    free(theControl->syncFds);
+    freeEvents(theControl);
+    free(theControl);
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getEngine
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return -1;
+    }
+    return theControl->engine;
+}
+
+JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getLockedBytes
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return -1;
+    }
+    long locked = 0;
+    if (theControl->eventsMemory.locked) {
+        locked += (long) theControl->eventsMemory.size;
+    }
+    if (theControl->iocbPool.slabMemory.locked) {
+        locked += (long) theControl->iocbPool.slabMemory.size;
+    }
+    return locked;
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getEventFd
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return -1;
+    }
+    return theControl->eventFd;
+}
+
+/**
+ * Resets the eventfd of the context, without blocking.
+ * It returns how many completions were signaled since the last call, or 0 if none were.
+ */
+JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_drainEventFd
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL || theControl->eventFd < 0) {
+      return 0;
+    }
+
+    eventfd_t value = 0;
+    while (eventfd_read(theControl->eventFd, &value) < 0) {
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN) {
+            throwIOExceptionErrorNo(env, "Error reading eventfd: ", errno);
+        }
+        return 0;
+    }
+    return (jlong)value;
+}
+
+/**
+ * @return JNI_FALSE when the context is not on io_uring, and nothing is registered
+ */
+JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_registerBuffers
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jobjectArray buffers) {
+    int i;
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL || theControl->engine != ENGINE_IO_URING) {
+      return JNI_FALSE;
+    }
+
+    int count = (*env)->GetArrayLength(env, buffers);
+    if (count <= 0 || count > UINT16_MAX) {
+        throwRuntimeException(env, "Invalid number of buffers to register");
+        return JNI_FALSE;
+    }
+
+    struct iovec * iovecs = (struct iovec *) malloc(sizeof(struct iovec) * (size_t) count);
+    if (iovecs == NULL) {
+        throwOutOfMemoryError(env);
+        return JNI_FALSE;
+    }
+    for (i = 0; i < count; i++) {
+        jobject buffer = (*env)->GetObjectArrayElement(env, buffers, i);
+        iovecs[i].iov_base = buffer == NULL ? NULL : (*env)->GetDirectBufferAddress(env, buffer);
+        iovecs[i].iov_len = iovecs[i].iov_base == NULL ? 0 : (size_t) (*env)->GetDirectBufferCapacity(env, buffer);
+        if (buffer != NULL) {
+            (*env)->DeleteLocalRef(env, buffer);
+        }
+        if (iovecs[i].iov_base == NULL) {
+            free(iovecs);
+            throwRuntimeException(env, "Only direct buffers can be registered");
+            return JNI_FALSE;
+        }
+    }
+
+    int res = uring_register_buffers(&theControl->uring, iovecs, count);
+    free(iovecs);
+    if (res < 0) {
+        throwIOExceptionErrorNo(env, "Error registering buffers: ", -res);
+        return JNI_FALSE;
+    }
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_unregisterBuffers
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL || theControl->engine != ENGINE_IO_URING) {
+      return;
+    }
+    uring_unregister_buffers(&theControl->uring);
+}
+
+/**
+ * @return JNI_FALSE when the context is not on io_uring or the fd doesn't fit on the fixed file table
+ */
+JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_registerFile
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jint fd) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL || theControl->engine != ENGINE_IO_URING) {
+      return JNI_FALSE;
+    }
+    int res = uring_register_file(&theControl->uring, fd);
+    if (res < 0) {
+        throwIOExceptionErrorNo(env, "Error registering file: ", -res);
+        return JNI_FALSE;
+    }
+    return res ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_unregisterFile
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jint fd) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL || theControl->engine != ENGINE_IO_URING) {
+      return;
+    }
+    uring_unregister_file(&theControl->uring, fd);
+}
+
+JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_isIoUringSupported
+  (JNIEnv* env, jclass clazz) {
+    return uring_supported() ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_setHybridPoll
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jint spinIterations, jlong spinNanos) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+    __atomic_store_n(&theControl->spinIterations, (int)spinIterations, __ATOMIC_RELAXED);
+    __atomic_store_n(&theControl->spinNanos, (long)spinNanos, __ATOMIC_RELAXED);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_setAdmissionControl
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jint spinIterations, jlong maxWaitNanos) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+    __atomic_store_n(&theControl->admissionSpins, (int)spinIterations, __ATOMIC_RELAXED);
+    __atomic_store_n(&theControl->admissionWaitNanos, (long)maxWaitNanos, __ATOMIC_RELAXED);
+}
+
+/**
+ * Sets how many requests of fd can be in flight, 0 for no limit. The requests already in flight are not affected.
+ * @return false if fd is too big to have a limit
+ */
+JNIEXPORT jboolean JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_setFileLimit
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jint fd, jint limit) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return JNI_FALSE;
+    }
+    if (fd < 0 || fd >= FILE_LIMITS) {
+      return JNI_FALSE;
+    }
+
+    struct file_limit * limits = __atomic_load_n(&theControl->fileLimits, __ATOMIC_ACQUIRE);
+    if (limits == NULL) {
+        if (limit <= 0) {
+            return JNI_TRUE;
+        }
+        pthread_mutex_lock(&theControl->admissionLock);
+        limits = theControl->fileLimits;
+        if (limits == NULL) {
+            limits = (struct file_limit *) calloc(FILE_LIMITS, sizeof(struct file_limit));
+            if (limits == NULL) {
+                pthread_mutex_unlock(&theControl->admissionLock);
+                throwOutOfMemoryError(env);
+                return JNI_FALSE;
+            }
+            __atomic_store_n(&theControl->fileLimits, limits, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&theControl->admissionLock);
+    }
+
+    __atomic_store_n(&limits[fd].limit, limit > 0 ? (int)limit : 0, __ATOMIC_RELAXED);
+    // a parked submitter could be waiting on the old limit
+    wakeAdmission(theControl);
+    return JNI_TRUE;
+}
+
+JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getSpinHits
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return 0;
+    }
+    return __atomic_load_n(&theControl->spinHits, __ATOMIC_RELAXED);
+}
+
+JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getParks
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return 0;
+    }
+    return __atomic_load_n(&theControl->parks, __ATOMIC_RELAXED);
+}
+
+JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getSyncs
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return 0;
+    }
+    return __atomic_load_n(&theControl->syncs, __ATOMIC_RELAXED);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_setStatsEnabled
+  (JNIEnv* env, jclass clazz, jobject contextPointer, jboolean enabled) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+    __atomic_store_n(&theControl->statsEnabled, enabled ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * The stats of the context, as a direct buffer over the live counters: it is only valid until the context is deleted
+ */
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getStatsBuffer
+  (JNIEnv* env, jclass clazz, jobject contextPointer) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return NULL;
+    }
+    return (*env)->NewDirectByteBuffer(env, theControl->stats, sizeof(theControl->stats));
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_close(JNIEnv* env, jclass clazz, jint fd) {
+   if (close(fd) < 0) {
+       throwIOExceptionErrorNo(env, "Error closing file:", errno);
+   }
+}
+
+JNIEXPORT int JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_open(JNIEnv* env, jclass clazz,
+                        jstring path, jboolean direct) {
+    const char* f_path = (*env)->GetStringUTFChars(env, path, 0);
 
-    theControl->iocbPut = 0;
-    theControl->iocbGet = 0;
-    theControl->used = 0;
-    theControl->thisObject = (*env)->NewGlobalRef(env, thisObject);
-
-    return (*env)->NewDirectByteBuffer(env, theControl, sizeof(struct io_control));
+    int res;
+    if (direct) {
+      res = open(f_path, O_RDWR | O_CREAT | O_DIRECT, 0666);
+    } else {
+      res = open(f_path, O_RDWR | O_CREAT, 0666);
+    }
+
+    (*env)->ReleaseStringUTFChars(env, path, f_path);
+
+    if (res < 0) {
+       throwIOExceptionErrorNo(env, "Cannot open file:", errno);
+    }
+
+    return res;
 }
 
-JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_deleteContext(JNIEnv* env, jclass clazz, jobject contextPointer) {
-    int i;
+/**
+ * Opens a block device or a partition: never created, and exclusive (O_EXCL), so it fails with EBUSY
+ * while the device is mounted or open exclusively by anything else.
+ */
+JNIEXPORT int JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_openDevice(JNIEnv* env, jclass clazz,
+                        jstring path, jboolean direct) {
+    const char* f_path = (*env)->GetStringUTFChars(env, path, 0);
+    struct stat statBuffer;
+
+    int res = open(f_path, O_RDWR | O_EXCL | (direct ? O_DIRECT : 0));
+
+    (*env)->ReleaseStringUTFChars(env, path, f_path);
+
+    if (res < 0) {
+       throwIOExceptionErrorNo(env, "Cannot open device:", errno);
+       return res;
+    }
+
+    if (fstat(res, &statBuffer) < 0 || !S_ISBLK(statBuffer.st_mode)) {
+       close(res);
+       throwIOException(env, "Not a block device");
+       return -1;
+    }
+
+    return res;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitWrite
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlong position, jint size, jobject bufferWrite, jobject callback, jboolean durable) {
     struct io_control * theControl = getIOControl(env, contextPointer);
     if (theControl == NULL) {
       return;
     }
 
-    struct iocb * iocb = getIOCB(theControl);
+    #ifdef DEBUG
+       fprintf (stdout, "submitWrite position %ld, size %d\n", position, size);
+    #endif
+
+    int status;
+    struct iocb * iocb = admitIOCB(theControl, fileHandle, &status);
 
     if (iocb == NULL) {
-        throwIOException(env, "Not enough space in libaio queue");
+        throwAdmission(env, status);
         return;
     }
 
-    // Submitting a dumb write so the loop finishes
-    io_prep_pwrite(iocb, dumbWriteHandler, 0, 0, 0);
-    iocb->data = (void *) -1;
-    if (!submit(env, theControl, iocb)) {
+    io_prep_pwrite(iocb, fileHandle, getBuffer(env, bufferWrite), (size_t)size, position);
+    if (durable) {
+        prepDurable(iocb);
+    }
+
+    // The GlobalRef will be deleted when poll is called. this is done so
+    // the vm wouldn't crash if the Callback passed by the user is GCed between submission
+    // and callback.
+    // also as the real intention is to hold the reference until the life cycle is complete
+    iocb->data = (void *) (*env)->NewGlobalRef(env, callback);
+
+    submit(env, theControl, iocb);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitRead
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlong position, jint size, jobject bufferRead, jobject callback) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    int status;
+    struct iocb * iocb = admitIOCB(theControl, fileHandle, &status);
+
+    if (iocb == NULL) {
+        throwAdmission(env, status);
         return;
     }
 
-    // to make sure the poll has finished
-    pthread_mutex_lock(&(theControl->pollLock));
-    pthread_mutex_unlock(&(theControl->pollLock));
+    io_prep_pread(iocb, fileHandle, getBuffer(env, bufferRead), (size_t)size, position);
 
-    // To return any pending IOCBs
-    int result = ringio_get_events(theControl->ioContext, 0, 1, theControl->events, 0);
-    for (i = 0; i < result; i++) {
-        struct io_event * event = &(theControl->events[i]);
-        struct iocb * iocbp = event->obj;
-        putIOCB(theControl, iocbp);
+    // The GlobalRef will be deleted when poll is called. this is done so
+    // the vm wouldn't crash if the Callback passed by the user is GCed between submission
+    // and callback.
+    // also as the real intention is to hold the reference until the life cycle is complete
+    iocb->data = (void *) (*env)->NewGlobalRef(env, callback);
+
+    submit(env, theControl, iocb);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitWriteSlot
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlong position, jint size, jobject bufferWrite, jint slot, jboolean durable) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
     }
 
-    io_queue_release(theControl->ioContext);
+    #ifdef DEBUG
+       fprintf (stdout, "submitWriteSlot position %ld, size %d, slot %d\n", position, size, slot);
+    #endif
 
-    pthread_mutex_destroy(&(theControl->pollLock));
-    pthread_mutex_destroy(&(theControl->iocbLock));
+    int status;
+    struct iocb * iocb = admitIOCB(theControl, fileHandle, &status);
 
-    iocb_destroy(theControl);
+    if (iocb == NULL) {
+        throwAdmission(env, status);
+        return;
+    }
 
-    (*env)->DeleteGlobalRef(env, theControl->thisObject);
+    io_prep_pwrite(iocb, fileHandle, getBuffer(env, bufferWrite), (size_t)size, position);
+    if (durable) {
+        prepDurable(iocb);
+    }
 
-    free(theControl->events);
-    free(theControl);
+    // the callback is held by the Java side, only the slot id goes to the kernel
+    iocb->data = SLOT_TO_DATA(slot);
+
+    submit(env, theControl, iocb);
 }
 
-JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_close(JNIEnv* env, jclass clazz, jint fd) {
-   if (close(fd) < 0) {
-       throwIOExceptionErrorNo(env, "Error closing file:", errno);
-   }
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitReadSlot
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlong position, jint size, jobject bufferRead, jint slot) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    int status;
+    struct iocb * iocb = admitIOCB(theControl, fileHandle, &status);
+
+    if (iocb == NULL) {
+        throwAdmission(env, status);
+        return;
+    }
+
+    io_prep_pread(iocb, fileHandle, getBuffer(env, bufferRead), (size_t)size, position);
+
+    // the callback is held by the Java side, only the slot id goes to the kernel
+    iocb->data = SLOT_TO_DATA(slot);
+
+    submit(env, theControl, iocb);
 }
 
-JNIEXPORT int JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_open(JNIEnv* env, jclass clazz,
-                        jstring path, jboolean direct) {
-    const char* f_path = (*env)->GetStringUTFChars(env, path, 0);
+/**
+ * A submit that never throws, for callers that would rather back off than handle an exception.
+ * The callback is a GlobalRef held until the completion, unless the context uses callback slots in which case only the slot goes to the kernel.
+ * Nothing is kept when the iocb was not submitted.
+ *
+ * @return SUBMIT_OK, SUBMIT_QUEUE_FULL / SUBMIT_FILE_LIMIT if the admission control gave up, or -errno if the submit failed
+ */
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_trySubmit
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jboolean write, jlong position, jint size, jobject buffer, jobject callback, jint slot, jboolean durable) {
+    struct io_control * theControl = (struct io_control *) (*env)->GetDirectBufferAddress(env, contextPointer);
+    void * data = getBuffer(env, buffer);
+    if (theControl == NULL || data == NULL) {
+      return -EINVAL;
+    }
 
-    int res;
-    if (direct) {
-      res = open(f_path, O_RDWR | O_CREAT | O_DIRECT, 0666);
+    #ifdef DEBUG
+       fprintf (stdout, "trySubmit write %d, position %ld, size %d\n", (int)write, position, size);
+    #endif
+
+    int status;
+    struct iocb * iocb = admitIOCB(theControl, fileHandle, &status);
+    if (iocb == NULL) {
+        return status;
+    }
+
+    if (write) {
+        io_prep_pwrite(iocb, fileHandle, data, (size_t)size, position);
+        if (durable) {
+            prepDurable(iocb);
+        }
     } else {
-      res = open(f_path, O_RDWR | O_CREAT, 0666);
+        io_prep_pread(iocb, fileHandle, data, (size_t)size, position);
+    }
+
+    if (theControl->callbackSlots) {
+        iocb->data = SLOT_TO_DATA(slot);
+    } else {
+        iocb->data = (void *) (*env)->NewGlobalRef(env, callback);
+    }
+
+    int result = submitOne(theControl, iocb);
+    if (result < 0) {
+        if (!theControl->callbackSlots) {
+            (*env)->DeleteGlobalRef(env, (jobject)iocb->data);
+        }
+        releaseUnsubmitted(theControl, iocb);
+        // the kernel ran out of requests, it is the same as the queue being full for the caller
+        return result == -EAGAIN ? SUBMIT_QUEUE_FULL : result;
+    }
+    return SUBMIT_OK;
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitFill
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jint alignment, jlong size, jint depth, jboolean zeroRange, jobject callback) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "submitFill size %ld, depth %d\n", size, depth);
+    #endif
+
+    submitFill(env, theControl, fileHandle, alignment, size, depth, zeroRange, callback, 0);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitFillSlot
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jint alignment, jlong size, jint depth, jboolean zeroRange, jint slot) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "submitFillSlot size %ld, depth %d, slot %d\n", size, depth, slot);
+    #endif
+
+    submitFill(env, theControl, fileHandle, alignment, size, depth, zeroRange, NULL, slot);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitChain
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlongArray positions, jintArray sizes,
+   jobjectArray buffers, jint count, jint barrier, jobject callback) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "submitChain count %d, barrier %d\n", count, barrier);
+    #endif
+
+    submitChain(env, theControl, fileHandle, positions, sizes, buffers, count, barrier, callback, 0);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitChainSlot
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlongArray positions, jintArray sizes,
+   jobjectArray buffers, jint count, jint barrier, jint slot) {
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "submitChainSlot count %d, barrier %d, slot %d\n", count, barrier, slot);
+    #endif
+
+    submitChain(env, theControl, fileHandle, positions, sizes, buffers, count, barrier, NULL, slot);
+}
+
+/**
+ * A single scatter/gather submit: sizes[i] bytes from offsets[i] of buffers[i], with the iovecs held by the iocb slot.
+ * callback is only used without callback slots, slot only with them.
+ */
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitVectored
+  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jboolean write, jlong position, jobjectArray buffers,
+   jintArray offsets, jintArray sizes, jobject callback, jint slot, jboolean durable) {
+    int i;
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    jsize count = (*env)->GetArrayLength(env, buffers);
+    if (count <= 0 || count > IOCB_SLOT_IOVECS) {
+        throwIOException(env, "Vectored submits need between 1 and 3 buffers");
+        return;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "submitVectored write %d, position %ld, count %d\n", (int)write, position, count);
+    #endif
+
+    jint offsetElements[IOCB_SLOT_IOVECS];
+    jint sizeElements[IOCB_SLOT_IOVECS];
+    (*env)->GetIntArrayRegion(env, offsets, 0, count, offsetElements);
+    (*env)->GetIntArrayRegion(env, sizes, 0, count, sizeElements);
+    if ((*env)->ExceptionCheck(env)) {
+        return;
+    }
+
+    int status;
+    struct iocb * iocb = admitIOCB(theControl, fileHandle, &status);
+
+    if (iocb == NULL) {
+        throwAdmission(env, status);
+        return;
+    }
+
+    struct iovec * iovecs = iocb_slot_of(iocb)->iovecs;
+    for (i = 0; i < count; i++) {
+        jobject jbuffer = (*env)->GetObjectArrayElement(env, buffers, i);
+        char * buffer = jbuffer == NULL ? NULL : (char *) getBuffer(env, jbuffer);
+        if (jbuffer != NULL) {
+            (*env)->DeleteLocalRef(env, jbuffer);
+        }
+        if (buffer == NULL) {
+            putIOCB(theControl, iocb);
+            throwRuntimeException(env, "Invalid Buffer used, libaio requires NativeBuffer instead of Java ByteBuffer");
+            return;
+        }
+        iovecs[i].iov_base = buffer + offsetElements[i];
+        iovecs[i].iov_len = (size_t)sizeElements[i];
+    }
+
+    if (write) {
+        io_prep_pwritev(iocb, fileHandle, iovecs, count, position);
+        if (durable) {
+            prepDurable(iocb);
+        }
+    } else {
+        io_prep_preadv(iocb, fileHandle, iovecs, count, position);
+    }
+
+    if (theControl->callbackSlots) {
+        iocb->data = SLOT_TO_DATA(slot);
+    } else {
+        // The GlobalRef will be deleted when poll is called, as on submitWrite
+        iocb->data = (void *) (*env)->NewGlobalRef(env, callback);
+    }
+
+    submit(env, theControl, iocb);
+}
+
+// batches up to this size will keep their iocb pointers on the stack, bigger ones will need a malloc
+#define BATCH_STACK_SIZE 128
+
+/**
+ * Submits count writes with a single io_submit.
+ * If fds is NULL every write will go to fileHandle.
+ * It returns the number of submitted iocbs. The ones that could not be submitted are returned to the pool,
+ * and their callbacks will receive onError.
+ */
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitWriteBatch
+  (JNIEnv * env, jclass clazz, jobject contextPointer, jint fileHandle, jintArray fds, jlongArray positions, jintArray sizes,
+   jobjectArray buffers, jobjectArray callbacks, jintArray slots, jint count) {
+    int i;
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return 0;
+    }
+
+    if (count <= 0) {
+      return 0;
+    }
+
+    #ifdef DEBUG
+       fprintf (stdout, "submitWriteBatch count %d\n", count);
+    #endif
+
+    struct iocb * stackIocbs[BATCH_STACK_SIZE];
+    struct iocb ** iocbs = stackIocbs;
+
+    if (count > BATCH_STACK_SIZE) {
+        iocbs = (struct iocb **) malloc(sizeof(struct iocb *) * (size_t)count);
+        if (iocbs == NULL) {
+            throwOutOfMemoryError(env);
+            return 0;
+        }
+    }
+
+    jint * fdElements = fds == NULL ? NULL : (*env)->GetIntArrayElements(env, fds, NULL);
+    if (fds != NULL && fdElements == NULL) {
+        if (iocbs != stackIocbs) {
+            free(iocbs);
+        }
+        throwOutOfMemoryError(env);
+        return 0;
     }
 
-    (*env)->ReleaseStringUTFChars(env, path, f_path);
+    int status;
+    if (!admitIOCBs(theControl, fileHandle, fdElements, iocbs, count, &status)) {
+        if (fdElements != NULL) {
+            (*env)->ReleaseIntArrayElements(env, fds, fdElements, JNI_ABORT);
+        }
+        if (iocbs != stackIocbs) {
+            free(iocbs);
+        }
+        throwAdmission(env, status);
+        return 0;
+    }
+
+    jlong * positionElements = (*env)->GetLongArrayElements(env, positions, NULL);
+    jint * sizeElements = (*env)->GetIntArrayElements(env, sizes, NULL);
+    jint * slotElements = slots == NULL ? NULL : (*env)->GetIntArrayElements(env, slots, NULL);
+
+    for (i = 0; i < count; i++) {
+        jobject buffer = (*env)->GetObjectArrayElement(env, buffers, i);
+
+        io_prep_pwrite(iocbs[i], fdElements == NULL ? fileHandle : fdElements[i], getBuffer(env, buffer), (size_t)sizeElements[i], positionElements[i]);
+
+        if (slotElements != NULL) {
+            iocbs[i]->data = SLOT_TO_DATA(slotElements[i]);
+        } else {
+            jobject callback = (*env)->GetObjectArrayElement(env, callbacks, i);
+            // The GlobalRef will be deleted when poll is called, the same way as submitWrite
+            iocbs[i]->data = (void *) (*env)->NewGlobalRef(env, callback);
+            (*env)->DeleteLocalRef(env, callback);
+        }
 
-    if (res < 0) {
-       throwIOExceptionErrorNo(env, "Cannot open file:", errno);
+        (*env)->DeleteLocalRef(env, buffer);
     }
 
-    return res;
-}
+    if (slotElements != NULL) {
+        (*env)->ReleaseIntArrayElements(env, slots, slotElements, JNI_ABORT);
+    }
 
-JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitWrite
-  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlong position, jint size, jobject bufferWrite, jobject callback) {
-    struct io_control * theControl = getIOControl(env, contextPointer);
-    if (theControl == NULL) {
-      return;
+    if (fdElements != NULL) {
+        (*env)->ReleaseIntArrayElements(env, fds, fdElements, JNI_ABORT);
+    }
+    (*env)->ReleaseLongArrayElements(env, positions, positionElements, JNI_ABORT);
+    (*env)->ReleaseIntArrayElements(env, sizes, sizeElements, JNI_ABORT);
+
+    int submitted = 0;
+    int result = 0;
+    orderIOCBs(theControl, iocbs, count);
+    while (submitted < count) {
+        result = engineSubmit(theControl, count - submitted, iocbs + submitted);
+        if (result == -EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        // the kernel may take only part of the batch, we keep going with the rest
+        submitted += result;
     }
 
-    #ifdef DEBUG
-       fprintf (stdout, "submitWrite position %ld, size %d\n", position, size);
-    #endif
+    if (submitted < count) {
+        // io_submit returns 0 when it could not take anything, which is treated as the queue being full
+        int errorNumber = result < 0 ? -result : EAGAIN;
 
-    struct iocb * iocb = getIOCB(theControl);
+        #ifdef DEBUG
+           fprintf (stdout, "submitWriteBatch submitted %d out of %d, error=%d\n", submitted, count, errorNumber);
+        #endif
 
-    if (iocb == NULL) {
-        throwIOException(env, "Not enough space in libaio queue");
-        return;
+        for (i = submitted; i < count; i++) {
+            // with callback slots there is no GlobalRef, the Java side will release the slot
+            jobject callback = slots != NULL ? (*env)->GetObjectArrayElement(env, callbacks, i) : (jobject) iocbs[i]->data;
+            iocbs[i]->data = NULL;
+            if (callback != NULL) {
+                if (!(*env)->ExceptionCheck(env)) {
+                    jstring jstrError = (*env)->NewStringUTF(env, strerror(errorNumber));
+                    (*env)->CallVoidMethod(env, callback, errorMethod, (jint)errorNumber, jstrError);
+                    (*env)->DeleteLocalRef(env, jstrError);
+                }
+                if (slots != NULL) {
+                    (*env)->DeleteLocalRef(env, callback);
+                } else {
+                    (*env)->DeleteGlobalRef(env, callback);
+                }
+            }
+        }
+        if (theControl->orderWindow != NULL) {
+            for (i = submitted; i < count; i++) {
+                releaseUnsubmitted(theControl, iocbs[i]);
+            }
+        } else {
+            putIOCBs(theControl, iocbs + submitted, count - submitted);
+        }
     }
 
-    io_prep_pwrite(iocb, fileHandle, getBuffer(env, bufferWrite), (size_t)size, position);
+    if (iocbs != stackIocbs) {
+        free(iocbs);
+    }
 
-    // The GlobalRef will be deleted when poll is called. this is done so
-    // the vm wouldn't crash if the Callback passed by the user is GCed between submission
-    // and callback.
-    // also as the real intention is to hold the reference until the life cycle is complete
-    iocb->data = (void *) (*env)->NewGlobalRef(env, callback);
+    return submitted;
+}
 
-    submit(env, theControl, iocb);
+static inline int syncedEvent(struct iocb * iocbp, int allFiles) {
+    return iocbp->aio_fildes != dumbWriteHandler && (allFiles || (iocb_slot_of(iocbp)->flags & IOCB_SLOT_SYNC));
 }
 
-JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_submitRead
-  (JNIEnv * env, jclass clazz, jint fileHandle, jobject contextPointer, jlong position, jint size, jobject bufferRead, jobject callback) {
-    struct io_control * theControl = getIOControl(env, contextPointer);
-    if (theControl == NULL) {
-      return;
+/**
+ * The fdatasync of fd failed: the events that were waiting for it complete with the error instead,
+ * unless they had already failed by themselves
+ */
+static void syncFailed(struct io_control * control, int count, int allFiles, int fd, int error) {
+    int i;
+    #ifdef DEBUG
+        fprintf (stdout, "Group commit: fdatasync of %d failed: %s\n", fd, strerror(error));
+    #endif
+    for (i = 0; i < count; i++) {
+        struct io_event * event = &control->events[i];
+        struct iocb * iocbp = event->obj;
+        if (iocbp->aio_fildes == fd && syncedEvent(iocbp, allFiles) && (long)event->res >= 0) {
+            event->res = (unsigned long)(long)-error;
+        }
     }
+}
 
-    struct iocb * iocb = getIOCB(theControl);
-
-    if (iocb == NULL) {
-        throwIOException(env, "Not enough space in libaio queue");
-        return;
+/**
+ * Group commit: one fdatasync per distinct file on a round of events.
+ * It is called before any of the callbacks of the round is released, what won't happen before its file is synced.
+ * Files are synced in the order they first appear on the events.
+ * If allFiles is 0 only the files of durable writes without RWF_DSYNC are synced.
+ * When a fdatasync fails, the events of its file get the error as their result.
+ */
+static inline void syncFiles(struct io_control * control, int count, int allFiles) {
+    int i, j;
+    int files = 0;
+
+    for (i = 0; i < count; i++) {
+        struct iocb * iocbp = control->events[i].obj;
+        int fd = iocbp->aio_fildes;
+        if (!syncedEvent(iocbp, allFiles)) {
+            continue;
+        }
+        for (j = 0; j < files && control->syncFds[j] != fd; j++);
+        if (j == files) {
+            control->syncFds[files++] = fd;
+        }
     }
 
-    io_prep_pread(iocb, fileHandle, getBuffer(env, bufferRead), (size_t)size, position);
+    for (j = 0; j < files; j++) {
+        if (fdatasync(control->syncFds[j]) < 0) {
+            syncFailed(control, count, allFiles, control->syncFds[j], errno);
+        }
+    }
+    __atomic_store_n(&control->syncs, control->syncs + files, __ATOMIC_RELAXED);
 
-    // The GlobalRef will be deleted when poll is called. this is done so
-    // the vm wouldn't crash if the Callback passed by the user is GCed between submission
-    // and callback.
-    // also as the real intention is to hold the reference until the life cycle is complete
-    iocb->data = (void *) (*env)->NewGlobalRef(env, callback);
+    #ifdef DEBUG
+        fprintf (stdout, "Group commit: %d fdatasync for %d events\n", files, count);
+    #endif
+}
 
-    submit(env, theControl, iocb);
+// duplicate / invalid records from libaio: we switch to the system call from here on
+static inline void invalidRecord() {
+    if (!forceSysCall) {
+        fprintf (stdout, "Warning from ActiveMQ Artemis Native Layer: Your system is hitting duplicate / invalid records from libaio, which is a bug on the Linux Kernel you are using.\nYou should set property org.apache.activemq.artemis.native.jlibaio.FORCE_SYSCALL=1\nor upgrade to a kernel version that contains a fix");
+        fflush(stdout);
+    }
+    forceSysCall = JNI_TRUE;
 }
 
 JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_blockedPoll
-  (JNIEnv * env, jobject thisObject, jobject contextPointer, jboolean useFdatasync) {
+  (JNIEnv * env, jobject thisObject, jobject contextPointer, jboolean useFdatasync, jint minBatch, jlong timeoutNanos) {
 
     #ifdef DEBUG
        fprintf (stdout, "Running blockedPoll\n");
@@ -782,11 +2921,15 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
 
     short running = 1;
 
-    int lastFile = -1;
+    if (minBatch < 1) {
+        minBatch = 1;
+    } else if (minBatch > max) {
+        minBatch = max;
+    }
 
     while (running) {
 
-        int result = ringio_get_events(theControl->ioContext, 1, max, theControl->events, 0);
+        int result = pollEvents(theControl, minBatch, max, theControl->events, (long)timeoutNanos);
 
         if (result == -EINTR)
         {
@@ -805,7 +2948,9 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
            fflush(stdout);
         #endif
 
-        lastFile = -1;
+        if (useFdatasync || __atomic_load_n(&dsyncSupported, __ATOMIC_RELAXED) == 0) {
+            syncFiles(theControl, result, useFdatasync);
+        }
 
         for (i = 0; i < result; i++)
         {
@@ -826,12 +2971,10 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
                break;
             }
 
-            if (useFdatasync && lastFile != iocbp->aio_fildes) {
-                lastFile = iocbp->aio_fildes;
-                fdatasync(lastFile);
+            if (internalEvent(theControl, event)) {
+               continue;
             }
 
-
             int eventResult = (int)event->res;
 
             #ifdef DEBUG
@@ -861,13 +3004,124 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
                 // We delete the globalRef after the completion of the callback
                 (*env)->DeleteGlobalRef(env, obj);
             } else {
-                if (!forceSysCall) {
-                    fprintf (stdout, "Warning from ActiveMQ Artemis Native Layer: Your system is hitting duplicate / invalid records from libaio, which is a bug on the Linux Kernel you are using.\nYou should set property org.apache.activemq.artemis.native.jlibaio.FORCE_SYSCALL=1\nor upgrade to a kernel version that contains a fix");
-                    fflush(stdout);
-                }
-                forceSysCall = JNI_TRUE;
+                invalidRecord();
+            }
+
+        }
+
+        if (__atomic_load_n(&theControl->stopping, __ATOMIC_ACQUIRE)) {
+            running = 0;
+        }
+    }
+
+    pthread_mutex_unlock(&(theControl->pollLock));
+
+}
+
+/**
+ * The blocked poll for callback slots.
+ * Instead of one upcall per event, each round of events is written to completions as pairs of (slot, result)
+ * and the Java side is called once with doneBatch(count).
+ * completions is a direct buffer with space for queueSize pairs of jint, on the native order.
+ */
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_blockedPollSlots
+  (JNIEnv * env, jobject thisObject, jobject contextPointer, jboolean useFdatasync, jobject completions, jint minBatch, jlong timeoutNanos) {
+
+    #ifdef DEBUG
+       fprintf (stdout, "Running blockedPollSlots\n");
+       fflush(stdout);
+    #endif
+
+    int i;
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return;
+    }
+
+    jint * completionPairs = (jint *) getBuffer(env, completions);
+    if (completionPairs == NULL || (*env)->GetDirectBufferCapacity(env, completions) < (jlong)sizeof(jint) * 2 * theControl->queueSize) {
+        throwRuntimeException(env, "The completions buffer needs space for queueSize slots and results");
+        return;
+    }
+
+    int max = theControl->queueSize;
+    pthread_mutex_lock(&(theControl->pollLock));
+
+    short running = 1;
+
+    if (minBatch < 1) {
+        minBatch = 1;
+    } else if (minBatch > max) {
+        minBatch = max;
+    }
+
+    while (running) {
+
+        int result = pollEvents(theControl, minBatch, max, theControl->events, (long)timeoutNanos);
+
+        if (result == -EINTR)
+        {
+           // ARTEMIS-353: jmap will issue some weird interrupt signal what would break the execution here
+           // we need to ignore such calls here
+           continue;
+        }
+
+        if (result < 0)
+        {
+            throwIOExceptionErrorNo(env, "Error while calling io_getevents IO: ", -result);
+            break;
+        }
+        #ifdef DEBUG
+           fprintf (stdout, "blockedPollSlots returned %d events\n", result);
+           fflush(stdout);
+        #endif
+
+        if (useFdatasync || __atomic_load_n(&dsyncSupported, __ATOMIC_RELAXED) == 0) {
+            syncFiles(theControl, result, useFdatasync);
+        }
+
+        int filled = 0;
+
+        for (i = 0; i < result; i++)
+        {
+            struct io_event * event = &(theControl->events[i]);
+            struct iocb * iocbp = event->obj;
+
+            if (iocbp->aio_fildes == dumbWriteHandler) {
+               #ifdef DEBUG
+                  fprintf (stdout, "Dumb write arrived, giving up the loop\n");
+                  fflush(stdout);
+               #endif
+               putIOCB(theControl, iocbp);
+               // the events of this round are still delivered
+               running = 0;
+               continue;
+            }
+
+            if (internalEvent(theControl, event)) {
+               continue;
+            }
+
+            void * data = iocbp->data;
+            iocbp->data = NULL; // this is to detect invalid elements on the buffer.
+
+            if (data != NULL) {
+                // the result is the negative errno in case of failures, the Java side will produce the error message
+                completionPairs[filled * 2] = DATA_TO_SLOT(data);
+                completionPairs[filled * 2 + 1] = (jint)event->res;
+                filled++;
+                putIOCB(theControl, iocbp);
+            } else {
+                invalidRecord();
             }
+        }
 
+        if (filled > 0) {
+            (*env)->CallVoidMethod(env, theControl->thisObject, libaioContextDoneBatch, (jint)filled);
+        }
+
+        if (__atomic_load_n(&theControl->stopping, __ATOMIC_ACQUIRE)) {
+            running = 0;
         }
     }
 
@@ -876,7 +3130,7 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
 }
 
 JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_poll
-  (JNIEnv * env, jobject obj, jobject contextPointer, jobjectArray callbacks, jint min, jint max) {
+  (JNIEnv * env, jobject obj, jobject contextPointer, jobjectArray callbacks, jint min, jint max, jlong timeoutNanos) {
     int i = 0;
     struct io_control * theControl = getIOControl(env, contextPointer);
     if (theControl == NULL) {
@@ -884,12 +3138,22 @@ JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
     }
 
 
-    int result = ringio_get_events(theControl->ioContext, min, max, theControl->events, 0);
-    int retVal = result;
+    int result = pollEvents(theControl, min, max, theControl->events, (long)timeoutNanos);
+
+    if (result > 0 && __atomic_load_n(&dsyncSupported, __ATOMIC_RELAXED) == 0) {
+        // durable writes without RWF_DSYNC
+        syncFiles(theControl, result, 0);
+    }
+    int filled = 0;
 
     for (i = 0; i < result; i++) {
         struct io_event * event = &(theControl->events[i]);
         struct iocb * iocbp = event->obj;
+
+        if (internalEvent(theControl, event)) {
+            continue;
+        }
+
         int eventResult = (int)event->res;
 
         #ifdef DEBUG
@@ -909,19 +3173,88 @@ JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
         }
 
         if (iocbp->data != NULL && iocbp->data != (void *) -1) {
-            (*env)->SetObjectArrayElement(env, callbacks, i, (jobject)iocbp->data);
+            (*env)->SetObjectArrayElement(env, callbacks, filled, (jobject)iocbp->data);
             // We delete the globalRef after the completion of the callback
             (*env)->DeleteGlobalRef(env, (jobject)iocbp->data);
         }
+        filled++;
 
         putIOCB(theControl, iocbp);
     }
 
-    return retVal;
+    return result < 0 ? result : filled;
 }
 
-JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_newAlignedBuffer
-(JNIEnv * env, jclass clazz, jint size, jint alignment) {
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_pollSlots
+  (JNIEnv * env, jobject obj, jobject contextPointer, jintArray completions, jint min, jint max, jlong timeoutNanos) {
+    int i = 0;
+    int filled = 0;
+    struct io_control * theControl = getIOControl(env, contextPointer);
+    if (theControl == NULL) {
+      return 0;
+    }
+
+    if (max > theControl->queueSize) {
+        max = theControl->queueSize;
+    }
+
+    int result = pollEvents(theControl, min, max, theControl->events, (long)timeoutNanos);
+
+    if (result > 0 && __atomic_load_n(&dsyncSupported, __ATOMIC_RELAXED) == 0) {
+        // durable writes without RWF_DSYNC
+        syncFiles(theControl, result, 0);
+    }
+    if (result <= 0) {
+        return result;
+    }
+
+    jint * completionElements = (*env)->GetIntArrayElements(env, completions, NULL);
+    if (completionElements == NULL) {
+        // we can't leak the iocbs even if the completions are lost
+        for (i = 0; i < result; i++) {
+            if (!internalEvent(theControl, &(theControl->events[i]))) {
+                putIOCB(theControl, theControl->events[i].obj);
+            }
+        }
+        throwOutOfMemoryError(env);
+        return 0;
+    }
+
+    for (i = 0; i < result; i++) {
+        struct io_event * event = &(theControl->events[i]);
+        struct iocb * iocbp = event->obj;
+
+        if (internalEvent(theControl, event)) {
+            continue;
+        }
+
+        void * data = iocbp->data;
+        iocbp->data = NULL;
+
+        #ifdef DEBUG
+            fprintf (stdout, "Poll res: %d totalRes=%d\n", (int)event->res, result);
+        #endif
+
+        if (data != NULL && data != (void *) -1) {
+            completionElements[filled * 2] = DATA_TO_SLOT(data);
+            completionElements[filled * 2 + 1] = (jint)event->res;
+            filled++;
+        }
+
+        putIOCB(theControl, iocbp);
+    }
+
+    (*env)->ReleaseIntArrayElements(env, completions, completionElements, 0);
+
+    return filled;
+}
+
+JNIEXPORT jstring JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_strError
+  (JNIEnv * env, jclass clazz, jint errorNumber) {
+    return (*env)->NewStringUTF(env, strerror(errorNumber));
+}
+
+static inline jobject newAlignedBuffer(JNIEnv * env, jint size, jint alignment, jint numaNode) {
     if (size % alignment != 0) {
         throwRuntimeException(env, "Buffer size needs to be aligned to passed argument");
         return NULL;
@@ -931,7 +3264,7 @@ JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_Libaio
     // Buffers created here need to be manually destroyed by destroyBuffer, or this would leak on the process heap away of Java's GC managed memory
     // NOTE: this buffer will contain non initialized data, you must fill it up properly
     void * buffer;
-    int result = posix_memalign(&buffer, (size_t)alignment, (size_t)size);
+    int result = numa_node_memalign(&buffer, (size_t)alignment, (size_t)size, numaNode);
 
     if (result) {
         throwRuntimeExceptionErrorNo(env, "Can't allocate posix buffer:", result);
@@ -943,6 +3276,20 @@ JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_Libaio
     return (*env)->NewDirectByteBuffer(env, buffer, size);
 }
 
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_newAlignedBuffer
+(JNIEnv * env, jclass clazz, jint size, jint alignment) {
+    return newAlignedBuffer(env, size, alignment, -1);
+}
+
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_newAlignedNodeBuffer
+(JNIEnv * env, jclass clazz, jint size, jint alignment, jint numaNode) {
+    if (!numa_node_valid(numaNode)) {
+        throwRuntimeException(env, "Invalid NUMA node");
+        return NULL;
+    }
+    return newAlignedBuffer(env, size, alignment, numaNode);
+}
+
 JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_freeBuffer
   (JNIEnv * env, jclass clazz, jobject jbuffer) {
     if (jbuffer == NULL)
@@ -955,6 +3302,105 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
 }
 
 
+static inline struct buffer_pool * getBufferPool(JNIEnv* env, jobject pointer) {
+    struct buffer_pool * pool = (struct buffer_pool *) (*env)->GetDirectBufferAddress(env, pointer);
+    if (pool == NULL) {
+       throwRuntimeException(env, "Buffer pool not initialized");
+    }
+    return pool;
+}
+
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_newBufferPool
+  (JNIEnv * env, jclass clazz, jint alignment, jint flags, jint numaNode) {
+    if (alignment <= 0) {
+        throwRuntimeException(env, "Invalid alignment");
+        return NULL;
+    }
+    if (numaNode >= 0 && !numa_node_valid(numaNode)) {
+        throwRuntimeException(env, "Invalid NUMA node");
+        return NULL;
+    }
+
+    struct buffer_pool * pool = (struct buffer_pool *) malloc(sizeof(struct buffer_pool));
+    if (pool == NULL) {
+        throwOutOfMemoryError(env);
+        return NULL;
+    }
+
+    if (buffer_pool_init(pool, (size_t)alignment, flags, numaNode < 0 ? -1 : numaNode)) {
+        free(pool);
+        throwRuntimeException(env, "The alignment of a buffer pool needs to be a power of 2, up to 2MB");
+        return NULL;
+    }
+
+    return (*env)->NewDirectByteBuffer(env, pool, sizeof(struct buffer_pool));
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_deleteBufferPool
+  (JNIEnv * env, jclass clazz, jobject poolPointer) {
+    struct buffer_pool * pool = getBufferPool(env, poolPointer);
+    if (pool == NULL) {
+        return;
+    }
+    buffer_pool_destroy(pool);
+    free(pool);
+}
+
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_acquireBuffer
+  (JNIEnv * env, jclass clazz, jobject poolPointer, jint size) {
+    struct buffer_pool * pool = getBufferPool(env, poolPointer);
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    if (size <= 0 || size % pool->alignment != 0) {
+        throwRuntimeException(env, "Buffer size needs to be aligned to the alignment of the pool");
+        return NULL;
+    }
+
+    void * buffer = buffer_pool_acquire(pool, (size_t)size);
+    if (buffer == NULL) {
+        throwRuntimeExceptionErrorNo(env, "Can't allocate pooled buffer:", ENOMEM);
+        return NULL;
+    }
+
+    return (*env)->NewDirectByteBuffer(env, buffer, size);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_releaseBuffer
+  (JNIEnv * env, jclass clazz, jobject poolPointer, jobject jbuffer) {
+    struct buffer_pool * pool = getBufferPool(env, poolPointer);
+    if (pool == NULL) {
+        return;
+    }
+    if (jbuffer == NULL) {
+        throwRuntimeException(env, "Null pointer");
+        return;
+    }
+
+    void * buffer = (*env)->GetDirectBufferAddress(env, jbuffer);
+    jlong size = (*env)->GetDirectBufferCapacity(env, jbuffer);
+
+    // if there's no memory to keep it on the free list the buffer is only released when the pool is deleted
+    if (buffer == NULL || size <= 0 || buffer_pool_release(pool, buffer, (size_t)size) == -2) {
+        throwRuntimeException(env, "Buffer wasn't acquired from this pool, or it was already released");
+    }
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getBufferPoolStats
+  (JNIEnv * env, jclass clazz, jobject poolPointer, jlongArray jstats) {
+    struct buffer_pool * pool = getBufferPool(env, poolPointer);
+    if (pool == NULL) {
+        return;
+    }
+
+    jlong stats[3];
+    stats[0] = __atomic_load_n(&pool->outstandingBytes, __ATOMIC_RELAXED);
+    stats[1] = __atomic_load_n(&pool->pooledBytes, __ATOMIC_RELAXED);
+    stats[2] = __atomic_load_n(&pool->reservedBytes, __ATOMIC_RELAXED);
+    (*env)->SetLongArrayRegion(env, jstats, 0, 3, stats);
+}
+
 /** It does nothing... just return true to make sure it has all the binary dependencies */
 JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getNativeVersion
   (JNIEnv * env, jclass clazz)
@@ -973,9 +3419,180 @@ JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCo
         throwIOExceptionErrorNo(env, "Cannot determine file size:", errno);
         return -1l;
     }
+
+    if (S_ISBLK(statBuffer.st_mode))
+    {
+        // st_size is 0 for block devices
+        unsigned long long deviceSize;
+        if (ioctl(fd, BLKGETSIZE64, &deviceSize) < 0)
+        {
+            throwIOExceptionErrorNo(env, "Cannot determine device size:", errno);
+            return -1l;
+        }
+        return (jlong) deviceSize;
+    }
     return statBuffer.st_size;
 }
 
+// statx goes through syscall: the release is built on glibc 2.17, that has no statx and no STATX_DIOALIGN (6.1+),
+// so the kernel the library runs on is the one to tell if it has the DIO alignments
+#ifndef __NR_statx
+#if defined(__x86_64__)
+#define __NR_statx 332
+#elif defined(__i386__)
+#define __NR_statx 383
+#elif defined(__aarch64__) || defined(__riscv)
+#define __NR_statx 291
+#elif defined(__powerpc__)
+#define __NR_statx 383
+#elif defined(__s390__)
+#define __NR_statx 379
+#endif
+#endif
+
+#ifndef AT_EMPTY_PATH
+#define AT_EMPTY_PATH 0x1000
+#endif
+
+#define DIOALIGN_STATX_MASK 0x00002000U
+
+/*
+ * struct statx up to the DIO alignments, with the same layout as linux/stat.h,
+ * padded to the 256 bytes the kernel always writes
+ */
+struct dioalign_statx {
+    uint32_t mask;
+    uint32_t blksize;
+    uint64_t attributes;
+    uint32_t nlink;
+    uint32_t uid;
+    uint32_t gid;
+    uint16_t mode;
+    uint16_t spare0;
+    uint64_t ino;
+    uint64_t size;
+    uint64_t blocks;
+    uint64_t attributesMask;
+    // atime, btime, ctime and mtime
+    uint64_t timestamps[8];
+    uint32_t rdevMajor;
+    uint32_t rdevMinor;
+    uint32_t devMajor;
+    uint32_t devMinor;
+    uint64_t mountId;
+    uint32_t dioMemoryAlign;
+    uint32_t dioOffsetAlign;
+    uint64_t spare[12];
+};
+
+/**
+ * The O_DIRECT alignments of statx(STATX_DIOALIGN)
+ * @return 0, or -1 if the kernel (< 6.1) or the file system doesn't report them
+ */
+static int dioAlignment(int fd, jint * memoryAlign, jint * offsetAlign) {
+#ifdef __NR_statx
+    struct dioalign_statx statxBuffer;
+    memset(&statxBuffer, 0, sizeof(statxBuffer));
+    if (syscall(__NR_statx, fd, "", AT_EMPTY_PATH, DIOALIGN_STATX_MASK, &statxBuffer) == 0
+        && (statxBuffer.mask & DIOALIGN_STATX_MASK) && statxBuffer.dioOffsetAlign != 0) {
+        // 0 would mean the file doesn't support O_DIRECT at all
+        *memoryAlign = (jint) statxBuffer.dioMemoryAlign;
+        *offsetAlign = (jint) statxBuffer.dioOffsetAlign;
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+/**
+ * Reads a queue attribute of the device of a file from sysfs, on the disk itself for a partition.
+ * @return the value, or 0 if it is not there
+ */
+static int deviceQueueAttribute(dev_t device, const char * attribute) {
+    char path[128];
+    int value = 0;
+    int i;
+    for (i = 0; i < 2; i++) {
+        // a partition has no queue of its own, its parent directory is the disk
+        snprintf(path, sizeof(path), i == 0 ? "/sys/dev/block/%u:%u/queue/%s" : "/sys/dev/block/%u:%u/../queue/%s",
+                 major(device), minor(device), attribute);
+        FILE * file = fopen(path, "r");
+        if (file != NULL) {
+            if (fscanf(file, "%d", &value) != 1) {
+                value = 0;
+            }
+            fclose(file);
+            return value;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Fills alignment with what the device and the file system report, 0 for anything that is unknown:
+ * the sector sizes and the optimal I/O size of the device (BLKSSZGET, BLKPBSZGET, BLKIOOPT on a block device,
+ * the queue attributes on sysfs for a file), the O_DIRECT alignments of statx(STATX_DIOALIGN) (6.1+), and st_blksize.
+ */
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getAlignment
+  (JNIEnv * env, jclass clazz, jint fd, jintArray jalignment)
+{
+    jint alignment[ALIGNMENT_LENGTH];
+    struct stat statBuffer;
+
+    if ((*env)->GetArrayLength(env, jalignment) < ALIGNMENT_LENGTH)
+    {
+        throwRuntimeException(env, "Invalid alignment array");
+        return;
+    }
+
+    if (fstat(fd, &statBuffer) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Cannot stat file: ", errno);
+        return;
+    }
+
+    memset(alignment, 0, sizeof(alignment));
+    alignment[ALIGNMENT_FILE_SYSTEM] = (jint) statBuffer.st_blksize;
+
+    if (S_ISBLK(statBuffer.st_mode))
+    {
+        int logical = 0;
+        unsigned int physical = 0;
+        unsigned int optimal = 0;
+        if (ioctl(fd, BLKSSZGET, &logical) == 0)
+        {
+            alignment[ALIGNMENT_LOGICAL] = logical;
+        }
+        if (ioctl(fd, BLKPBSZGET, &physical) == 0)
+        {
+            alignment[ALIGNMENT_PHYSICAL] = (jint) physical;
+        }
+        if (ioctl(fd, BLKIOOPT, &optimal) == 0)
+        {
+            alignment[ALIGNMENT_OPTIMAL_IO] = (jint) optimal;
+        }
+        // the block layer only needs the buffers aligned to the logical sector
+        alignment[ALIGNMENT_DIO_MEMORY] = logical;
+        alignment[ALIGNMENT_DIO_OFFSET] = logical;
+    }
+    else
+    {
+        alignment[ALIGNMENT_LOGICAL] = deviceQueueAttribute(statBuffer.st_dev, "logical_block_size");
+        alignment[ALIGNMENT_PHYSICAL] = deviceQueueAttribute(statBuffer.st_dev, "physical_block_size");
+        alignment[ALIGNMENT_OPTIMAL_IO] = deviceQueueAttribute(statBuffer.st_dev, "optimal_io_size");
+    }
+
+    dioAlignment(fd, &alignment[ALIGNMENT_DIO_MEMORY], &alignment[ALIGNMENT_DIO_OFFSET]);
+
+    #ifdef DEBUG
+        fprintf (stdout, "alignment logical=%d, physical=%d, optimal=%d, dioMemory=%d, dioOffset=%d, blksize=%d\n",
+                 alignment[ALIGNMENT_LOGICAL], alignment[ALIGNMENT_PHYSICAL], alignment[ALIGNMENT_OPTIMAL_IO],
+                 alignment[ALIGNMENT_DIO_MEMORY], alignment[ALIGNMENT_DIO_OFFSET], alignment[ALIGNMENT_FILE_SYSTEM]);
+    #endif
+
+    (*env)->SetIntArrayRegion(env, jalignment, 0, ALIGNMENT_LENGTH, alignment);
+}
+
 JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getBlockSizeFD
   (JNIEnv * env, jclass clazz, jint fd)
 {
@@ -1006,6 +3623,73 @@ JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
     return statBuffer.st_blksize;
 }
 
+JNIEXPORT jlong JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_getDevice
+  (JNIEnv * env, jclass clazz, jint fd)
+{
+    struct stat statBuffer;
+
+    if (fstat(fd, &statBuffer) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Cannot stat file: ", errno);
+        return -1l;
+    }
+
+    return S_ISBLK(statBuffer.st_mode) ? (jlong)statBuffer.st_rdev : (jlong)statBuffer.st_dev;
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_setThreadAffinity
+  (JNIEnv * env, jclass clazz, jint cpu)
+{
+    cpu_set_t cpuSet;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        return EINVAL;
+    }
+
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+}
+
+JNIEXPORT jint JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_setThreadNode
+  (JNIEnv * env, jclass clazz, jint node)
+{
+    cpu_set_t cpuSet;
+
+    if (!numa_node_valid(node))
+    {
+        return EINVAL;
+    }
+
+    int result = numa_node_cpus(node, &cpuSet);
+    if (result == 0)
+    {
+        result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+    }
+    else if (node == 0 && result == -ENOENT)
+    {
+        // no NUMA support on the kernel, all the cpus are on node 0
+        result = 0;
+    }
+    else
+    {
+        result = -result;
+    }
+
+    if (result == 0)
+    {
+        // what the thread allocates from now on, when the memory policy is supported
+        int policy = numa_node_set_policy(node);
+        if (policy < 0 && policy != -ENOSYS)
+        {
+            result = -policy;
+        }
+    }
+    return result;
+}
+
 JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_fallocate
   (JNIEnv * env, jclass clazz, jint fd, jlong size)
 {
@@ -1017,6 +3701,137 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
     lseek (fd, 0, SEEK_SET);
 }
 
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_fallocateRange
+  (JNIEnv * env, jclass clazz, jint fd, jint mode, jlong offset, jlong length, jboolean sync)
+{
+    int flags = 0;
+
+    if (mode & org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_FALLOCATE_KEEP_SIZE) {
+        flags |= FALLOC_FL_KEEP_SIZE;
+    }
+    if (mode & org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_FALLOCATE_ZERO_RANGE) {
+        flags |= FALLOC_FL_ZERO_RANGE;
+    }
+    if (mode & org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_FALLOCATE_PUNCH_HOLE) {
+        // the kernel only accepts punching holes together with keep size
+        flags |= FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+    }
+
+    #ifdef DEBUG
+        fprintf (stdout, "fallocate mode=%d, offset=%ld, length=%ld, sync=%d\n", flags, (long)offset, (long)length, (int)sync);
+    #endif
+
+    if (fallocate(fd, flags, (off_t) offset, (off_t) length) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Could not fallocate file: ", errno);
+        return;
+    }
+
+    if (sync && fdatasync(fd) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Could not sync file after fallocate: ", errno);
+    }
+}
+
+/**
+ * Maps the first size bytes of the file, MAP_SHARED so the stores on the buffer go to the page cache of the file.
+ */
+JNIEXPORT jobject JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_map
+  (JNIEnv * env, jclass clazz, jint fd, jlong size)
+{
+    if (size <= 0 || size > INT_MAX)
+    {
+        throwIOException(env, "Invalid size for a mapping");
+        return NULL;
+    }
+
+    void * mapping = mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        throwIOExceptionErrorNo(env, "Could not map file: ", errno);
+        return NULL;
+    }
+
+    #ifdef DEBUG
+        fprintf (stdout, "map fd=%d, size=%ld at %p\n", fd, (long)size, mapping);
+    #endif
+
+    return (*env)->NewDirectByteBuffer(env, mapping, size);
+}
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_unmap
+  (JNIEnv * env, jclass clazz, jobject jmapping)
+{
+    void * mapping = (*env)->GetDirectBufferAddress(env, jmapping);
+    if (mapping == NULL)
+    {
+        throwRuntimeException(env, "Invalid mapping");
+        return;
+    }
+
+    if (munmap(mapping, (size_t) (*env)->GetDirectBufferCapacity(env, jmapping)) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Could not unmap file: ", errno);
+    }
+}
+
+/**
+ * Writes back the pages of [offset, offset + length) of a mapping and waits for them (msync(MS_SYNC)).
+ * The range is widened to whole pages, as msync needs.
+ */
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_syncMapping
+  (JNIEnv * env, jclass clazz, jobject jmapping, jlong offset, jlong length)
+{
+    char * mapping = (char *) (*env)->GetDirectBufferAddress(env, jmapping);
+    jlong capacity = (*env)->GetDirectBufferCapacity(env, jmapping);
+    if (mapping == NULL)
+    {
+        throwRuntimeException(env, "Invalid mapping");
+        return;
+    }
+    if (offset < 0 || length < 0 || offset + length > capacity)
+    {
+        throwIOException(env, "Range out of the mapping");
+        return;
+    }
+    if (length == 0)
+    {
+        return;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    jlong start = offset & ~((jlong) page - 1);
+
+    #ifdef DEBUG
+        fprintf (stdout, "msync offset=%ld, length=%ld\n", (long)start, (long)(offset + length - start));
+    #endif
+
+    if (msync(mapping + start, (size_t) (offset + length - start), MS_SYNC) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Could not sync mapping: ", errno);
+    }
+}
+
+/**
+ * Starts the write back of a range of the file (sync_file_range), waiting for it if wait is set.
+ * It doesn't flush the metadata nor the cache of the device, so it is not a replacement for msync / fdatasync:
+ * it takes the write back of a range out of the following sync.
+ */
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_syncFileRange
+  (JNIEnv * env, jclass clazz, jint fd, jlong offset, jlong length, jboolean wait)
+{
+    unsigned int flags = SYNC_FILE_RANGE_WRITE;
+    if (wait)
+    {
+        flags |= SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WAIT_AFTER;
+    }
+
+    if (sync_file_range(fd, (off64_t) offset, (off64_t) length, flags) < 0)
+    {
+        throwIOExceptionErrorNo(env, "Could not sync file range: ", errno);
+    }
+}
+
 JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_fill
   (JNIEnv * env, jclass clazz, jint fd, jint alignment, jlong size)
 {
@@ -1075,3 +3890,152 @@ JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioCon
 
     memset(buffer, 0, (size_t)size);
 }
+
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_writeInternal
+  (JNIEnv * env, jclass clazz, jint fd, jlong position, jlong size, jobject jbuffer)
+{
+    char * buffer = (char *) getBuffer(env, jbuffer);
+
+    if (buffer == 0)
+    {
+        throwRuntimeException(env, "Invalid Buffer used, libaio requires NativeBuffer instead of Java ByteBuffer");
+        return;
+    }
+
+    while (size > 0)
+    {
+        ssize_t written = pwrite(fd, buffer, (size_t)size, (off_t)position);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            throwIOExceptionErrorNo(env, "Error while writing: ", written < 0 ? errno : EIO);
+            return;
+        }
+        buffer += written;
+        position += written;
+        size -= written;
+    }
+}
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// gathers up to this size will keep their iovecs on the stack
+#define IOV_STACK_SIZE 64
+
+/**
+ * A synchronous gather write: the buffers are written one after the other, sizes[i] bytes from offsets[i] of buffers[i].
+ */
+JNIEXPORT void JNICALL Java_org_apache_activemq_artemis_nativo_jlibaio_LibaioContext_writevInternal
+  (JNIEnv * env, jclass clazz, jint fd, jlong position, jobjectArray buffers, jintArray offsets, jintArray sizes)
+{
+    int i;
+    jsize count = (*env)->GetArrayLength(env, buffers);
+
+    if (count <= 0)
+    {
+        return;
+    }
+
+    if (count > IOV_MAX)
+    {
+        throwIOExceptionErrorNo(env, "Too many buffers for pwritev: ", EINVAL);
+        return;
+    }
+
+    struct iovec stackIovecs[IOV_STACK_SIZE];
+    struct iovec * iovecs = stackIovecs;
+    if (count > IOV_STACK_SIZE)
+    {
+        iovecs = (struct iovec *) malloc(sizeof(struct iovec) * (size_t)count);
+        if (iovecs == NULL)
+        {
+            throwOutOfMemoryError(env);
+            return;
+        }
+    }
+
+    jint * offsetElements = (*env)->GetIntArrayElements(env, offsets, NULL);
+    jint * sizeElements = (*env)->GetIntArrayElements(env, sizes, NULL);
+    if (offsetElements == NULL || sizeElements == NULL)
+    {
+        if (offsetElements != NULL) (*env)->ReleaseIntArrayElements(env, offsets, offsetElements, JNI_ABORT);
+        if (sizeElements != NULL) (*env)->ReleaseIntArrayElements(env, sizes, sizeElements, JNI_ABORT);
+        if (iovecs != stackIovecs) free(iovecs);
+        throwOutOfMemoryError(env);
+        return;
+    }
+
+    int valid = 1;
+    for (i = 0; i < count; i++)
+    {
+        jobject jbuffer = (*env)->GetObjectArrayElement(env, buffers, i);
+        char * buffer = jbuffer == NULL ? NULL : (char *) getBuffer(env, jbuffer);
+        if (jbuffer != NULL)
+        {
+            (*env)->DeleteLocalRef(env, jbuffer);
+        }
+        if (buffer == NULL)
+        {
+            valid = 0;
+            break;
+        }
+        iovecs[i].iov_base = buffer + offsetElements[i];
+        iovecs[i].iov_len = (size_t)sizeElements[i];
+    }
+
+    (*env)->ReleaseIntArrayElements(env, offsets, offsetElements, JNI_ABORT);
+    (*env)->ReleaseIntArrayElements(env, sizes, sizeElements, JNI_ABORT);
+
+    if (!valid)
+    {
+        if (iovecs != stackIovecs) free(iovecs);
+        throwRuntimeException(env, "Invalid Buffer used, libaio requires NativeBuffer instead of Java ByteBuffer");
+        return;
+    }
+
+    struct iovec * current = iovecs;
+    int remaining = count;
+
+    // empty buffers are skipped, so a pwritev returning 0 means it can't make progress
+    while (remaining > 0 && current->iov_len == 0)
+    {
+        current++;
+        remaining--;
+    }
+
+    while (remaining > 0)
+    {
+        ssize_t written = pwritev(fd, current, remaining, (off_t)position);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            if (iovecs != stackIovecs) free(iovecs);
+            throwIOExceptionErrorNo(env, "Error while writing: ", written < 0 ? errno : EIO);
+            return;
+        }
+        position += written;
+
+        // a short write continues from where it stopped
+        while (remaining > 0 && (size_t)written >= current->iov_len)
+        {
+            written -= (ssize_t)current->iov_len;
+            current++;
+            remaining--;
+        }
+        if (remaining > 0)
+        {
+            current->iov_base = (char *)current->iov_base + written;
+            current->iov_len -= (size_t)written;
+        }
+    }
+
+    if (iovecs != stackIovecs) free(iovecs);
+}
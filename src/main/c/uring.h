@@ -0,0 +1,735 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <libaio.h>
+
+#include "iocb_pool.h"
+
+/*
+ * A minimal io_uring engine.
+ *
+ * This is talking to the kernel directly, without liburing, and the ABI structures are defined here
+ * the same way aio_ring is: the build machines don't have linux/io_uring.h (it is not on centos 7 for instance),
+ * and we want the same binary to work everywhere, falling back to libaio when io_uring is not there.
+ *
+ * The requests are still described by struct iocb (they come from the same slab / pool),
+ * and the completions are translated into struct io_event with obj pointing to the iocb,
+ * so the poll loops are the same for both engines.
+ *
+ * Submissions are serialized on a mutex, as the SQ ring has a single producer.
+ * Completions are only consumed by the poller, which is already serialized by the pollLock.
+ *
+ * The header has no JNI dependencies on purpose, so it can be used by the benchmarks under ./bench
+ */
+
+// These are the same on every architecture using the generic syscall table (x86_64, i386, arm, aarch64...)
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+#define URING_OFF_SQ_RING 0ULL
+#define URING_OFF_CQ_RING 0x8000000ULL
+#define URING_OFF_SQES 0x10000000ULL
+
+#define URING_FEAT_SINGLE_MMAP (1U << 0)
+#define URING_FEAT_NODROP (1U << 1)
+#define URING_FEAT_EXT_ARG (1U << 8)
+
+#define URING_SETUP_CLAMP (1U << 4)
+
+#define URING_ENTER_GETEVENTS (1U << 0)
+#define URING_ENTER_EXT_ARG (1U << 3)
+
+#define URING_REGISTER_BUFFERS 0
+#define URING_UNREGISTER_BUFFERS 1
+#define URING_REGISTER_FILES 2
+#define URING_REGISTER_EVENTFD 4
+#define URING_REGISTER_FILES_UPDATE 6
+#define URING_REGISTER_PROBE 8
+#define URING_OP_SUPPORTED (1U << 0)
+
+#define URING_OP_READV 1
+#define URING_OP_WRITEV 2
+#define URING_OP_FSYNC 3
+#define URING_OP_READ_FIXED 4
+#define URING_OP_WRITE_FIXED 5
+#define URING_OP_READ 22
+#define URING_OP_WRITE 23
+
+#define URING_FSYNC_DATASYNC (1U << 0)
+
+#define URING_SQE_FIXED_FILE (1U << 0)
+
+// the fixed file table is sparse and indexed by fd, files with a bigger fd are used without registering them
+#define URING_FIXED_FILES 4096
+
+/* Linux ABI, as in include/uapi/linux/io_uring.h */
+struct uring_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t ioprio;
+    int32_t fd;
+    uint64_t off;
+    uint64_t addr;
+    uint32_t len;
+    uint32_t op_flags; /* rw_flags, fsync_flags... */
+    uint64_t user_data;
+    uint16_t buf_index;
+    uint16_t personality;
+    int32_t splice_fd_in;
+    uint64_t pad[2];
+}; /* 64 bytes */
+
+struct uring_cqe {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+};
+
+struct uring_sqring_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;
+    uint32_t resv1;
+    uint64_t resv2;
+};
+
+struct uring_cqring_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t overflow;
+    uint32_t cqes;
+    uint32_t flags;
+    uint32_t resv1;
+    uint64_t resv2;
+};
+
+struct uring_params {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;
+    uint32_t features;
+    uint32_t wq_fd;
+    uint32_t resv[3];
+    struct uring_sqring_offsets sq_off;
+    struct uring_cqring_offsets cq_off;
+};
+
+struct uring_timespec {
+    int64_t tv_sec;
+    long long tv_nsec;
+};
+
+struct uring_getevents_arg {
+    uint64_t sigmask;
+    uint32_t sigmask_sz;
+    uint32_t pad;
+    uint64_t ts;
+};
+
+struct uring_files_update {
+    uint32_t offset;
+    uint32_t resv;
+    uint64_t fds;
+};
+
+struct uring_probe_op {
+    uint8_t op;
+    uint8_t resv;
+    uint16_t flags;
+    uint32_t resv2;
+};
+
+struct uring_probe {
+    uint8_t last_op;
+    uint8_t ops_len;
+    uint16_t resv;
+    uint32_t resv2[3];
+    struct uring_probe_op ops[256];
+};
+
+struct uring {
+    int fd;
+
+    unsigned * sqHead;
+    unsigned * sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned * sqArray;
+    struct uring_sqe * sqes;
+
+    unsigned * cqHead;
+    unsigned * cqTail;
+    unsigned cqMask;
+    struct uring_cqe * cqes;
+
+    void * sqRing;
+    size_t sqRingSize;
+    void * cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+
+    uint32_t features;
+
+    // fixedFiles[fd] is set when fd is on the fixed file table, NULL until the first file is registered
+    unsigned char * fixedFiles;
+    // the registered buffers sorted by address, their index on the kernel is their index here
+    struct iovec * fixedBuffers;
+    int fixedBufferCount;
+
+    // the fixed tables are only changed holding the submitLock, as uring_prep reads them
+    pthread_mutex_t submitLock;
+};
+
+static inline int uring_setup(unsigned entries, struct uring_params * params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static inline int uring_register(int fd, unsigned opcode, void * arg, unsigned nrArgs) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+/**
+ * Releases the rings and closes the io_uring
+ */
+static inline void uring_destroy(struct uring * ring) {
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqesSize);
+    }
+    if (ring->cqRing != NULL && ring->cqRing != MAP_FAILED && ring->cqRing != ring->sqRing) {
+        munmap(ring->cqRing, ring->cqRingSize);
+    }
+    if (ring->sqRing != NULL && ring->sqRing != MAP_FAILED) {
+        munmap(ring->sqRing, ring->sqRingSize);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    ring->sqes = NULL;
+    ring->cqRing = NULL;
+    ring->sqRing = NULL;
+    ring->fd = -1;
+    // the kernel drops the registered files and buffers with the ring
+    free(ring->fixedFiles);
+    free(ring->fixedBuffers);
+    ring->fixedFiles = NULL;
+    ring->fixedBuffers = NULL;
+    ring->fixedBufferCount = 0;
+    pthread_mutex_destroy(&ring->submitLock);
+}
+
+/**
+ * Creates an io_uring for at least entries requests in flight (clamped by the kernel maximum).
+ * @return 0 if OK, or -errno
+ */
+static inline int uring_init(struct uring * ring, unsigned entries) {
+    struct uring_params params;
+    int res;
+
+    memset(ring, 0, sizeof(struct uring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = -1;
+
+    res = pthread_mutex_init(&ring->submitLock, 0);
+    if (res) {
+        return -res;
+    }
+
+    params.flags = URING_SETUP_CLAMP;
+    ring->fd = uring_setup(entries, &params);
+    if (ring->fd < 0) {
+        res = -errno;
+        uring_destroy(ring);
+        return res;
+    }
+
+    ring->features = params.features;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct uring_cqe);
+
+    if (params.features & URING_FEAT_SINGLE_MMAP) {
+        if (ring->cqRingSize > ring->sqRingSize) {
+            ring->sqRingSize = ring->cqRingSize;
+        }
+        ring->cqRingSize = ring->sqRingSize;
+    }
+
+    ring->sqRing = mmap(0, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, URING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        res = -errno;
+        uring_destroy(ring);
+        return res;
+    }
+
+    if (params.features & URING_FEAT_SINGLE_MMAP) {
+        ring->cqRing = ring->sqRing;
+    } else {
+        ring->cqRing = mmap(0, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, URING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            res = -errno;
+            uring_destroy(ring);
+            return res;
+        }
+    }
+
+    ring->sqesSize = params.sq_entries * sizeof(struct uring_sqe);
+    ring->sqes = (struct uring_sqe *) mmap(0, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, URING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        res = -errno;
+        uring_destroy(ring);
+        return res;
+    }
+
+    char * sq = (char *) ring->sqRing;
+    ring->sqHead = (unsigned *) (sq + params.sq_off.head);
+    ring->sqTail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sqEntries = *(unsigned *) (sq + params.sq_off.ring_entries);
+    ring->sqArray = (unsigned *) (sq + params.sq_off.array);
+
+    char * cq = (char *) ring->cqRing;
+    ring->cqHead = (unsigned *) (cq + params.cq_off.head);
+    ring->cqTail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct uring_cqe *) (cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+/**
+ * The kernel signals eventFd on every completion posted to the CQ.
+ * @return 0, or -errno
+ */
+static inline int uring_register_eventfd(struct uring * ring, int eventFd) {
+    if (uring_register(ring->fd, URING_REGISTER_EVENTFD, &eventFd, 1) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+static inline int uring_compare_iovec(const void * a, const void * b) {
+    uintptr_t baseA = (uintptr_t) ((const struct iovec *) a)->iov_base;
+    uintptr_t baseB = (uintptr_t) ((const struct iovec *) b)->iov_base;
+    return baseA < baseB ? -1 : (baseA > baseB ? 1 : 0);
+}
+
+/**
+ * Registers buffers on the ring, so reads and writes on them use READ_FIXED / WRITE_FIXED
+ * and the kernel doesn't pin their pages on every request.
+ * It replaces the buffers registered before, if there were any.
+ * buffers is sorted in place.
+ * @return 0 if OK, or -errno (ENOMEM when RLIMIT_MEMLOCK is too low for the buffers)
+ */
+static inline int uring_register_buffers(struct uring * ring, struct iovec * buffers, int count) {
+    struct iovec * previous;
+    struct iovec * copy = (struct iovec *) malloc(sizeof(struct iovec) * (size_t) count);
+    if (copy == NULL) {
+        return -ENOMEM;
+    }
+    qsort(buffers, (size_t) count, sizeof(struct iovec), uring_compare_iovec);
+    memcpy(copy, buffers, sizeof(struct iovec) * (size_t) count);
+
+    pthread_mutex_lock(&ring->submitLock);
+    previous = ring->fixedBuffers;
+    if (previous != NULL) {
+        // nothing is prepared with the previous buffers from now on, the requests in flight keep their own reference
+        ring->fixedBuffers = NULL;
+        ring->fixedBufferCount = 0;
+        uring_register(ring->fd, URING_UNREGISTER_BUFFERS, NULL, 0);
+    }
+    if (uring_register(ring->fd, URING_REGISTER_BUFFERS, copy, (unsigned) count) < 0) {
+        int error = errno;
+        pthread_mutex_unlock(&ring->submitLock);
+        free(previous);
+        free(copy);
+        return -error;
+    }
+    ring->fixedBuffers = copy;
+    ring->fixedBufferCount = count;
+    pthread_mutex_unlock(&ring->submitLock);
+
+    free(previous);
+    return 0;
+}
+
+static inline void uring_unregister_buffers(struct uring * ring) {
+    struct iovec * previous;
+    pthread_mutex_lock(&ring->submitLock);
+    previous = ring->fixedBuffers;
+    if (previous != NULL) {
+        ring->fixedBuffers = NULL;
+        ring->fixedBufferCount = 0;
+        uring_register(ring->fd, URING_UNREGISTER_BUFFERS, NULL, 0);
+    }
+    pthread_mutex_unlock(&ring->submitLock);
+    free(previous);
+}
+
+/**
+ * @return the index of the registered buffer holding all of [address, address + length), or -1
+ */
+static inline int uring_fixed_buffer(struct uring * ring, void * address, size_t length) {
+    int low = 0;
+    int high = ring->fixedBufferCount - 1;
+    uintptr_t start = (uintptr_t) address;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        uintptr_t base = (uintptr_t) ring->fixedBuffers[middle].iov_base;
+        if (start < base) {
+            high = middle - 1;
+        } else if (start - base >= ring->fixedBuffers[middle].iov_len) {
+            low = middle + 1;
+        } else {
+            return length <= ring->fixedBuffers[middle].iov_len - (start - base) ? middle : -1;
+        }
+    }
+    return -1;
+}
+
+static inline int uring_update_file(struct uring * ring, int index, int fd) {
+    struct uring_files_update update;
+    update.offset = (uint32_t) index;
+    update.resv = 0;
+    update.fds = (uint64_t) (uintptr_t) &fd;
+    return uring_register(ring->fd, URING_REGISTER_FILES_UPDATE, &update, 1) < 0 ? -errno : 0;
+}
+
+/**
+ * Puts fd on the fixed file table, so the kernel doesn't look it up on every request.
+ * The sparse table is created on the first call (5.5+).
+ * @return 1 if it was registered, 0 if fd doesn't fit on the table, or -errno
+ */
+static inline int uring_register_file(struct uring * ring, int fd) {
+    int res = 0;
+    if (fd < 0 || fd >= URING_FIXED_FILES) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ring->submitLock);
+    if (ring->fixedFiles == NULL) {
+        int * table = (int *) malloc(sizeof(int) * URING_FIXED_FILES);
+        unsigned char * fixedFiles = (unsigned char *) calloc(URING_FIXED_FILES, 1);
+        int i;
+        if (table == NULL || fixedFiles == NULL) {
+            res = -ENOMEM;
+        } else {
+            for (i = 0; i < URING_FIXED_FILES; i++) {
+                table[i] = -1;
+            }
+            if (uring_register(ring->fd, URING_REGISTER_FILES, table, URING_FIXED_FILES) < 0) {
+                res = -errno;
+            } else {
+                ring->fixedFiles = fixedFiles;
+                fixedFiles = NULL;
+            }
+        }
+        free(table);
+        free(fixedFiles);
+    }
+    if (res == 0) {
+        res = uring_update_file(ring, fd, fd);
+        if (res == 0) {
+            ring->fixedFiles[fd] = 1;
+            res = 1;
+        }
+    }
+    pthread_mutex_unlock(&ring->submitLock);
+    return res;
+}
+
+/**
+ * Takes fd out of the fixed file table, it needs to be called before fd is closed as the number could be reused.
+ */
+static inline void uring_unregister_file(struct uring * ring, int fd) {
+    pthread_mutex_lock(&ring->submitLock);
+    if (ring->fixedFiles != NULL && fd >= 0 && fd < URING_FIXED_FILES && ring->fixedFiles[fd]) {
+        ring->fixedFiles[fd] = 0;
+        uring_update_file(ring, fd, -1);
+    }
+    pthread_mutex_unlock(&ring->submitLock);
+}
+
+/**
+ * Checks if the kernel has everything this engine needs: the read / write / fsync operations (5.6+).
+ * The result is cached.
+ * @return 1 if io_uring can be used
+ */
+static inline int uring_supported(void) {
+    static int supported = -1;
+    int cached = __atomic_load_n(&supported, __ATOMIC_RELAXED);
+    if (cached >= 0) {
+        return cached;
+    }
+
+    int result = 0;
+    struct uring ring;
+    if (uring_init(&ring, 8) == 0) {
+        struct uring_probe * probe = (struct uring_probe *) calloc(1, sizeof(struct uring_probe));
+        if (probe != NULL) {
+            if (uring_register(ring.fd, URING_REGISTER_PROBE, probe, 256) == 0) {
+                result = probe->last_op >= URING_OP_WRITE &&
+                         (probe->ops[URING_OP_READ].flags & URING_OP_SUPPORTED) &&
+                         (probe->ops[URING_OP_WRITE].flags & URING_OP_SUPPORTED) &&
+                         (probe->ops[URING_OP_FSYNC].flags & URING_OP_SUPPORTED);
+            }
+            free(probe);
+        }
+        uring_destroy(&ring);
+    }
+
+    __atomic_store_n(&supported, result, __ATOMIC_RELAXED);
+    return result;
+}
+
+/**
+ * translates an iocb (as prepared by io_prep_pwrite, io_prep_pread or io_prep_fsync) into the sqe
+ */
+static inline void uring_prep(struct uring * ring, struct uring_sqe * sqe, struct iocb * iocb) {
+    memset(sqe, 0, sizeof(struct uring_sqe));
+    sqe->fd = iocb->aio_fildes;
+    sqe->user_data = (uint64_t) (uintptr_t) iocb;
+
+    if (ring->fixedFiles != NULL && sqe->fd >= 0 && sqe->fd < URING_FIXED_FILES && ring->fixedFiles[sqe->fd]) {
+        // the table is indexed by fd
+        sqe->flags |= URING_SQE_FIXED_FILE;
+    }
+
+    switch (iocb->aio_lio_opcode) {
+        case IO_CMD_PREAD:
+            sqe->opcode = URING_OP_READ;
+            break;
+        // buf and nbytes are the iovecs and their count on the vectored commands, as on the sqe
+        case IO_CMD_PREADV:
+            sqe->opcode = URING_OP_READV;
+            break;
+        case IO_CMD_PWRITEV:
+            sqe->opcode = URING_OP_WRITEV;
+            break;
+        case IO_CMD_FSYNC:
+        case IO_CMD_FDSYNC:
+            sqe->opcode = URING_OP_FSYNC;
+            sqe->op_flags = iocb->aio_lio_opcode == IO_CMD_FDSYNC ? URING_FSYNC_DATASYNC : 0;
+            return;
+        default:
+            sqe->opcode = URING_OP_WRITE;
+            break;
+    }
+
+    sqe->op_flags = iocb_rw_flags(iocb);
+    sqe->addr = (uint64_t) (uintptr_t) iocb->u.c.buf;
+    sqe->len = (uint32_t) iocb->u.c.nbytes;
+    sqe->off = (uint64_t) iocb->u.c.offset;
+
+    if (ring->fixedBufferCount > 0 && (sqe->opcode == URING_OP_READ || sqe->opcode == URING_OP_WRITE)) {
+        int index = uring_fixed_buffer(ring, iocb->u.c.buf, iocb->u.c.nbytes);
+        if (index >= 0) {
+            sqe->opcode = sqe->opcode == URING_OP_READ ? URING_OP_READ_FIXED : URING_OP_WRITE_FIXED;
+            sqe->buf_index = (uint16_t) index;
+        }
+    }
+}
+
+// how many times a submit yields on EAGAIN / EBUSY before giving up with EAGAIN, like io_submit does.
+// A CQ that is backed up can only be drained by the poller, that could be the thread submitting
+#define URING_SUBMIT_RETRIES 16
+
+/**
+ * Submits nr iocbs, with the same semantics as io_submit:
+ * it returns how many were submitted, or -errno if none could be.
+ */
+static inline int uring_submit(struct uring * ring, struct iocb ** iocbs, int nr) {
+    int submitted = 0;
+    int error = 0;
+    int retries = 0;
+
+    pthread_mutex_lock(&ring->submitLock);
+
+    while (submitted < nr && !error) {
+        unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+        unsigned tail = *ring->sqTail;
+        unsigned start = tail;
+
+        // as many as the SQ can take right now, the kernel consumes all of them at io_uring_enter
+        while (submitted + (int)(tail - start) < nr && tail - head < ring->sqEntries) {
+            unsigned index = tail & ring->sqMask;
+            uring_prep(ring, &ring->sqes[index], iocbs[submitted + (int)(tail - start)]);
+            ring->sqArray[index] = index;
+            tail++;
+        }
+
+        unsigned toSubmit = tail - start;
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+
+        while (toSubmit > 0) {
+            int res = uring_enter(ring->fd, toSubmit, 0, 0);
+            if (res < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if ((errno == EAGAIN || errno == EBUSY) && retries++ < URING_SUBMIT_RETRIES) {
+                    sched_yield();
+                    continue;
+                }
+                // Nothing else was consumed: we take the entries back so the caller can return the iocbs
+                error = errno == EBUSY ? EAGAIN : errno;
+                __atomic_store_n(ring->sqTail, *ring->sqTail - toSubmit, __ATOMIC_RELEASE);
+                break;
+            }
+            submitted += res;
+            toSubmit -= (unsigned) res;
+        }
+    }
+
+    pthread_mutex_unlock(&ring->submitLock);
+
+    if (submitted == 0 && error) {
+        return -error;
+    }
+    return submitted;
+}
+
+/**
+ * The number of completions ready to be reaped
+ */
+static inline int uring_ready(struct uring * ring) {
+    return (int) (__atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE) - *ring->cqHead);
+}
+
+static inline int uring_reap(struct uring * ring, long max, struct io_event * events) {
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    int reaped = 0;
+
+    while (head != tail && reaped < max) {
+        struct uring_cqe * cqe = &ring->cqes[head & ring->cqMask];
+        struct iocb * iocb = (struct iocb *) (uintptr_t) cqe->user_data;
+        events[reaped].data = iocb->data;
+        events[reaped].obj = iocb;
+        events[reaped].res = cqe->res;
+        events[reaped].res2 = 0;
+        reaped++;
+        head++;
+    }
+
+    // the kernel can reuse the cqes now
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+static inline long uring_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/**
+ * Waits up to timeoutNanos for minComplete completions.
+ * Without IORING_ENTER_EXT_ARG (5.11+) it waits on the ring fd instead, what is only good for the first completion:
+ * the caller needs to loop until it has enough of them.
+ * @return 0 if OK or timed out, or -errno
+ */
+static inline int uring_wait(struct uring * ring, unsigned minComplete, long timeoutNanos) {
+    int res;
+    if (ring->features & URING_FEAT_EXT_ARG) {
+        struct uring_timespec ts;
+        struct uring_getevents_arg arg;
+        ts.tv_sec = timeoutNanos / 1000000000L;
+        ts.tv_nsec = timeoutNanos % 1000000000L;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+        res = (int) syscall(__NR_io_uring_enter, ring->fd, 0, minComplete, URING_ENTER_GETEVENTS | URING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    } else {
+        struct pollfd pfd;
+        struct timespec ts;
+        pfd.fd = ring->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        ts.tv_sec = timeoutNanos / 1000000000L;
+        ts.tv_nsec = timeoutNanos % 1000000000L;
+        res = ppoll(&pfd, 1, &ts, NULL);
+    }
+    if (res < 0) {
+        return errno == ETIME ? 0 : -errno;
+    }
+    return 0;
+}
+
+/**
+ * Same semantics as io_getevents: it blocks until min_nr events are ready, or timeoutNanos elapsed when it's not negative,
+ * and it returns up to max of them as io_event.
+ */
+static inline int uring_get_events(struct uring * ring, long min_nr, long max, struct io_event * events, long timeoutNanos) {
+    int reaped = uring_reap(ring, max, events);
+    long deadline = timeoutNanos > 0 ? uring_now() + timeoutNanos : 0;
+
+    while (reaped < min_nr && timeoutNanos != 0) {
+        int res;
+        if (timeoutNanos < 0) {
+            res = uring_enter(ring->fd, 0, (unsigned) (min_nr - reaped), URING_ENTER_GETEVENTS) < 0 ? -errno : 0;
+        } else {
+            long remaining = deadline - uring_now();
+            if (remaining <= 0) {
+                break;
+            }
+            res = uring_wait(ring, (unsigned) (min_nr - reaped), remaining);
+        }
+        if (res < 0 && res != -EAGAIN && res != -EBUSY) {
+            if (reaped > 0) {
+                return reaped;
+            }
+            return res;
+        }
+        reaped += uring_reap(ring, max - reaped, events + reaped);
+    }
+
+    return reaped;
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio;
+
+import java.nio.ByteBuffer;
+import java.util.concurrent.atomic.AtomicBoolean;
+
+/**
+ * A native pool of aligned buffers, for O_DIRECT.
+ * <br>
+ * Buffers are kept on power of 2 size classes, so a released buffer is reused by the next acquire of a similar size
+ * without going through posix_memalign and free.
+ * The memory is only given back to the system on {@link #close()}.
+ * <br>
+ * It is safe to acquire and release buffers from multiple threads.
+ * <br>
+ * Use {@link LibaioContext#newAlignedBufferPool(int, boolean, boolean)} to create one.
+ */
+public final class AlignedBufferPool implements AutoCloseable {
+
+   private final ByteBuffer pool;
+
+   private final int alignment;
+
+   private final AtomicBoolean closed = new AtomicBoolean(false);
+
+   AlignedBufferPool(ByteBuffer pool, int alignment) {
+      this.pool = pool;
+      this.alignment = alignment;
+   }
+
+   public int getAlignment() {
+      return alignment;
+   }
+
+   /**
+    * @param size needs to be % alignment
+    * @return an aligned buffer with exactly size bytes of capacity
+    */
+   public ByteBuffer acquire(int size) {
+      checkOpen();
+      return LibaioContext.acquireBuffer(pool, size);
+   }
+
+   /**
+    * Gives the buffer back to the pool. The buffer can't be used after this.
+    *
+    * @param buffer a buffer returned by {@link #acquire(int)} on this pool
+    * @throws RuntimeException if the buffer is not outstanding on this pool: acquired somewhere else, a slice of it, or already released
+    */
+   public void release(ByteBuffer buffer) {
+      checkOpen();
+      LibaioContext.releaseBuffer(pool, buffer);
+   }
+
+   /**
+    * @return the bytes held by buffers that were acquired and not released yet
+    */
+   public long getOutstandingBytes() {
+      return stats()[0];
+   }
+
+   /**
+    * @return the bytes of the buffers waiting on the pool to be acquired
+    */
+   public long getPooledBytes() {
+      return stats()[1];
+   }
+
+   /**
+    * @return the bytes the pool reserved from the system
+    */
+   public long getReservedBytes() {
+      return stats()[2];
+   }
+
+   private long[] stats() {
+      checkOpen();
+      long[] stats = new long[3];
+      LibaioContext.getBufferPoolStats(pool, stats);
+      return stats;
+   }
+
+   private void checkOpen() {
+      if (closed.get()) {
+         throw new IllegalStateException("Buffer pool is closed");
+      }
+   }
+
+   /**
+    * Releases all the memory of the pool, including the buffers that were not released:
+    * none of them can be used after this.
+    */
+   @Override
+   public void close() {
+      if (closed.compareAndSet(false, true)) {
+         LibaioContext.deleteBufferPool(pool);
+      }
+   }
+}
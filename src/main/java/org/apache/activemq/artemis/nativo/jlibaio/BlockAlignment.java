@@ -0,0 +1,105 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio;
+
+/**
+ * The alignments of a file or a block device, as reported by the device and the file system.
+ * Anything the kernel doesn't report is 0, see {@link LibaioFile#getAlignment()}.
+ * <br>
+ * st_blksize ({@link LibaioContext#getBlockSize(String)}) is only the preferred I/O size of the file system: it can
+ * over-align on 512e disks, or under-align on devices with a bigger optimal I/O size.
+ */
+public final class BlockAlignment {
+
+   private final int[] values;
+
+   BlockAlignment(int[] values) {
+      this.values = values;
+   }
+
+   /**
+    * @return the logical sector size of the device (BLKSSZGET), the smallest unit it can address
+    */
+   public int getLogicalBlockSize() {
+      return values[LibaioContext.ALIGNMENT_LOGICAL];
+   }
+
+   /**
+    * @return the physical sector size of the device (BLKPBSZGET), smaller writes are a read-modify-write on the device
+    */
+   public int getPhysicalBlockSize() {
+      return values[LibaioContext.ALIGNMENT_PHYSICAL];
+   }
+
+   /**
+    * @return the optimal I/O size of the device (BLKIOOPT), 0 when the device doesn't report one
+    */
+   public int getOptimalIOSize() {
+      return values[LibaioContext.ALIGNMENT_OPTIMAL_IO];
+   }
+
+   /**
+    * @return the alignment O_DIRECT needs for the buffers (statx STATX_DIOALIGN on a file)
+    */
+   public int getDirectMemoryAlignment() {
+      return values[LibaioContext.ALIGNMENT_DIO_MEMORY];
+   }
+
+   /**
+    * @return the alignment O_DIRECT needs for the positions and the sizes (statx STATX_DIOALIGN on a file)
+    */
+   public int getDirectOffsetAlignment() {
+      return values[LibaioContext.ALIGNMENT_DIO_OFFSET];
+   }
+
+   /**
+    * @return st_blksize, the preferred I/O size of the file system
+    */
+   public int getFileSystemBlockSize() {
+      return values[LibaioContext.ALIGNMENT_FILE_SYSTEM];
+   }
+
+   /**
+    * @return the smallest alignment O_DIRECT accepts: the one of statx, the logical sector size if the kernel is older,
+    *         and st_blksize if the device can't be known either
+    */
+   public int getMinimumAlignment() {
+      if (getDirectOffsetAlignment() > 0) {
+         return getDirectOffsetAlignment();
+      }
+      if (getLogicalBlockSize() > 0) {
+         return getLogicalBlockSize();
+      }
+      return getFileSystemBlockSize();
+   }
+
+   /**
+    * @return the alignment to write with: the physical sector size, so no write is a read-modify-write on the device,
+    *         and never less than {@link #getMinimumAlignment()}
+    */
+   public int getPreferredAlignment() {
+      return Math.max(getMinimumAlignment(), getPhysicalBlockSize());
+   }
+
+   @Override
+   public String toString() {
+      return "BlockAlignment{logical=" + getLogicalBlockSize() + ", physical=" + getPhysicalBlockSize() +
+         ", optimalIO=" + getOptimalIOSize() + ", directMemory=" + getDirectMemoryAlignment() +
+         ", directOffset=" + getDirectOffsetAlignment() + ", fileSystem=" + getFileSystemBlockSize() + "}";
+   }
+}
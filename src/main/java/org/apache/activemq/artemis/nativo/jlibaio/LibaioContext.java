@@ -20,12 +20,14 @@ import java.io.Closeable;
 import java.io.File;
 import java.io.IOException;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.concurrent.Semaphore;
 import java.util.concurrent.TimeUnit;
 import java.util.concurrent.atomic.AtomicBoolean;
 import java.util.concurrent.atomic.AtomicInteger;
 import java.util.concurrent.atomic.AtomicLong;
 
+import org.apache.activemq.artemis.nativo.jlibaio.util.CallbackSlots;
 import org.slf4j.Logger;
 import org.slf4j.LoggerFactory;
 
@@ -57,7 +59,153 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
    /**
     * The Native layer will look at this version.
     */
-   private static final int EXPECTED_NATIVE_VERSION = 200;
+   private static final int EXPECTED_NATIVE_VERSION = 201;
+
+   /**
+    * Context flag: the callbacks are held by the context and only their slot ids are passed to the native layer,
+    * so no JNI global references are created or deleted for each submit.
+    */
+   public static final int CONTEXT_CALLBACK_SLOTS = 1;
+
+   /**
+    * Flag passed to {@link #newContext(int, int, int)}: use io_uring if the kernel supports it, libaio otherwise.
+    * It follows {@link #setDefaultEngine(int)}, it is not a flag of the constructor.
+    */
+   private static final int CONTEXT_IO_URING = 2;
+
+   /**
+    * Context flag: every completion signals the eventfd returned by {@link #getEventFd()}, so an event loop can wait on
+    * it together with other descriptors and reap with {@link #pollReady(SubmitInfo[])}.
+    */
+   public static final int CONTEXT_EVENTFD = 4;
+
+   /**
+    * Context flag: the reads and writes are completed in the order they were submitted. A completion is held on a
+    * native reorder window until all the submits before it completed. A failed submit doesn't hold the others,
+    * and fills are completed as soon as they are done.
+    */
+   public static final int CONTEXT_ORDERED = 8;
+
+   /**
+    * Context flag: the events array and the iocb slab are mapped on huge pages (transparent ones when none are
+    * reserved), prefaulted and locked when the context is created, so polling never takes a page fault.
+    * Locking is limited by RLIMIT_MEMLOCK, see {@link #getLockedBytes()}.
+    */
+   public static final int CONTEXT_HUGE_PAGES = 16;
+
+   /**
+    * Context flag: the context keeps {@link #FILL_IOCBS} on top of its queueSize for fills and chains, so they never take
+    * space from the other submits. Without it their writes take from the queueSize.
+    */
+   public static final int CONTEXT_FILL_RESERVE = 32;
+
+   /**
+    * The flags a context can be created with.
+    */
+   private static final int CONTEXT_FLAGS = CONTEXT_CALLBACK_SLOTS | CONTEXT_EVENTFD | CONTEXT_ORDERED | CONTEXT_HUGE_PAGES | CONTEXT_FILL_RESERVE;
+
+   /**
+    * The native engine using libaio (io_submit / io_getevents).
+    */
+   public static final int ENGINE_LIBAIO = 0;
+
+   /**
+    * The native engine using io_uring, available on kernels 5.6 or newer.
+    */
+   public static final int ENGINE_IO_URING = 1;
+
+   /**
+    * Mode for {@link LibaioFile#fallocate(int, long, long, boolean)}: the size of the file doesn't change,
+    * even if the range is beyond the end of the file.
+    */
+   public static final int FALLOCATE_KEEP_SIZE = 1;
+
+   /**
+    * Mode for {@link LibaioFile#fallocate(int, long, long, boolean)}: the range is zeroed, keeping its blocks allocated.
+    */
+   public static final int FALLOCATE_ZERO_RANGE = 2;
+
+   /**
+    * Mode for {@link LibaioFile#fallocate(int, long, long, boolean)}: the blocks of the range are released,
+    * reading them gives zeros. It always keeps the size of the file.
+    */
+   public static final int FALLOCATE_PUNCH_HOLE = 4;
+
+   /**
+    * How many buffers a vectored submit can take, they are kept on the native iocb (IOCB_SLOT_IOVECS).
+    */
+   public static final int MAX_VECTORED_BUFFERS = 3;
+
+   /**
+    * How many iocbs a context created with {@link #CONTEXT_FILL_RESERVE} keeps on top of its queueSize for the zero
+    * writes of fills and the stages of chains. The submits of the Java side never take them, but they count on
+    * aio-max-nr like the queueSize does.
+    */
+   public static final int FILL_IOCBS = 64;
+
+   /**
+    * How many writes a chain can take, its iocbs come from the ones kept for fills ({@link #FILL_IOCBS}) or from the
+    * queueSize of a context without them.
+    */
+   public static final int MAX_CHAIN_WRITES = 32;
+
+   /**
+    * Status of {@link #trySubmitWrite(int, long, int, ByteBuffer, SubmitInfo, boolean)} and
+    * {@link #trySubmitRead(int, long, int, ByteBuffer, SubmitInfo)}: the request was submitted.
+    * A negative status is the -errno of a failed submit.
+    */
+   public static final int SUBMIT_OK = 0;
+
+   /**
+    * Status of a try submit: there was no space left on the queue, nothing was submitted.
+    */
+   public static final int SUBMIT_QUEUE_FULL = 1;
+
+   /**
+    * Status of a try submit: the file was at its in flight limit ({@link LibaioFile#setInFlightLimit(int)}), nothing was submitted.
+    */
+   public static final int SUBMIT_FILE_LIMIT = 2;
+
+   /**
+    * Flag passed to {@link #newBufferPool(int, int, int)}: back the pool with huge pages.
+    */
+   private static final int BUFFER_POOL_HUGE_PAGES = 1;
+
+   /**
+    * Flag passed to {@link #newBufferPool(int, int, int)}: zero the buffers every time they are acquired.
+    */
+   private static final int BUFFER_POOL_ZERO = 2;
+
+   /**
+    * The layout of the alignment of a file, an array of ints filled by {@link #getAlignment(int, int[])}. See {@link BlockAlignment}.
+    */
+   static final int ALIGNMENT_LOGICAL = 0;
+   static final int ALIGNMENT_PHYSICAL = 1;
+   static final int ALIGNMENT_OPTIMAL_IO = 2;
+   static final int ALIGNMENT_DIO_MEMORY = 3;
+   static final int ALIGNMENT_DIO_OFFSET = 4;
+   static final int ALIGNMENT_FILE_SYSTEM = 5;
+   static final int ALIGNMENT_LENGTH = 6;
+
+   /**
+    * The layout of the stats of a context, an array of longs shared with the native layer. See {@link LibaioStats}.
+    */
+   static final int STATS_READS = 0;
+   static final int STATS_WRITES = 1;
+   static final int STATS_READ_NANOS = 2;
+   static final int STATS_WRITE_NANOS = 3;
+   static final int STATS_IN_FLIGHT_READS = 4;
+   static final int STATS_IN_FLIGHT_WRITES = 5;
+   static final int STATS_MAX_IN_FLIGHT = 6;
+   static final int STATS_RING_REAPS = 7;
+   static final int STATS_SYSCALL_REAPS = 8;
+   static final int STATS_SUBMIT_EAGAIN = 9;
+   static final int STATS_BUCKETS = 160;
+   static final int STATS_READ_HISTOGRAM = 16;
+   static final int STATS_WRITE_HISTOGRAM = 176;
+   static final int STATS_LENGTH = 336;
+
+   private static volatile int defaultEngine = ENGINE_LIBAIO;
 
    private static boolean loaded = false;
 
@@ -95,6 +243,10 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
             if (System.getProperty("org.apache.activemq.artemis.native.jlibaio.FORCE_SYSCALL") != null) {
                LibaioContext.setForceSyscall(true);
             }
+            if ("io_uring".equalsIgnoreCase(System.getProperty("org.apache.activemq.artemis.native.jlibaio.ENGINE"))) {
+               LibaioContext.setDefaultEngine(ENGINE_IO_URING);
+            }
+            logger.debug("Using the {} engine", getEngineName(defaultEngine));
             Runtime.getRuntime().addShutdownHook(new Thread() {
                @Override
                public void run() {
@@ -121,6 +273,48 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
 
    private static native void shutdownHook();
 
+   /**
+    * Selects the engine for the new contexts.
+    * If io_uring is requested but the kernel doesn't support it, libaio stays as the engine.
+    *
+    * @param engine {@link #ENGINE_LIBAIO} or {@link #ENGINE_IO_URING}
+    * @return the engine that will be used by the new contexts
+    */
+   public static int setDefaultEngine(int engine) {
+      if (engine != ENGINE_LIBAIO && engine != ENGINE_IO_URING) {
+         throw new IllegalArgumentException("Invalid engine " + engine);
+      }
+      if (engine == ENGINE_IO_URING && !isIoUringSupported()) {
+         logger.debug("io_uring is not supported by this kernel, using libaio");
+         engine = ENGINE_LIBAIO;
+      }
+      defaultEngine = engine;
+      return engine;
+   }
+
+   /**
+    * @return the engine the new contexts will use.
+    */
+   public static int getDefaultEngine() {
+      return defaultEngine;
+   }
+
+   public static String getEngineName(int engine) {
+      switch (engine) {
+         case ENGINE_LIBAIO:
+            return "libaio";
+         case ENGINE_IO_URING:
+            return "io_uring";
+         default:
+            return "unknown";
+      }
+   }
+
+   /**
+    * @return true if the kernel has everything the io_uring engine needs.
+    */
+   public static native boolean isIoUringSupported();
+
    public static native void setForceSyscall(boolean value);
 
    /** The system may choose to set this if a failing condition happened inside the code. */
@@ -129,7 +323,7 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
    /**
     * This is used to validate leaks on tests.
     *
-    * @return the number of allocated aio, to be used on test checks.
+    * @return the number of allocated aio, the queueSize of every open context plus its {@link #fillReserve}, to be used on test checks.
     */
    public static long getTotalMaxIO() {
       return totalMaxIO.get();
@@ -163,8 +357,44 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
 
    final int queueSize;
 
+   /**
+    * The iocbs on top of queueSize kept for fills and chains: {@link #FILL_IOCBS} with {@link #CONTEXT_FILL_RESERVE}, 0 otherwise.
+    */
+   final int fillReserve;
+
    final boolean useFdatasync;
 
+   /**
+    * The NUMA node of the native memory of this context, or -1.
+    */
+   final int numaNode;
+
+   /**
+    * The callbacks of the pending submits when using callback slots, null otherwise.
+    */
+   final CallbackSlots<Callback> callbackSlots;
+
+   /**
+    * Pairs of slot id and result filled by the native poll when using callback slots.
+    */
+   private final int[] slotCompletions;
+
+   /**
+    * Pairs of slot id and result written by the native blocked poll before calling {@link #doneBatch(int)},
+    * when using callback slots.
+    */
+   private final ByteBuffer completionBuffer;
+
+   /**
+    * The live stats of the native context, see {@link #getStats()}.
+    */
+   private final ByteBuffer statsBuffer;
+
+   /**
+    * strerror messages, resolved the first time an errno is seen.
+    */
+   private static final String[] errorMessages = new String[256];
+
    /**
     * The queue size here will use resources defined on the kernel parameter
     * <a href="https://www.kernel.org/doc/Documentation/sysctl/fs.txt">fs.aio-max-nr</a> .
@@ -175,15 +405,48 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
     * @param useFdatasync should use fdatasync before calling callbacks.
     */
    public LibaioContext(int queueSize, boolean useSemaphore, boolean useFdatasync) {
+      this(queueSize, useSemaphore, useFdatasync, 0, -1);
+   }
+
+   /**
+    * The queue size here will use resources defined on the kernel parameter
+    * <a href="https://www.kernel.org/doc/Documentation/sysctl/fs.txt">fs.aio-max-nr</a> .
+    *
+    * @param queueSize    the size to be initialize on libaio
+    *                     io_queue_init which can't be higher than /proc/sys/fs/aio-max-nr.
+    * @param useSemaphore should block on a semaphore avoiding using more submits than what's available.
+    * @param useFdatasync should use fdatasync before calling callbacks.
+    * @param flags        a combination of {@link #CONTEXT_CALLBACK_SLOTS}, {@link #CONTEXT_EVENTFD},
+    *                     {@link #CONTEXT_ORDERED}, {@link #CONTEXT_HUGE_PAGES} and {@link #CONTEXT_FILL_RESERVE}, or 0.
+    * @param numaNode     the NUMA node of the native memory of the context: the iocbs, the events and the kernel rings
+    *                     prefer its pages. Use -1 for no preference. The thread polling the context should run on the
+    *                     same node, see {@link #bindToNumaNode(int)}.
+    */
+   public LibaioContext(int queueSize, boolean useSemaphore, boolean useFdatasync, int flags, int numaNode) {
+      if ((flags & ~CONTEXT_FLAGS) != 0) {
+         throw new IllegalArgumentException("Unknown context flags " + Integer.toHexString(flags & ~CONTEXT_FLAGS));
+      }
       try {
          contexts.incrementAndGet();
-         this.ioContext = newContext(queueSize);
+         this.ioContext = newContext(queueSize, defaultEngine == ENGINE_IO_URING ? flags | CONTEXT_IO_URING : flags, numaNode);
+         this.statsBuffer = getStatsBuffer(ioContext).order(ByteOrder.nativeOrder());
          this.useFdatasync = useFdatasync;
+         this.numaNode = numaNode < 0 ? -1 : numaNode;
       } catch (Exception e) {
          throw e;
       }
+      if ((flags & CONTEXT_CALLBACK_SLOTS) != 0) {
+         this.callbackSlots = new CallbackSlots<>(queueSize);
+         this.slotCompletions = new int[queueSize * 2];
+         this.completionBuffer = ByteBuffer.allocateDirect(queueSize * 2 * Integer.BYTES).order(ByteOrder.nativeOrder());
+      } else {
+         this.callbackSlots = null;
+         this.slotCompletions = null;
+         this.completionBuffer = null;
+      }
       this.queueSize = queueSize;
-      totalMaxIO.addAndGet(queueSize);
+      this.fillReserve = (flags & CONTEXT_FILL_RESERVE) != 0 ? FILL_IOCBS : 0;
+      totalMaxIO.addAndGet(queueSize + fillReserve);
       if (useSemaphore) {
          this.ioSpace = new Semaphore(queueSize);
       } else {
@@ -206,6 +469,26 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
                            int size,
                            ByteBuffer bufferWrite,
                            Callback callback) throws IOException {
+      submitWrite(fd, position, size, bufferWrite, callback, false);
+   }
+
+   /**
+    * Documented at {@link LibaioFile#write(long, int, java.nio.ByteBuffer, SubmitInfo, boolean)}
+    *
+    * @param fd          the file descriptor
+    * @param position    the write position
+    * @param size        number of bytes to use
+    * @param bufferWrite the native buffer
+    * @param callback    a callback
+    * @param durable     the write is only completed once it is on stable storage
+    * @throws IOException in case of error
+    */
+   public void submitWrite(int fd,
+                           long position,
+                           int size,
+                           ByteBuffer bufferWrite,
+                           Callback callback,
+                           boolean durable) throws IOException {
       if (closed.get()) {
          throw new IOException("Libaio Context is closed!");
       }
@@ -217,7 +500,17 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
          Thread.currentThread().interrupt();
          throw new IOException(e.getMessage(), e);
       }
-      submitWrite(fd, this.ioContext, position, size, bufferWrite, callback);
+      if (callbackSlots != null) {
+         int slot = registerSlot(callback);
+         try {
+            submitWriteSlot(fd, this.ioContext, position, size, bufferWrite, slot, durable);
+         } catch (IOException | RuntimeException e) {
+            callbackSlots.release(slot);
+            throw e;
+         }
+      } else {
+         submitWrite(fd, this.ioContext, position, size, bufferWrite, callback, durable);
+      }
    }
 
    public void submitRead(int fd,
@@ -230,13 +523,340 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
       }
       try {
          if (ioSpace != null) {
-            ioSpace.acquire();
+            ioSpace.acquire();
+         }
+      } catch (InterruptedException e) {
+         Thread.currentThread().interrupt();
+         throw new IOException(e.getMessage(), e);
+      }
+      if (callbackSlots != null) {
+         int slot = registerSlot(callback);
+         try {
+            submitReadSlot(fd, this.ioContext, position, size, bufferWrite, slot);
+         } catch (IOException | RuntimeException e) {
+            callbackSlots.release(slot);
+            throw e;
+         }
+      } else {
+         submitRead(fd, this.ioContext, position, size, bufferWrite, callback);
+      }
+   }
+
+   /**
+    * Documented at {@link LibaioFile#fill(int, long, int, boolean, SubmitInfo)}
+    *
+    * @param fd        the file descriptor
+    * @param alignment the alignment of the file
+    * @param size      number of bytes to be filled on the file
+    * @param depth     how many writes of the fill can be in flight at once
+    * @param zeroRange use fallocate(FALLOC_FL_ZERO_RANGE) if the file system supports it
+    * @param callback  completed once the whole file is filled
+    * @throws IOException in case of error
+    */
+   public void submitFill(int fd,
+                          int alignment,
+                          long size,
+                          int depth,
+                          boolean zeroRange,
+                          Callback callback) throws IOException {
+      if (closed.get()) {
+         throw new IOException("Libaio Context is closed!");
+      }
+      try {
+         if (ioSpace != null) {
+            ioSpace.acquire();
+         }
+      } catch (InterruptedException e) {
+         Thread.currentThread().interrupt();
+         throw new IOException(e.getMessage(), e);
+      }
+      if (callbackSlots != null) {
+         int slot = registerSlot(callback);
+         try {
+            submitFillSlot(fd, this.ioContext, alignment, size, depth, zeroRange, slot);
+         } catch (IOException | RuntimeException | OutOfMemoryError e) {
+            callbackSlots.release(slot);
+            throw e;
+         }
+      } else {
+         submitFill(fd, this.ioContext, alignment, size, depth, zeroRange, callback);
+      }
+   }
+
+   /**
+    * Documented at {@link LibaioFile#writeChain(long[], ByteBuffer[], int, SubmitInfo)}
+    *
+    * @param fd        the file descriptor
+    * @param positions the position of each write
+    * @param buffers   native buffers, each one written from its position to its limit
+    * @param barrier   how many of the writes go before the fdatasync, the others are only submitted once it completed
+    * @param callback  completed once all the writes are done, or with the first error of the chain
+    * @throws IOException in case of error
+    */
+   public void submitChain(int fd, long[] positions, ByteBuffer[] buffers, int barrier, Callback callback) throws IOException {
+      if (closed.get()) {
+         throw new IOException("Libaio Context is closed!");
+      }
+      int count = buffers.length;
+      if (count == 0 || count > MAX_CHAIN_WRITES || positions.length != count) {
+         throw new IOException("Chains need between 1 and " + MAX_CHAIN_WRITES + " writes, with a position each");
+      }
+      if (barrier < 0 || barrier > count) {
+         throw new IOException("Invalid barrier " + barrier + " for a chain of " + count + " writes");
+      }
+      int[] sizes = new int[count];
+      ByteBuffer[] slices = new ByteBuffer[count];
+      for (int i = 0; i < count; i++) {
+         sizes[i] = buffers[i].remaining();
+         // the native side only knows the address of a buffer
+         slices[i] = buffers[i].position() == 0 ? buffers[i] : buffers[i].slice();
+      }
+      try {
+         if (ioSpace != null) {
+            ioSpace.acquire();
+         }
+      } catch (InterruptedException e) {
+         Thread.currentThread().interrupt();
+         throw new IOException(e.getMessage(), e);
+      }
+      if (callbackSlots != null) {
+         int slot = registerSlot(callback);
+         try {
+            submitChainSlot(fd, this.ioContext, positions, sizes, slices, count, barrier, slot);
+         } catch (IOException | RuntimeException | OutOfMemoryError e) {
+            callbackSlots.release(slot);
+            throw e;
+         }
+      } else {
+         submitChain(fd, this.ioContext, positions, sizes, slices, count, barrier, callback);
+      }
+   }
+
+   /**
+    * Documented at {@link LibaioFile#writev(long, ByteBuffer[], SubmitInfo, boolean)}
+    *
+    * @param fd       the file descriptor
+    * @param position the write position
+    * @param buffers  up to 3 native buffers, each one written from its position to its limit
+    * @param callback a callback
+    * @param durable  the write is only completed once it is on stable storage
+    * @throws IOException in case of error
+    */
+   public void submitWritev(int fd, long position, ByteBuffer[] buffers, Callback callback, boolean durable) throws IOException {
+      submitVectored(fd, true, position, buffers, callback, durable);
+   }
+
+   /**
+    * Documented at {@link LibaioFile#readv(long, ByteBuffer[], SubmitInfo)}
+    *
+    * @param fd       the file descriptor
+    * @param position the read position
+    * @param buffers  up to 3 native buffers, each one read from its position to its limit
+    * @param callback a callback
+    * @throws IOException in case of error
+    */
+   public void submitReadv(int fd, long position, ByteBuffer[] buffers, Callback callback) throws IOException {
+      submitVectored(fd, false, position, buffers, callback, false);
+   }
+
+   private void submitVectored(int fd,
+                               boolean write,
+                               long position,
+                               ByteBuffer[] buffers,
+                               Callback callback,
+                               boolean durable) throws IOException {
+      if (closed.get()) {
+         throw new IOException("Libaio Context is closed!");
+      }
+      if (buffers.length == 0 || buffers.length > MAX_VECTORED_BUFFERS) {
+         throw new IOException("Vectored submits need between 1 and " + MAX_VECTORED_BUFFERS + " buffers");
+      }
+      int[] offsets = new int[buffers.length];
+      int[] sizes = new int[buffers.length];
+      for (int i = 0; i < buffers.length; i++) {
+         offsets[i] = buffers[i].position();
+         sizes[i] = buffers[i].remaining();
+      }
+      try {
+         if (ioSpace != null) {
+            ioSpace.acquire();
+         }
+      } catch (InterruptedException e) {
+         Thread.currentThread().interrupt();
+         throw new IOException(e.getMessage(), e);
+      }
+      if (callbackSlots != null) {
+         int slot = registerSlot(callback);
+         try {
+            submitVectored(fd, this.ioContext, write, position, buffers, offsets, sizes, null, slot, durable);
+         } catch (IOException | RuntimeException e) {
+            callbackSlots.release(slot);
+            throw e;
+         }
+      } else {
+         submitVectored(fd, this.ioContext, write, position, buffers, offsets, sizes, callback, -1, durable);
+      }
+   }
+
+   /**
+    * Documented at {@link LibaioFile#tryWrite(long, int, ByteBuffer, SubmitInfo, boolean)}
+    *
+    * @return {@link #SUBMIT_OK}, {@link #SUBMIT_QUEUE_FULL}, {@link #SUBMIT_FILE_LIMIT} or -errno
+    */
+   public int trySubmitWrite(int fd, long position, int size, ByteBuffer bufferWrite, Callback callback, boolean durable) {
+      return trySubmit(fd, true, position, size, bufferWrite, callback, durable);
+   }
+
+   /**
+    * Documented at {@link LibaioFile#tryRead(long, int, ByteBuffer, SubmitInfo)}
+    *
+    * @return {@link #SUBMIT_OK}, {@link #SUBMIT_QUEUE_FULL}, {@link #SUBMIT_FILE_LIMIT} or -errno
+    */
+   public int trySubmitRead(int fd, long position, int size, ByteBuffer bufferRead, Callback callback) {
+      return trySubmit(fd, false, position, size, bufferRead, callback, false);
+   }
+
+   private int trySubmit(int fd, boolean write, long position, int size, ByteBuffer buffer, Callback callback, boolean durable) {
+      if (closed.get()) {
+         throw new IllegalStateException("Libaio Context is closed!");
+      }
+      if (ioSpace != null && !ioSpace.tryAcquire()) {
+         return SUBMIT_QUEUE_FULL;
+      }
+      int slot = -1;
+      if (callbackSlots != null) {
+         slot = callbackSlots.register(callback);
+         if (slot < 0) {
+            if (ioSpace != null) {
+               ioSpace.release();
+            }
+            return SUBMIT_QUEUE_FULL;
+         }
+      }
+      int status = trySubmit(fd, ioContext, write, position, size, buffer, callbackSlots != null ? null : callback, slot, durable);
+      if (status != SUBMIT_OK) {
+         if (slot >= 0) {
+            callbackSlots.release(slot);
+         }
+         if (ioSpace != null) {
+            ioSpace.release();
+         }
+      }
+      return status;
+   }
+
+   private int registerSlot(Callback callback) throws IOException {
+      int slot = callbackSlots.register(callback);
+      if (slot < 0) {
+         throw new IOException("Not enough space in libaio queue");
+      }
+      return slot;
+   }
+
+   /**
+    * It will submit count writes at once, using a single io_submit on the native layer.
+    * <br>
+    * The element at index i of each array describes the i-th write.
+    * In case the kernel only accepted part of the batch, the writes that were not submitted will have
+    * {@link SubmitInfo#onError(int, String)} called on their callbacks and they will never be polled.
+    *
+    * @param fds       the file descriptors
+    * @param positions the write positions
+    * @param sizes     number of bytes to use on each write
+    * @param buffers   the native buffers
+    * @param callbacks the callbacks
+    * @param count     number of writes to submit
+    * @return the number of writes submitted.
+    * @throws IOException in case of error
+    */
+   public int submitBatch(int[] fds,
+                          long[] positions,
+                          int[] sizes,
+                          ByteBuffer[] buffers,
+                          Callback[] callbacks,
+                          int count) throws IOException {
+      checkNotNull(fds, "fds");
+      if (fds.length < count) {
+         throw new IllegalArgumentException("fds has less than " + count + " elements");
+      }
+      return submitWriteBatch(0, fds, positions, sizes, buffers, callbacks, count);
+   }
+
+   /**
+    * Documented at {@link LibaioFile#writeBatch(long[], int[], ByteBuffer[], SubmitInfo[], int)}
+    */
+   int submitWriteBatch(int fd,
+                        int[] fds,
+                        long[] positions,
+                        int[] sizes,
+                        ByteBuffer[] buffers,
+                        Callback[] callbacks,
+                        int count) throws IOException {
+      checkNotNull(positions, "positions");
+      checkNotNull(sizes, "sizes");
+      checkNotNull(buffers, "buffers");
+      checkNotNull(callbacks, "callbacks");
+      if (positions.length < count || sizes.length < count || buffers.length < count || callbacks.length < count) {
+         throw new IllegalArgumentException("The batch arrays need at least " + count + " elements");
+      }
+      if (closed.get()) {
+         throw new IOException("Libaio Context is closed!");
+      }
+      if (count <= 0) {
+         return 0;
+      }
+      if (count > queueSize) {
+         // this would block forever on the semaphore
+         throw new IOException("Not enough space in libaio queue");
+      }
+      try {
+         if (ioSpace != null) {
+            ioSpace.acquire(count);
+         }
+      } catch (InterruptedException e) {
+         Thread.currentThread().interrupt();
+         throw new IOException(e.getMessage(), e);
+      }
+      int[] slots = null;
+      if (callbackSlots != null) {
+         slots = new int[count];
+         for (int i = 0; i < count; i++) {
+            slots[i] = callbackSlots.register(callbacks[i]);
+            if (slots[i] < 0) {
+               releaseSlots(slots, 0, i);
+               if (ioSpace != null) {
+                  ioSpace.release(count);
+               }
+               throw new IOException("Not enough space in libaio queue");
+            }
+         }
+      }
+      int submitted;
+      try {
+         submitted = submitWriteBatch(this.ioContext, fd, fds, positions, sizes, buffers, callbacks, slots, count);
+      } catch (IOException | RuntimeException e) {
+         if (slots != null) {
+            releaseSlots(slots, 0, count);
+         }
+         if (ioSpace != null) {
+            ioSpace.release(count);
          }
-      } catch (InterruptedException e) {
-         Thread.currentThread().interrupt();
-         throw new IOException(e.getMessage(), e);
+         throw e;
+      }
+      if (slots != null && submitted < count) {
+         // the native layer already called onError for these
+         releaseSlots(slots, submitted, count);
+      }
+      if (ioSpace != null && submitted < count) {
+         ioSpace.release(count - submitted);
+      }
+      return submitted;
+   }
+
+   private void releaseSlots(int[] slots, int from, int to) {
+      for (int i = from; i < to; i++) {
+         callbackSlots.release(slots[i]);
       }
-      submitRead(fd, this.ioContext, position, size, bufferWrite, callback);
    }
 
    /**
@@ -256,7 +876,7 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
                logger.warn(e.getMessage(), e);
             }
          }
-         totalMaxIO.addAndGet(-queueSize);
+         totalMaxIO.addAndGet(-(queueSize + fillReserve));
 
          if (ioContext != null) {
             deleteContext(ioContext);
@@ -299,6 +919,27 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
       return new LibaioFile<>(res, this);
    }
 
+   /**
+    * It will open a raw block device or partition, so a journal can bypass the file system entirely.
+    * The device is opened exclusively: it is never created, and this fails while the device is mounted or open
+    * exclusively by anything else. Use {@link LibaioFile#getAlignment()} for the sector sizes of the device,
+    * and {@link LibaioFile#getSize()} for its size.
+    *
+    * @param device the path of the device, such as /dev/nvme0n1p2
+    * @param direct should use O_DIRECT when opening the device.
+    * @return a new open device.
+    * @throws IOException in case of error, or if device is not a block device.
+    */
+   public LibaioFile<Callback> openDevice(String device, boolean direct) throws IOException {
+      checkNotNull(device, "path");
+      checkNotNull(ioContext, "IOContext");
+
+      // note: the native layer will throw an IOException in case of errors
+      int res = LibaioContext.openDevice(device, direct);
+
+      return new LibaioFile<>(res, this);
+   }
+
    /**
     * It will open a file disassociated with any sort of factory.
     * This is useful when you won't use reading / writing through libaio like locking files.
@@ -328,6 +969,62 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
       return arg;
    }
 
+   /**
+    * @return the eventfd signaled on every completion, or -1 if this context was not created with {@link #CONTEXT_EVENTFD}.
+    * It is non blocking, and it is closed with the context.
+    */
+   public int getEventFd() {
+      return getEventFd(ioContext);
+   }
+
+   /**
+    * Registers buffers on the io_uring of this context (IORING_REGISTER_BUFFERS): reads and writes that fall entirely
+    * inside one of them are submitted as READ_FIXED / WRITE_FIXED, so the kernel doesn't pin their pages on every request.
+    * It replaces the buffers registered before.
+    * <br>
+    * The buffers need to stay allocated until {@link #unregisterBuffers()} or until the context is closed:
+    * freeing a registered buffer could make a later buffer at the same address go to the stale registration.
+    * The pages are locked while registered, what counts against RLIMIT_MEMLOCK.
+    *
+    * @param buffers direct buffers, such as the ones of {@link #newAlignedBuffer(int, int)} or {@link AlignedBufferPool#acquire(int)}
+    * @return false if the context is not using io_uring, and then nothing is registered
+    * @throws IOException if the kernel refuses the registration
+    */
+   public boolean registerBuffers(ByteBuffer... buffers) throws IOException {
+      return registerBuffers(ioContext, buffers);
+   }
+
+   /**
+    * Releases the buffers registered by {@link #registerBuffers(ByteBuffer...)}, the requests in flight are not affected.
+    */
+   public void unregisterBuffers() {
+      unregisterBuffers(ioContext);
+   }
+
+   /**
+    * @see LibaioFile#register()
+    */
+   boolean registerFile(int fd) throws IOException {
+      return registerFile(ioContext, fd);
+   }
+
+   void unregisterFile(int fd) {
+      unregisterFile(ioContext, fd);
+   }
+
+   /**
+    * Reaps whatever completed without blocking, to be called once {@link #getEventFd()} is readable.
+    * The eventfd is reset before reaping, so a completion arriving meanwhile signals it again.
+    *
+    * @param callbacks area to receive the callbacks, up to its length or the queue size
+    * @return Number of callbacks returned.
+    * @see #poll(SubmitInfo[], int, int)
+    */
+   public int pollReady(Callback[] callbacks) {
+      drainEventFd(ioContext);
+      return poll(callbacks, 0, Math.min(callbacks.length, queueSize));
+   }
+
    /**
     * It will poll the libaio queue for results. It should block until min is reached
     * Results are placed on the callback.
@@ -347,7 +1044,31 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
     * @see LibaioFile#read(long, int, java.nio.ByteBuffer, SubmitInfo)
     */
    public int poll(Callback[] callbacks, int min, int max) {
-      int released = poll(ioContext, callbacks, min, max);
+      return poll(callbacks, min, max, -1);
+   }
+
+   /**
+    * Same as {@link #poll(SubmitInfo[], int, int)}, but it won't block for longer than timeoutNanos:
+    * when the deadline is reached it returns whatever completed so far, even if that's fewer than min.
+    *
+    * @param timeoutNanos the maximum time to wait for min elements, 0 to not block at all, or negative to not time out.
+    * @return Number of callbacks returned.
+    */
+   public int poll(Callback[] callbacks, int min, int max, long timeoutNanos) {
+      int released;
+      if (callbackSlots != null) {
+         released = pollSlots(ioContext, slotCompletions, min, Math.min(max, queueSize), timeoutNanos);
+         for (int i = 0; i < released; i++) {
+            Callback callback = callbackSlots.release(slotCompletions[i * 2]);
+            int result = slotCompletions[i * 2 + 1];
+            if (result < 0 && callback != null) {
+               callback.onError(-result, errorMessage(-result));
+            }
+            callbacks[i] = callback;
+         }
+      } else {
+         released = poll(ioContext, callbacks, min, max, timeoutNanos);
+      }
       if (ioSpace != null) {
          if (released > 0) {
             ioSpace.release(released);
@@ -364,9 +1085,141 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
     * {@link SubmitInfo#done()} are called.
     */
    public void poll() {
+      poll(1, -1);
+   }
+
+   /**
+    * Same as {@link #poll()}, but completions are delivered in batches with a bounded latency:
+    * every round waits for minBatch completions or up to timeoutNanos, whatever comes first.
+    * <br>
+    * With a timeout the poller also wakes up periodically, and it stops at the first wake up after the context is closed.
+    *
+    * @param minBatch     the completions to wait for on every round, it needs a timeout when greater than 1
+    * @param timeoutNanos the maximum time to wait for minBatch completions, or negative to not time out
+    */
+   public void poll(int minBatch, long timeoutNanos) {
+      if (minBatch > 1 && timeoutNanos < 0) {
+         // the close is signaled by a single completion, that would never be delivered
+         throw new IllegalArgumentException("A batch of " + minBatch + " completions needs a timeout");
+      }
       if (!closed.get()) {
-         blockedPoll(ioContext, useFdatasync);
+         if (callbackSlots != null) {
+            blockedPollSlots(ioContext, useFdatasync, completionBuffer, minBatch, timeoutNanos);
+         } else {
+            blockedPoll(ioContext, useFdatasync, minBatch, timeoutNanos);
+         }
+      }
+   }
+
+   /**
+    * @return the engine used by this context, {@link #ENGINE_LIBAIO} or {@link #ENGINE_IO_URING}.
+    */
+   public int getEngine() {
+      return getEngine(ioContext);
+   }
+
+   /**
+    * @return the NUMA node of the native memory of this context, or -1 if it has no preference.
+    */
+   public int getNumaNode() {
+      return numaNode;
+   }
+
+   /**
+    * @return the bytes of native memory of this context locked with mlock, 0 unless it was created with {@link #CONTEXT_HUGE_PAGES}
+    *         or if RLIMIT_MEMLOCK didn't allow it, in which case the memory is still prefaulted.
+    */
+   public long getLockedBytes() {
+      return getLockedBytes(ioContext);
+   }
+
+   /**
+    * Enables the hybrid poll: when there are not enough events on the ring, the poller will spin on
+    * the ring for up to spinIterations and / or spinNanos (whatever comes first) before blocking on the kernel.
+    * This trades CPU for latency. Use 0 and 0 to block right away, which is the default.
+    *
+    * @param spinIterations the maximum number of spins, 0 for no limit on the number of spins
+    * @param spinNanos      the maximum time spinning, 0 for no limit on the time
+    */
+   public void setHybridPoll(int spinIterations, long spinNanos) {
+      if (spinIterations < 0 || spinNanos < 0) {
+         throw new IllegalArgumentException("spinIterations and spinNanos can't be negative");
+      }
+      setHybridPoll(ioContext, spinIterations, spinNanos);
+   }
+
+   /**
+    * Sets what a submit does when the queue is full, or when its file is at its in flight limit:
+    * it spins up to spinIterations and then parks on the native layer, until it is admitted or maxWaitNanos elapsed.
+    * Only then it gives up, with an IOException or with the status of a try submit.
+    * Use 0 and 0 to give up right away, which is the default.
+    * <br>
+    * The wait only makes sense on a context created without a semaphore, as the semaphore already blocks on the
+    * Java side before the queue is full.
+    *
+    * @param spinIterations the spins before parking
+    * @param maxWaitNanos   the maximum time waiting for space, including the spins
+    */
+   public void setAdmissionControl(int spinIterations, long maxWaitNanos) {
+      if (spinIterations < 0 || maxWaitNanos < 0) {
+         throw new IllegalArgumentException("spinIterations and maxWaitNanos can't be negative");
+      }
+      setAdmissionControl(ioContext, spinIterations, maxWaitNanos);
+   }
+
+   /**
+    * @see LibaioFile#setInFlightLimit(int)
+    */
+   boolean setFileLimit(int fd, int limit) {
+      return setFileLimit(ioContext, fd, limit);
+   }
+
+   /**
+    * @return how many times the hybrid poll found the events while spinning.
+    */
+   public long getSpinHits() {
+      return getSpinHits(ioContext);
+   }
+
+   /**
+    * @return how many times the hybrid poll gave up spinning and blocked on the kernel.
+    */
+   public long getParks() {
+      return getParks(ioContext);
+   }
+
+   /**
+    * When using fdatasync the blocked poll does a group commit: one fdatasync per distinct file on each round of
+    * completions, before any of their callbacks is called.
+    *
+    * @return how many fdatasync calls were done by the blocked poll.
+    */
+   public long getSyncs() {
+      return getSyncs(ioContext);
+   }
+
+   /**
+    * Enables the stats of this context: every submit is timed, and the latency of its completion goes to a histogram.
+    * The in flight gauges only account for the submits done while the stats are enabled.
+    * The stats are disabled by default.
+    */
+   public void setStatsEnabled(boolean enabled) {
+      setStatsEnabled(ioContext, enabled);
+   }
+
+   /**
+    * It takes a snapshot of the stats without stopping the I/O, so the counters could be a few events apart of each other.
+    * The context can't be closed concurrently with this.
+    *
+    * @return the stats of this context, they are all zero until {@link #setStatsEnabled(boolean)}
+    */
+   public LibaioStats getStats() {
+      if (closed.get()) {
+         throw new IllegalStateException("Libaio Context is closed!");
       }
+      long[] values = new long[STATS_LENGTH];
+      statsBuffer.asLongBuffer().get(values);
+      return new LibaioStats(values);
    }
 
    /**
@@ -379,10 +1232,47 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
       }
    }
 
+   /**
+    * Called from the native layer once per round of events when using callback slots.
+    *
+    * @param count the number of (slot, result) pairs written on {@link #completionBuffer}
+    */
+   private void doneBatch(int count) {
+      final ByteBuffer completions = completionBuffer;
+      for (int i = 0; i < count; i++) {
+         Callback callback = callbackSlots.release(completions.getInt(i * 2 * Integer.BYTES));
+         int result = completions.getInt((i * 2 + 1) * Integer.BYTES);
+         if (callback != null) {
+            if (result < 0) {
+               callback.onError(-result, errorMessage(-result));
+            }
+            callback.done();
+         }
+      }
+      if (ioSpace != null) {
+         ioSpace.release(count);
+      }
+   }
+
+   static String errorMessage(int errorNumber) {
+      if (errorNumber < 0 || errorNumber >= errorMessages.length) {
+         return strError(errorNumber);
+      }
+      String message = errorMessages[errorNumber];
+      if (message == null) {
+         // racing here is harmless, the message is always the same
+         message = strError(errorNumber);
+         errorMessages[errorNumber] = message;
+      }
+      return message;
+   }
+
    /**
     * This is the queue for libaio, initialized with queueSize.
+    *
+    * @param flags a combination of the CONTEXT_ flags.
     */
-   private native ByteBuffer newContext(int queueSize);
+   private native ByteBuffer newContext(int queueSize, int flags, int numaNode);
 
    /**
     * Internal method to be used when closing the controller.
@@ -398,6 +1288,13 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
     */
    public static native int open(String path, boolean direct);
 
+   /**
+    * Opens a raw block device or partition, exclusively: it is never created, and it fails while the device is mounted.
+    *
+    * @return the file descriptor
+    */
+   public static native int openDevice(String path, boolean direct);
+
    public static native void close(int fd);
 
    /**
@@ -414,6 +1311,21 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
     */
    public static native ByteBuffer newAlignedBuffer(int size, int alignment);
 
+   /**
+    * Same as {@link #newAlignedBuffer(int, int)}, with the pages of the buffer on numaNode.
+    * It is released with {@link #freeBuffer(ByteBuffer)} as well.
+    *
+    * @param size      needs to be % alignment
+    * @param alignment the alignment used at the dispositive
+    * @param numaNode  the NUMA node of the buffer
+    * @return a new native buffer used with posix_memalign
+    */
+   public static ByteBuffer newAlignedBuffer(int size, int alignment, int numaNode) {
+      return newAlignedNodeBuffer(size, alignment, numaNode);
+   }
+
+   private static native ByteBuffer newAlignedNodeBuffer(int size, int alignment, int numaNode);
+
    /**
     * This will call posix free to release the inner buffer allocated at {@link #newAlignedBuffer(int, int)}.
     *
@@ -422,14 +1334,57 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
    public static native void freeBuffer(ByteBuffer buffer);
 
    /**
-    * Documented at {@link LibaioFile#write(long, int, java.nio.ByteBuffer, SubmitInfo)}.
+    * Creates a pool of aligned buffers, to be used instead of {@link #newAlignedBuffer(int, int)} and
+    * {@link #freeBuffer(ByteBuffer)} when buffers are allocated and released often.
+    *
+    * @param alignment   the alignment used at the dispositive, it needs to be a power of 2
+    * @param hugePages   back the pool with huge pages, using transparent huge pages if none are reserved
+    * @param zeroBuffers zero the buffers every time they are acquired, otherwise a recycled buffer keeps its previous content
+    * @return the new pool, it needs to be closed to release its memory
+    */
+   public static AlignedBufferPool newAlignedBufferPool(int alignment, boolean hugePages, boolean zeroBuffers) {
+      return newAlignedBufferPool(alignment, hugePages, zeroBuffers, -1);
+   }
+
+   /**
+    * Same as {@link #newAlignedBufferPool(int, boolean, boolean)}, with the slabs of the pool on numaNode.
+    *
+    * @param numaNode the NUMA node of the buffers, -1 for no preference
+    */
+   public static AlignedBufferPool newAlignedBufferPool(int alignment, boolean hugePages, boolean zeroBuffers, int numaNode) {
+      int flags = 0;
+      if (hugePages) {
+         flags |= BUFFER_POOL_HUGE_PAGES;
+      }
+      if (zeroBuffers) {
+         flags |= BUFFER_POOL_ZERO;
+      }
+      return new AlignedBufferPool(newBufferPool(alignment, flags, numaNode), alignment);
+   }
+
+   static native ByteBuffer newBufferPool(int alignment, int flags, int numaNode);
+
+   static native void deleteBufferPool(ByteBuffer pool);
+
+   static native ByteBuffer acquireBuffer(ByteBuffer pool, int size);
+
+   static native void releaseBuffer(ByteBuffer pool, ByteBuffer buffer);
+
+   /**
+    * @param stats filled with the outstanding, pooled and reserved bytes
+    */
+   static native void getBufferPoolStats(ByteBuffer pool, long[] stats);
+
+   /**
+    * Documented at {@link LibaioFile#write(long, int, java.nio.ByteBuffer, SubmitInfo, boolean)}.
     */
    native void submitWrite(int fd,
                            ByteBuffer libaioContext,
                            long position,
                            int size,
                            ByteBuffer bufferWrite,
-                           Callback callback) throws IOException;
+                           Callback callback,
+                           boolean durable) throws IOException;
 
    /**
     * Documented at {@link LibaioFile#read(long, int, java.nio.ByteBuffer, SubmitInfo)}.
@@ -441,18 +1396,181 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
                           ByteBuffer bufferWrite,
                           Callback callback) throws IOException;
 
+   /**
+    * A write or a read that never throws, the callback is only used without callback slots and the slot only with them.
+    *
+    * @return {@link #SUBMIT_OK}, {@link #SUBMIT_QUEUE_FULL}, {@link #SUBMIT_FILE_LIMIT} or -errno
+    */
+   native int trySubmit(int fd,
+                        ByteBuffer libaioContext,
+                        boolean write,
+                        long position,
+                        int size,
+                        ByteBuffer buffer,
+                        Callback callback,
+                        int slot,
+                        boolean durable);
+
+   /**
+    * Same as {@link #submitWrite(int, ByteBuffer, long, int, ByteBuffer, SubmitInfo, boolean)}, for callback slots.
+    */
+   native void submitWriteSlot(int fd,
+                               ByteBuffer libaioContext,
+                               long position,
+                               int size,
+                               ByteBuffer bufferWrite,
+                               int slot,
+                               boolean durable) throws IOException;
+
+   /**
+    * Same as {@link #submitRead(int, ByteBuffer, long, int, ByteBuffer, SubmitInfo)}, for callback slots.
+    */
+   native void submitReadSlot(int fd,
+                              ByteBuffer libaioContext,
+                              long position,
+                              int size,
+                              ByteBuffer bufferRead,
+                              int slot) throws IOException;
+
+   /**
+    * Documented at {@link #submitWritev(int, long, ByteBuffer[], SubmitInfo, boolean)} and {@link #submitReadv(int, long, ByteBuffer[], SubmitInfo)}.
+    * callback is only used without callback slots, and slot only with them.
+    */
+   native void submitVectored(int fd,
+                              ByteBuffer libaioContext,
+                              boolean write,
+                              long position,
+                              ByteBuffer[] buffers,
+                              int[] offsets,
+                              int[] sizes,
+                              Callback callback,
+                              int slot,
+                              boolean durable) throws IOException;
+
+   /**
+    * Documented at {@link #submitFill(int, int, long, int, boolean, SubmitInfo)}.
+    */
+   native void submitFill(int fd,
+                          ByteBuffer libaioContext,
+                          int alignment,
+                          long size,
+                          int depth,
+                          boolean zeroRange,
+                          Callback callback) throws IOException;
+
+   /**
+    * Same as {@link #submitFill(int, ByteBuffer, int, long, int, boolean, SubmitInfo)}, for callback slots.
+    */
+   native void submitFillSlot(int fd,
+                              ByteBuffer libaioContext,
+                              int alignment,
+                              long size,
+                              int depth,
+                              boolean zeroRange,
+                              int slot) throws IOException;
+
+   /**
+    * Documented at {@link #submitChain(int, long[], ByteBuffer[], int, SubmitInfo)}.
+    */
+   native void submitChain(int fd,
+                           ByteBuffer libaioContext,
+                           long[] positions,
+                           int[] sizes,
+                           ByteBuffer[] buffers,
+                           int count,
+                           int barrier,
+                           Callback callback) throws IOException;
+
+   /**
+    * Same as {@link #submitChain(int, ByteBuffer, long[], int[], ByteBuffer[], int, int, SubmitInfo)}, for callback slots.
+    */
+   native void submitChainSlot(int fd,
+                               ByteBuffer libaioContext,
+                               long[] positions,
+                               int[] sizes,
+                               ByteBuffer[] buffers,
+                               int count,
+                               int barrier,
+                               int slot) throws IOException;
+
+   /**
+    * Documented at {@link #submitBatch(int[], long[], int[], ByteBuffer[], SubmitInfo[], int)}.
+    * If fds is null every write will go to fd.
+    * slots is null unless callback slots are used, in which case the slot ids are passed to the kernel instead of the callbacks.
+    */
+   native int submitWriteBatch(ByteBuffer libaioContext,
+                               int fd,
+                               int[] fds,
+                               long[] positions,
+                               int[] sizes,
+                               ByteBuffer[] buffers,
+                               Callback[] callbacks,
+                               int[] slots,
+                               int count) throws IOException;
+
    /**
     * Note: this shouldn't be done concurrently.
     * This method will block until the min condition is satisfied on the poll.
     * <p/>
     * The callbacks will include the original callback sent at submit (read or write).
+    * A timeoutNanos that is not negative bounds the wait.
+    */
+   native int poll(ByteBuffer libaioContext, Callback[] callbacks, int min, int max, long timeoutNanos);
+
+   /**
+    * Same as {@link #poll(ByteBuffer, SubmitInfo[], int, int, long)}, for callback slots.
+    * completions will receive a pair of slot id and result (negative errno on failures) per completed event.
+    */
+   native int pollSlots(ByteBuffer libaioContext, int[] completions, int min, int max, long timeoutNanos);
+
+   /**
+    * @return the strerror message for errorNumber.
     */
-   native int poll(ByteBuffer libaioContext, Callback[] callbacks, int min, int max);
+   static native String strError(int errorNumber);
 
    /**
     * This method will block as long as the context is open.
+    * Each round waits for minBatch events, or up to timeoutNanos when it's not negative.
     */
-   native void blockedPoll(ByteBuffer libaioContext, boolean useFdatasync);
+   native void blockedPoll(ByteBuffer libaioContext, boolean useFdatasync, int minBatch, long timeoutNanos);
+
+   /**
+    * Same as {@link #blockedPoll(ByteBuffer, boolean, int, long)}, for callback slots.
+    * The completions are written to completions and delivered with a single call to {@link #doneBatch(int)} per round.
+    */
+   native void blockedPollSlots(ByteBuffer libaioContext, boolean useFdatasync, ByteBuffer completions, int minBatch, long timeoutNanos);
+
+   static native int getEngine(ByteBuffer libaioContext);
+
+   static native long getLockedBytes(ByteBuffer libaioContext);
+
+   static native int getEventFd(ByteBuffer libaioContext);
+
+   static native long drainEventFd(ByteBuffer libaioContext);
+
+   static native boolean registerBuffers(ByteBuffer libaioContext, ByteBuffer[] buffers) throws IOException;
+
+   static native void unregisterBuffers(ByteBuffer libaioContext);
+
+   static native boolean registerFile(ByteBuffer libaioContext, int fd) throws IOException;
+
+   static native void unregisterFile(ByteBuffer libaioContext, int fd);
+
+   static native void setHybridPoll(ByteBuffer libaioContext, int spinIterations, long spinNanos);
+
+   static native void setAdmissionControl(ByteBuffer libaioContext, int spinIterations, long maxWaitNanos);
+
+   static native boolean setFileLimit(ByteBuffer libaioContext, int fd, int limit);
+
+   static native long getSpinHits(ByteBuffer libaioContext);
+
+   static native long getParks(ByteBuffer libaioContext);
+
+   static native long getSyncs(ByteBuffer libaioContext);
+
+   static native void setStatsEnabled(ByteBuffer libaioContext, boolean enabled);
+
+   static native ByteBuffer getStatsBuffer(ByteBuffer libaioContext);
 
    static native int getNativeVersion();
 
@@ -464,6 +1582,35 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
 
    static native int getBlockSizeFD(int fd);
 
+   /**
+    * Documented at {@link LibaioFile#getAlignment()}.
+    */
+   static native void getAlignment(int fd, int[] alignment) throws IOException;
+
+   /**
+    * @return the device of the file, or the device itself for block devices
+    */
+   static native long getDevice(int fd) throws IOException;
+
+   /**
+    * Pins the calling thread to a cpu.
+    *
+    * @return 0, or the errno of pthread_setaffinity_np
+    */
+   static native int setThreadAffinity(int cpu);
+
+   /**
+    * Binds the calling thread to the cpus of a NUMA node, and makes its native allocations prefer the memory of the node.
+    * A poller of a context created on a node should call it before polling.
+    *
+    * @return 0, or the errno of the failure
+    */
+   public static int bindToNumaNode(int node) {
+      return setThreadNode(node);
+   }
+
+   static native int setThreadNode(int node);
+
    public static int getBlockSize(File path) {
       return getBlockSize(path.getAbsolutePath());
    }
@@ -472,7 +1619,30 @@ public class LibaioContext<Callback extends SubmitInfo> implements Closeable {
 
    static native void fallocate(int fd, long size);
 
+   static native void fallocateRange(int fd, int mode, long offset, long length, boolean sync) throws IOException;
+
+   /**
+    * Documented at {@link LibaioFile#map(long)}.
+    *
+    * @return a direct buffer over a MAP_SHARED mapping of the first size bytes of the file
+    */
+   static native ByteBuffer map(int fd, long size) throws IOException;
+
+   static native void unmap(ByteBuffer mapping) throws IOException;
+
+   /**
+    * msync(MS_SYNC) of a range of a mapping, widened to whole pages.
+    */
+   static native void syncMapping(ByteBuffer mapping, long offset, long length) throws IOException;
+
+   /**
+    * sync_file_range of a range of the file, waiting for the write back if wait is set.
+    */
+   static native void syncFileRange(int fd, long offset, long length, boolean wait) throws IOException;
+
    static native void fill(int fd, int alignment, long size);
 
    static native void writeInternal(int fd, long position, long size, ByteBuffer bufferWrite) throws IOException;
+
+   static native void writevInternal(int fd, long position, ByteBuffer[] buffers, int[] offsets, int[] sizes) throws IOException;
 }
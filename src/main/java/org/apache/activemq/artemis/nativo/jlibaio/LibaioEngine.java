@@ -0,0 +1,218 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio;
+
+import java.io.File;
+import java.io.IOException;
+import java.util.concurrent.atomic.AtomicBoolean;
+
+import org.slf4j.Logger;
+import org.slf4j.LoggerFactory;
+
+/**
+ * A set of {@link LibaioContext} shards, each one with its own poller thread, so completions are not serialized
+ * through a single blocked poll.
+ * <br>
+ * Files are routed to a shard when they are opened, by file descriptor or by device. Every operation of a file goes
+ * through its shard, and the callbacks are called by the poller of that shard with the same {@link SubmitInfo} contract
+ * as {@link LibaioContext#poll()}.
+ * <br>
+ * Each poller can be pinned to a CPU, and each shard can be placed on a NUMA node, with its poller bound to that node.
+ */
+public final class LibaioEngine<Callback extends SubmitInfo> implements AutoCloseable {
+
+   private static final Logger logger = LoggerFactory.getLogger(LibaioEngine.class);
+
+   public enum Routing {
+      /**
+       * Files are spread over the shards by their file descriptor.
+       */
+      FD,
+      /**
+       * All the files of a device go to the same shard, so each device is completed by a single poller.
+       * Different devices could still share a shard when there are more devices than shards.
+       */
+      DEVICE
+   }
+
+   private final LibaioContext<Callback>[] shards;
+
+   private final Thread[] pollers;
+
+   private final Routing routing;
+
+   private final AtomicBoolean closed = new AtomicBoolean(false);
+
+   /**
+    * @param shards       the number of contexts, and poller threads
+    * @param queueSize    the queue size of each context
+    * @param useSemaphore see {@link LibaioContext#LibaioContext(int, boolean, boolean)}
+    * @param useFdatasync see {@link LibaioContext#LibaioContext(int, boolean, boolean)}
+    * @param routing      how files are routed to the shards
+    * @param cpus         the poller of shard i is pinned to cpus[i % cpus.length], or null to not pin them
+    */
+   public LibaioEngine(int shards, int queueSize, boolean useSemaphore, boolean useFdatasync, Routing routing, int[] cpus) {
+      this(shards, queueSize, useSemaphore, useFdatasync, routing, cpus, null);
+   }
+
+   /**
+    * @param shards       the number of contexts, and poller threads
+    * @param queueSize    the queue size of each context
+    * @param useSemaphore see {@link LibaioContext#LibaioContext(int, boolean, boolean)}
+    * @param useFdatasync see {@link LibaioContext#LibaioContext(int, boolean, boolean)}
+    * @param routing      how files are routed to the shards
+    * @param cpus         the poller of shard i is pinned to cpus[i % cpus.length], or null to not pin them
+    * @param numaNodes    the context of shard i is allocated on numaNodes[i % numaNodes.length], and its poller is bound
+    *                     to the cpus of that node unless it is pinned to a cpu, or null for no preference
+    */
+   @SuppressWarnings("unchecked")
+   public LibaioEngine(int shards, int queueSize, boolean useSemaphore, boolean useFdatasync, Routing routing, int[] cpus, int[] numaNodes) {
+      if (shards <= 0) {
+         throw new IllegalArgumentException("shards must be positive");
+      }
+      if (cpus != null && cpus.length == 0) {
+         throw new IllegalArgumentException("cpus can't be empty");
+      }
+      if (numaNodes != null && numaNodes.length == 0) {
+         throw new IllegalArgumentException("numaNodes can't be empty");
+      }
+      this.routing = routing;
+      this.shards = new LibaioContext[shards];
+      this.pollers = new Thread[shards];
+      try {
+         for (int i = 0; i < shards; i++) {
+            int numaNode = numaNodes == null ? -1 : numaNodes[i % numaNodes.length];
+            this.shards[i] = new LibaioContext<>(queueSize, useSemaphore, useFdatasync, 0, numaNode);
+         }
+      } catch (RuntimeException e) {
+         closeShards();
+         throw e;
+      }
+      for (int i = 0; i < shards; i++) {
+         pollers[i] = new Thread(new Poller(this.shards[i], cpus == null ? -1 : cpus[i % cpus.length]), "libaio-poller-" + i);
+         pollers[i].setDaemon(true);
+         pollers[i].start();
+      }
+   }
+
+   public int getShards() {
+      return shards.length;
+   }
+
+   public LibaioContext<Callback> getShard(int index) {
+      return shards[index];
+   }
+
+   /**
+    * @return the sum of the queue sizes of all the shards, the IO this engine takes from the system limit (aio-max-nr).
+    */
+   public long getTotalMaxIO() {
+      long total = 0;
+      for (LibaioContext<Callback> shard : shards) {
+         total += shard.queueSize;
+      }
+      return total;
+   }
+
+   public LibaioFile<Callback> openFile(File file, boolean direct) throws IOException {
+      return openFile(file.getPath(), direct);
+   }
+
+   /**
+    * It will open a file on the shard chosen by the routing of this engine.
+    *
+    * @see LibaioContext#openFile(String, boolean)
+    */
+   public LibaioFile<Callback> openFile(String file, boolean direct) throws IOException {
+      if (closed.get()) {
+         throw new IOException("Libaio Engine is closed!");
+      }
+      // note: the native layer will throw an IOException in case of errors
+      int fd = LibaioContext.open(file, direct);
+      int shard;
+      try {
+         shard = shardOf(fd);
+      } catch (IOException | RuntimeException e) {
+         LibaioContext.close(fd);
+         throw e;
+      }
+      return new LibaioFile<>(fd, shards[shard]);
+   }
+
+   private int shardOf(int fd) throws IOException {
+      long key = routing == Routing.DEVICE ? LibaioContext.getDevice(fd) : fd;
+      return (Long.hashCode(key) & Integer.MAX_VALUE) % shards.length;
+   }
+
+   /**
+    * Closes every shard and waits for their pollers to finish.
+    */
+   @Override
+   public void close() {
+      if (closed.compareAndSet(false, true)) {
+         closeShards();
+         for (Thread poller : pollers) {
+            if (poller == null) {
+               continue;
+            }
+            try {
+               poller.join(10_000);
+            } catch (InterruptedException e) {
+               Thread.currentThread().interrupt();
+               return;
+            }
+         }
+      }
+   }
+
+   private void closeShards() {
+      for (LibaioContext<Callback> shard : shards) {
+         if (shard != null) {
+            shard.close();
+         }
+      }
+   }
+
+   private static final class Poller implements Runnable {
+
+      private final LibaioContext<?> context;
+
+      private final int cpu;
+
+      Poller(LibaioContext<?> context, int cpu) {
+         this.context = context;
+         this.cpu = cpu;
+      }
+
+      @Override
+      public void run() {
+         if (cpu >= 0) {
+            int error = LibaioContext.setThreadAffinity(cpu);
+            if (error != 0) {
+               logger.warn("Could not pin " + Thread.currentThread().getName() + " to cpu " + cpu + ": " + LibaioContext.strError(error));
+            }
+         } else if (context.getNumaNode() >= 0) {
+            int error = LibaioContext.bindToNumaNode(context.getNumaNode());
+            if (error != 0) {
+               logger.warn("Could not bind " + Thread.currentThread().getName() + " to NUMA node " + context.getNumaNode() + ": " + LibaioContext.strError(error));
+            }
+         }
+         context.poll();
+      }
+   }
+}
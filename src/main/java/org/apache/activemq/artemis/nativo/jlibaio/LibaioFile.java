@@ -29,6 +29,8 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
 
    private static final Logger logger = LoggerFactory.getLogger(LibaioFile.class);
 
+   private static final int DEFAULT_FILL_DEPTH = 4;
+
    protected boolean open;
    /**
     * This represents a structure allocated on the native
@@ -38,6 +40,16 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
 
    private int fd;
 
+   /**
+    * If the fd is on the fixed file table of the io_uring of ctx.
+    */
+   private boolean registered;
+
+   /**
+    * The in flight limit set on the native layer, 0 for none.
+    */
+   private int inFlightLimit;
+
    LibaioFile(int fd, LibaioContext ctx) {
       this.ctx = ctx;
       this.fd = fd;
@@ -47,13 +59,76 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
       return LibaioContext.getBlockSizeFD(fd);
    }
 
+   /**
+    * Asks the device for its sector sizes and its optimal I/O size, and the file system for the O_DIRECT alignments,
+    * where {@link #getBlockSize()} only has st_blksize. This works on files and on devices opened with
+    * {@link LibaioContext#openDevice(String, boolean)}.
+    *
+    * @return the alignments, see {@link BlockAlignment#getPreferredAlignment()}
+    * @throws IOException in case of error
+    */
+   public BlockAlignment getAlignment() throws IOException {
+      int[] alignment = new int[LibaioContext.ALIGNMENT_LENGTH];
+      LibaioContext.getAlignment(fd, alignment);
+      return new BlockAlignment(alignment);
+   }
+
    public boolean lock() {
       return LibaioContext.lock(fd);
    }
 
+   /**
+    * Registers this file on the io_uring of its context (IORING_REGISTER_FILES), so the kernel doesn't look up
+    * the file descriptor on every request. It is unregistered on {@link #close()}.
+    *
+    * @return false if the context is not using io_uring, or if the fd doesn't fit on the fixed file table
+    * @throws IOException if the kernel refuses the registration
+    */
+   public boolean register() throws IOException {
+      if (!registered && ctx != null) {
+         registered = ctx.registerFile(fd);
+      }
+      return registered;
+   }
+
+   /**
+    * Sets how many requests of this file can be in flight on its context, so a single file can't take the whole queue.
+    * A submit over the limit waits as configured by {@link LibaioContext#setAdmissionControl(int, long)}, and then
+    * fails with an IOException, or with {@link LibaioContext#SUBMIT_FILE_LIMIT} on {@link #tryWrite(long, int, ByteBuffer, SubmitInfo)}.
+    * <br>
+    * A batch takes a slot for each of its writes, and it is only submitted when all of them fit.
+    *
+    * @param limit the maximum number of requests in flight, 0 for no limit
+    * @return false if the fd of the file is too big to have a limit, or if the file has no context
+    * (from {@link LibaioContext#openControlFile(String, boolean)})
+    */
+   public boolean setInFlightLimit(int limit) {
+      if (limit < 0) {
+         throw new IllegalArgumentException("limit can't be negative");
+      }
+      if (ctx == null) {
+         return false;
+      }
+      boolean set = ctx.setFileLimit(fd, limit);
+      if (set) {
+         inFlightLimit = limit;
+      }
+      return set;
+   }
+
    @Override
    public void close() throws IOException {
       open = false;
+      if (registered) {
+         // before the fd number can be reused
+         ctx.unregisterFile(fd);
+         registered = false;
+      }
+      if (inFlightLimit > 0) {
+         // the next file with this fd starts with no limit
+         ctx.setFileLimit(fd, 0);
+         inFlightLimit = 0;
+      }
       LibaioContext.close(fd);
    }
 
@@ -79,7 +154,109 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
     * @throws java.io.IOException in case of error
     */
    public void write(long position, int size, ByteBuffer buffer, Callback callback) throws IOException {
-      ctx.submitWrite(fd, position, size, buffer, callback);
+      ctx.submitWrite(fd, position, size, buffer, callback, false);
+   }
+
+   /**
+    * Same as {@link #write(long, int, ByteBuffer, SubmitInfo)}, but a durable write will only be completed
+    * once the data is on stable storage, without a separate fdatasync.
+    * <br>
+    * It uses RWF_DSYNC (on devices with FUA support this becomes a single round trip). On kernels without RWF_DSYNC
+    * for aio the native layer falls back to a fdatasync of the file before releasing the completion.
+    *
+    * @param position The position on the file to write. Notice this has to be a multiple of 512.
+    * @param size     The size of the buffer to use while writing.
+    * @param buffer   if you are using O_DIRECT the buffer here needs to be allocated by {@link #newBuffer(int)}.
+    * @param callback A callback to be returned on the poll method.
+    * @param durable  if the write needs to be on stable storage before its completion.
+    * @throws java.io.IOException in case of error
+    */
+   public void write(long position, int size, ByteBuffer buffer, Callback callback, boolean durable) throws IOException {
+      ctx.submitWrite(fd, position, size, buffer, callback, durable);
+   }
+
+   /**
+    * Same as {@link #write(long, int, ByteBuffer, SubmitInfo)}, but it never throws: when the request can't be
+    * admitted it returns a status instead, and the caller can back off or try later.
+    * Nothing is submitted unless the status is {@link LibaioContext#SUBMIT_OK}, so the callback won't be called either.
+    *
+    * @return {@link LibaioContext#SUBMIT_OK}, {@link LibaioContext#SUBMIT_QUEUE_FULL}, {@link LibaioContext#SUBMIT_FILE_LIMIT},
+    * or the -errno of a failed submit
+    */
+   public int tryWrite(long position, int size, ByteBuffer buffer, Callback callback) {
+      return ctx.trySubmitWrite(fd, position, size, buffer, callback, false);
+   }
+
+   /**
+    * Same as {@link #tryWrite(long, int, ByteBuffer, SubmitInfo)}, durable as on {@link #write(long, int, ByteBuffer, SubmitInfo, boolean)}.
+    */
+   public int tryWrite(long position, int size, ByteBuffer buffer, Callback callback, boolean durable) {
+      return ctx.trySubmitWrite(fd, position, size, buffer, callback, durable);
+   }
+
+   /**
+    * It will submit a single gather write to the queue (IOCB_CMD_PWRITEV): the buffers are written one after the other
+    * starting at position, each one from its position to its limit, so a record made of a header and a body doesn't need
+    * to be copied into one buffer. The positions of the buffers are not changed.
+    * <br>
+    * With O_DIRECT every buffer needs to be aligned, on its address and its size.
+    *
+    * @param position The position on the file to write. Notice this has to be a multiple of 512.
+    * @param buffers  up to 3 buffers, if you are using O_DIRECT they need to be allocated by {@link #newBuffer(int)}.
+    * @param callback A callback to be returned on the poll method.
+    * @throws java.io.IOException in case of error
+    */
+   public void writev(long position, ByteBuffer[] buffers, Callback callback) throws IOException {
+      ctx.submitWritev(fd, position, buffers, callback, false);
+   }
+
+   /**
+    * Same as {@link #writev(long, ByteBuffer[], SubmitInfo)}, durable as on {@link #write(long, int, ByteBuffer, SubmitInfo, boolean)}.
+    */
+   public void writev(long position, ByteBuffer[] buffers, Callback callback, boolean durable) throws IOException {
+      ctx.submitWritev(fd, position, buffers, callback, durable);
+   }
+
+   /**
+    * It will submit a chain of writes with a barrier: the first barrier writes, then a fdatasync once they all completed,
+    * then the remaining writes once the fdatasync completed. The stages are submitted by the poller as the previous one
+    * completes, so a group of records, their sync and the commit records that depend on them take a single submit.
+    * <br>
+    * The callback is completed once, when the last stage is done, or with the first error of the chain, in which case
+    * the later stages are not submitted. Only the callback takes space on the queue, the other writes of the chain
+    * use the iocbs kept for fills, so the chains in flight at once are limited.
+    *
+    * @param positions the position on the file of each write
+    * @param buffers   up to {@link LibaioContext#MAX_CHAIN_WRITES} buffers, each one written from its position to its limit
+    * @param barrier   how many writes go before the fdatasync, from 0 to buffers.length
+    * @param callback  A callback to be returned on the poll method.
+    * @throws java.io.IOException in case of error
+    */
+   public void writeChain(long[] positions, ByteBuffer[] buffers, int barrier, Callback callback) throws IOException {
+      ctx.submitChain(fd, positions, buffers, barrier, callback);
+   }
+
+   /**
+    * It will submit count writes to the queue using a single io_submit.
+    * The element at index i of each array describes the i-th write, and each callback will be received on the
+    * {@link LibaioContext#poll(SubmitInfo[], int, int)} just like {@link #write(long, int, ByteBuffer, SubmitInfo)}.
+    * <br>
+    * In case the kernel only accepted part of the batch, the writes that were not submitted will have
+    * {@link SubmitInfo#onError(int, String)} called on their callbacks and they won't be returned by poll.
+    * <br>
+    * The batch goes through the admission control as a whole, with one submit for each write on its in flight limit,
+    * see {@link #setInFlightLimit(int)}.
+    *
+    * @param positions The positions on the file to write. Notice these have to be a multiple of 512.
+    * @param sizes     The sizes of the buffers to use while writing.
+    * @param buffers   if you are using O_DIRECT the buffers here need to be allocated by {@link #newBuffer(int)}.
+    * @param callbacks The callbacks to be returned on the poll method.
+    * @param count     The number of writes on the batch.
+    * @return the number of writes submitted.
+    * @throws java.io.IOException in case of error
+    */
+   public int writeBatch(long[] positions, int[] sizes, ByteBuffer[] buffers, Callback[] callbacks, int count) throws IOException {
+      return ctx.submitWriteBatch(fd, null, positions, sizes, buffers, callbacks, count);
    }
 
    /**
@@ -102,6 +279,94 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
       ctx.submitRead(fd, position, size, buffer, callback);
    }
 
+   /**
+    * Same as {@link #read(long, int, ByteBuffer, SubmitInfo)}, returning a status as {@link #tryWrite(long, int, ByteBuffer, SubmitInfo)} does.
+    */
+   public int tryRead(long position, int size, ByteBuffer buffer, Callback callback) {
+      return ctx.trySubmitRead(fd, position, size, buffer, callback);
+   }
+
+   /**
+    * It will create a reader streaming this file from the start, with depth reads of chunkSize in flight,
+    * for replays at the bandwidth of the device. See {@link LibaioSequentialReader}.
+    * <br>
+    * The reader has its own queue of depth requests, and it needs to be closed before this file.
+    *
+    * @param chunkSize the size of each read, a multiple of the {@link BlockAlignment#getPreferredAlignment()} of this file
+    * @param depth     how many reads are in flight
+    * @return the reader, it reads up to the current size of the file
+    * @throws IOException in case of error
+    */
+   public LibaioSequentialReader newSequentialReader(int chunkSize, int depth) throws IOException {
+      return new LibaioSequentialReader(fd, getSize(), chunkSize, depth, getAlignment().getPreferredAlignment());
+   }
+
+   /**
+    * Maps the first size bytes of this file, see {@link LibaioMappedFile}. The file is preallocated with
+    * {@link #fallocate(long)} if it is smaller than size, so the stores on the mapping never hit a hole.
+    * <br>
+    * This is meant for control files from {@link LibaioContext#openControlFile(String, boolean)}, opened without O_DIRECT,
+    * and for other small files such as headers. The aio path is still the one for bulk data.
+    * The mapping doesn't use the context of the file, so it works the same on files with no context.
+    *
+    * @param size the size of the mapping, up to 2GB
+    * @return the mapped file, it needs to be closed before this file
+    * @throws IOException in case of error
+    */
+   public LibaioMappedFile map(long size) throws IOException {
+      if (size <= 0 || size > Integer.MAX_VALUE) {
+         throw new IOException("Invalid size for a mapping: " + size);
+      }
+      if (getSize() < size) {
+         fallocate(size);
+      }
+      return new LibaioMappedFile(fd, LibaioContext.map(fd, size));
+   }
+
+   /**
+    * A synchronous write with pwrite, without going through the libaio queue.
+    * This is meant for small updates, like headers and control files, where an aio round trip is not worth it.
+    *
+    * @param position The position on the file to write. Notice this has to be a multiple of 512.
+    * @param size     The size of the buffer to use on the write.
+    * @param buffer   a native buffer allocated by {@link #newBuffer(int)}.
+    * @throws java.io.IOException in case of error
+    */
+   public void writeSync(long position, int size, ByteBuffer buffer) throws IOException {
+      LibaioContext.writeInternal(fd, position, size, buffer);
+   }
+
+   /**
+    * A synchronous gather write with pwritev: the buffers are written one after the other starting at position,
+    * each one from its position to its limit. The positions of the buffers are not changed.
+    *
+    * @param position The position on the file to write. Notice this has to be a multiple of 512.
+    * @param buffers  native buffers allocated by {@link #newBuffer(int)}.
+    * @throws java.io.IOException in case of error
+    */
+   public void writeSync(long position, ByteBuffer[] buffers) throws IOException {
+      int[] offsets = new int[buffers.length];
+      int[] sizes = new int[buffers.length];
+      for (int i = 0; i < buffers.length; i++) {
+         offsets[i] = buffers[i].position();
+         sizes[i] = buffers[i].remaining();
+      }
+      LibaioContext.writevInternal(fd, position, buffers, offsets, sizes);
+   }
+
+   /**
+    * It will submit a single scatter read to the queue (IOCB_CMD_PREADV), the counterpart of
+    * {@link #writev(long, ByteBuffer[], SubmitInfo)}: each buffer is read from its position to its limit.
+    *
+    * @param position The position on the file to read. Notice this has to be a multiple of 512.
+    * @param buffers  up to 3 buffers, if you are using O_DIRECT they need to be allocated by {@link #newBuffer(int)}.
+    * @param callback A callback to be returned on the poll method.
+    * @throws java.io.IOException in case of error
+    */
+   public void readv(long position, ByteBuffer[] buffers, Callback callback) throws IOException {
+      ctx.submitReadv(fd, position, buffers, callback);
+   }
+
    /**
     * It will allocate a buffer to be used on libaio operations.
     * Buffers here are allocated with posix_memalign.
@@ -130,6 +395,34 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
       }
    }
 
+   /**
+    * It will preallocate the file with a given size, without blocking the caller.
+    * <br>
+    * The file is written with zeros through the queue of the context, with up to depth writes of 1 MiB in flight.
+    * The callback is completed on the poll once the whole file is written, or with onError if any of the writes failed.
+    * The writes of the fill are not delivered on the poll and they don't take space from the queue, only the callback does.
+    * <br>
+    * With zeroRange everything but the last chunk is zeroed with fallocate(FALLOC_FL_ZERO_RANGE) if the file system supports it.
+    * That is faster, but the blocks are only allocated as unwritten extents, what could make the first writes to the file slower.
+    *
+    * @param alignment the alignment of the file
+    * @param size      number of bytes to be filled on the file
+    * @param depth     how many writes of the fill can be in flight at once
+    * @param zeroRange use fallocate(FALLOC_FL_ZERO_RANGE) when possible
+    * @param callback  completed once the file is filled
+    * @throws IOException in case of error
+    */
+   public void fill(int alignment, long size, int depth, boolean zeroRange, Callback callback) throws IOException {
+      ctx.submitFill(fd, alignment, size, depth, zeroRange, callback);
+   }
+
+   /**
+    * Same as {@link #fill(int, long, int, boolean, SubmitInfo)}, with 4 writes in flight and no fallocate.
+    */
+   public void fill(int alignment, long size, Callback callback) throws IOException {
+      fill(alignment, size, DEFAULT_FILL_DEPTH, false, callback);
+   }
+
    /**
     * It will use fallocate to initialize a file.
     *
@@ -139,4 +432,20 @@ public final class LibaioFile<Callback extends SubmitInfo> implements AutoClosea
       LibaioContext.fallocate(fd, size);
    }
 
+   /**
+    * It will call fallocate on a range of the file, without the fsync done by {@link #fallocate(long)} unless sync is set.
+    * <br>
+    * This can be used to recycle a file by punching or zeroing its content instead of writing it again.
+    *
+    * @param mode   0 to allocate the range, or any combination of {@link LibaioContext#FALLOCATE_KEEP_SIZE},
+    *               {@link LibaioContext#FALLOCATE_ZERO_RANGE} and {@link LibaioContext#FALLOCATE_PUNCH_HOLE}
+    * @param offset the start of the range
+    * @param length the length of the range
+    * @param sync   fdatasync the file once the range is done
+    * @throws IOException in case of error, e.g. the file system doesn't support the mode
+    */
+   public void fallocate(int mode, long offset, long length, boolean sync) throws IOException {
+      LibaioContext.fallocateRange(fd, mode, offset, length, sync);
+   }
+
 }
@@ -0,0 +1,134 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * A file mapped with MAP_SHARED, for small hot files such as control files and headers, where a record is a store on
+ * the mapping instead of a submit and a completion. Nothing crosses JNI to write: the records are put on views of
+ * {@link #getBuffer()}, and they are made durable by {@link #flush(long, long)}, or by {@link #commit()} for all the
+ * ranges marked with {@link #written(long, long)} since the previous commit, so a group of records takes a single msync.
+ * <br>
+ * The views can be written from several threads, marking and committing are synchronized.
+ * Use {@link LibaioFile#map(long)} to create one; it needs to be closed before its file.
+ */
+public final class LibaioMappedFile implements AutoCloseable {
+
+   private final int fd;
+
+   private final ByteBuffer mapping;
+
+   /**
+    * The range written since the last commit, empty when dirtyStart >= dirtyEnd.
+    */
+   private long dirtyStart = Long.MAX_VALUE;
+   private long dirtyEnd;
+
+   private boolean closed;
+
+   LibaioMappedFile(int fd, ByteBuffer mapping) {
+      this.fd = fd;
+      this.mapping = mapping;
+   }
+
+   /**
+    * @return the size of the mapping
+    */
+   public int getSize() {
+      return mapping.capacity();
+   }
+
+   /**
+    * @return a view of the whole mapping, with its own position and limit. It can't be used after {@link #close()}.
+    */
+   public ByteBuffer getBuffer() {
+      checkOpen();
+      return mapping.duplicate();
+   }
+
+   /**
+    * Marks a range to be flushed by the next {@link #commit()}. The ranges marked between commits are merged.
+    */
+   public synchronized void written(long position, long length) {
+      checkRange(position, length);
+      if (length == 0) {
+         return;
+      }
+      dirtyStart = Math.min(dirtyStart, position);
+      dirtyEnd = Math.max(dirtyEnd, position + length);
+   }
+
+   /**
+    * Flushes everything marked with {@link #written(long, long)} since the previous commit, with a single msync.
+    *
+    * @throws IOException in case of error, the range stays marked so the next commit retries it
+    */
+   public synchronized void commit() throws IOException {
+      checkOpen();
+      if (dirtyStart >= dirtyEnd) {
+         return;
+      }
+      LibaioContext.syncMapping(mapping, dirtyStart, dirtyEnd - dirtyStart);
+      dirtyStart = Long.MAX_VALUE;
+      dirtyEnd = 0;
+   }
+
+   /**
+    * Writes a range back to the file and waits for it to be durable (msync(MS_SYNC)).
+    */
+   public void flush(long position, long length) throws IOException {
+      checkOpen();
+      checkRange(position, length);
+      LibaioContext.syncMapping(mapping, position, length);
+   }
+
+   /**
+    * Starts the write back of a range without waiting for it (sync_file_range(SYNC_FILE_RANGE_WRITE)), so the
+    * flush or commit that follows has less to wait for. It doesn't make anything durable by itself.
+    */
+   public void startFlush(long position, long length) throws IOException {
+      checkOpen();
+      checkRange(position, length);
+      LibaioContext.syncFileRange(fd, position, length, false);
+   }
+
+   /**
+    * Unmaps the file, without flushing it: what was not flushed or committed is written back by the kernel eventually.
+    */
+   @Override
+   public synchronized void close() throws IOException {
+      if (!closed) {
+         closed = true;
+         LibaioContext.unmap(mapping);
+      }
+   }
+
+   private void checkRange(long position, long length) {
+      if (position < 0 || length < 0 || position + length > mapping.capacity()) {
+         throw new IndexOutOfBoundsException("range " + position + ", " + length + " is out of a mapping of " + mapping.capacity());
+      }
+   }
+
+   private void checkOpen() {
+      if (closed) {
+         throw new IllegalStateException("Mapped file is closed");
+      }
+   }
+}
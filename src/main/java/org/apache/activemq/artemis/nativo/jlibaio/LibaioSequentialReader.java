@@ -0,0 +1,202 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+/**
+ * Reads a file from start to end keeping depth aligned reads in flight, so a replay runs at the bandwidth of the device
+ * instead of at the latency of one read at a time.
+ * <br>
+ * The chunks are handed out in order by {@link #next()} from a ring of depth buffers: the buffer of a chunk is only
+ * valid until the following call to {@link #next()}, when it is reused to read ahead.
+ * <br>
+ * The reads go through a context owned by the reader and are reaped by the thread calling {@link #next()}, so the
+ * context of the file (and its poller) are not involved. A reader is not thread safe.
+ */
+public final class LibaioSequentialReader implements AutoCloseable {
+
+   private final LibaioContext<Chunk> context;
+   private final int fd;
+   private final int chunkSize;
+   private final long size;
+   private final Chunk[] ring;
+   private final Chunk[] completed;
+
+   /**
+    * The chunk with the lowest position, the next one to be handed out.
+    */
+   private int head;
+
+   /**
+    * The chunk handed out by the last {@link #next()}, to be resubmitted on the following one.
+    */
+   private Chunk current;
+
+   private long nextPosition;
+   private int inFlight;
+   private boolean closed;
+
+   /**
+    * A failed read ends the reader, every next() after it throws the same.
+    */
+   private IOException failure;
+
+   private static final class Chunk implements SubmitInfo {
+
+      final ByteBuffer buffer;
+      long position;
+      boolean done;
+      String errorMessage;
+
+      Chunk(ByteBuffer buffer) {
+         this.buffer = buffer;
+      }
+
+      @Override
+      public void onError(int errno, String message) {
+         this.errorMessage = message;
+         this.done = true;
+      }
+
+      @Override
+      public void done() {
+         this.done = true;
+      }
+   }
+
+   /**
+    * See {@link LibaioFile#newSequentialReader(int, int)}
+    */
+   LibaioSequentialReader(int fd, long size, int chunkSize, int depth, int alignment) throws IOException {
+      if (chunkSize <= 0 || chunkSize % alignment != 0) {
+         throw new IllegalArgumentException("chunkSize needs to be a multiple of " + alignment);
+      }
+      if (depth <= 0) {
+         throw new IllegalArgumentException("depth needs to be positive");
+      }
+      this.fd = fd;
+      this.size = size;
+      this.chunkSize = chunkSize;
+      this.context = new LibaioContext<>(depth, false, false);
+      this.ring = new Chunk[depth];
+      this.completed = new Chunk[depth];
+      try {
+         for (int i = 0; i < depth; i++) {
+            ring[i] = new Chunk(LibaioContext.newAlignedBuffer(chunkSize, alignment));
+         }
+         for (Chunk chunk : ring) {
+            if (!submit(chunk)) {
+               break;
+            }
+         }
+      } catch (IOException | RuntimeException e) {
+         close();
+         throw e;
+      }
+   }
+
+   /**
+    * @return the size of the file when the reader was created, it reads up to there
+    */
+   public long getSize() {
+      return size;
+   }
+
+   /**
+    * @return the position of the chunk handed out by the last {@link #next()}, or -1 before the first one
+    */
+   public long position() {
+      return current == null ? -1 : current.position;
+   }
+
+   /**
+    * It waits for the next chunk of the file, in order.
+    *
+    * @return a buffer from 0 to the size of the chunk (only the last one can be smaller than chunkSize),
+    * valid until the next call, or null once the whole file was read
+    * @throws IOException if the read of the chunk failed
+    */
+   public ByteBuffer next() throws IOException {
+      if (closed) {
+         throw new IOException("The reader is closed");
+      }
+      if (failure != null) {
+         throw failure;
+      }
+      if (current != null) {
+         // the caller is done with it, it reads ahead now
+         Chunk recycled = current;
+         current = null;
+         submit(recycled);
+      }
+      if (inFlight == 0) {
+         return null;
+      }
+
+      Chunk chunk = ring[head];
+      while (!chunk.done) {
+         inFlight -= context.poll(completed, 1, completed.length);
+      }
+      if (chunk.errorMessage != null) {
+         failure = new IOException("Error reading at " + chunk.position + ": " + chunk.errorMessage);
+         throw failure;
+      }
+      head = (head + 1) % ring.length;
+      current = chunk;
+      ByteBuffer buffer = chunk.buffer;
+      buffer.clear();
+      buffer.limit((int) Math.min(chunkSize, size - chunk.position));
+      return buffer;
+   }
+
+   private boolean submit(Chunk chunk) throws IOException {
+      if (nextPosition >= size) {
+         return false;
+      }
+      chunk.position = nextPosition;
+      chunk.done = false;
+      chunk.errorMessage = null;
+      // with O_DIRECT the last read asks for the whole chunk, the kernel stops at the end of the file
+      context.submitRead(fd, nextPosition, chunkSize, chunk.buffer, chunk);
+      nextPosition += chunkSize;
+      inFlight++;
+      return true;
+   }
+
+   /**
+    * It waits for the reads still in flight and releases the buffers, but it doesn't close the file.
+    */
+   @Override
+   public void close() {
+      if (closed) {
+         return;
+      }
+      closed = true;
+      while (inFlight > 0) {
+         inFlight -= context.poll(completed, 1, completed.length);
+      }
+      context.close();
+      for (Chunk chunk : ring) {
+         if (chunk != null) {
+            LibaioContext.freeBuffer(chunk.buffer);
+         }
+      }
+   }
+}
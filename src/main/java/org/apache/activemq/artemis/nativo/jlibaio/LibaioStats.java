@@ -0,0 +1,178 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio;
+
+import java.util.Arrays;
+
+/**
+ * A snapshot of the stats of a {@link LibaioContext}, taken with {@link LibaioContext#getStats()}.
+ * <br>
+ * The latencies are from submit to completion, in nanoseconds, on log-linear histograms:
+ * 4 buckets per power of 2, so a latency is within 25% of the lower bound of its bucket.
+ * Syncs and fill writes are accounted as writes.
+ * <br>
+ * The counters only grow, what is what monitoring systems such as Prometheus expect.
+ */
+public final class LibaioStats {
+
+   private final long[] values;
+
+   LibaioStats(long[] values) {
+      this.values = values;
+   }
+
+   /**
+    * @return the number of buckets of each histogram
+    */
+   public static int getBuckets() {
+      return LibaioContext.STATS_BUCKETS;
+   }
+
+   /**
+    * @return the smallest latency in nanoseconds that goes to bucket, the last bucket also takes all the bigger ones.
+    */
+   public static long bucketLowerBound(int bucket) {
+      if (bucket < 0 || bucket >= LibaioContext.STATS_BUCKETS) {
+         throw new IndexOutOfBoundsException("bucket " + bucket);
+      }
+      if (bucket < 4) {
+         return bucket;
+      }
+      int exponent = bucket / 4 + 1;
+      return (4L + bucket % 4) << (exponent - 2);
+   }
+
+   public long getReads() {
+      return values[LibaioContext.STATS_READS];
+   }
+
+   public long getWrites() {
+      return values[LibaioContext.STATS_WRITES];
+   }
+
+   /**
+    * @return the sum of the latencies of all the reads, in nanoseconds
+    */
+   public long getReadNanos() {
+      return values[LibaioContext.STATS_READ_NANOS];
+   }
+
+   /**
+    * @return the sum of the latencies of all the writes, in nanoseconds
+    */
+   public long getWriteNanos() {
+      return values[LibaioContext.STATS_WRITE_NANOS];
+   }
+
+   public long getInFlightReads() {
+      return values[LibaioContext.STATS_IN_FLIGHT_READS];
+   }
+
+   public long getInFlightWrites() {
+      return values[LibaioContext.STATS_IN_FLIGHT_WRITES];
+   }
+
+   /**
+    * @return the highest number of reads and writes in flight at the same time
+    */
+   public long getMaxInFlight() {
+      return values[LibaioContext.STATS_MAX_IN_FLIGHT];
+   }
+
+   /**
+    * @return how many times the completions were reaped on user space, from the completion ring
+    */
+   public long getRingReaps() {
+      return values[LibaioContext.STATS_RING_REAPS];
+   }
+
+   /**
+    * @return how many times reaping the completions needed a system call
+    */
+   public long getSyscallReaps() {
+      return values[LibaioContext.STATS_SYSCALL_REAPS];
+   }
+
+   /**
+    * @return how many submits were refused by the kernel with EAGAIN
+    */
+   public long getSubmitEagain() {
+      return values[LibaioContext.STATS_SUBMIT_EAGAIN];
+   }
+
+   /**
+    * @return the count of reads of each bucket, see {@link #bucketLowerBound(int)}
+    */
+   public long[] getReadHistogram() {
+      return Arrays.copyOfRange(values, LibaioContext.STATS_READ_HISTOGRAM, LibaioContext.STATS_READ_HISTOGRAM + LibaioContext.STATS_BUCKETS);
+   }
+
+   /**
+    * @return the count of writes of each bucket, see {@link #bucketLowerBound(int)}
+    */
+   public long[] getWriteHistogram() {
+      return Arrays.copyOfRange(values, LibaioContext.STATS_WRITE_HISTOGRAM, LibaioContext.STATS_WRITE_HISTOGRAM + LibaioContext.STATS_BUCKETS);
+   }
+
+   /**
+    * @param percentile between 0 and 100
+    * @return the lower bound of the bucket of the read latency at percentile, or 0 if there were no reads
+    */
+   public long getReadPercentile(double percentile) {
+      return percentile(LibaioContext.STATS_READ_HISTOGRAM, percentile);
+   }
+
+   /**
+    * @param percentile between 0 and 100
+    * @return the lower bound of the bucket of the write latency at percentile, or 0 if there were no writes
+    */
+   public long getWritePercentile(double percentile) {
+      return percentile(LibaioContext.STATS_WRITE_HISTOGRAM, percentile);
+   }
+
+   private long percentile(int histogram, double percentile) {
+      if (percentile < 0 || percentile > 100) {
+         throw new IllegalArgumentException("percentile needs to be between 0 and 100");
+      }
+      long total = 0;
+      for (int i = 0; i < LibaioContext.STATS_BUCKETS; i++) {
+         total += values[histogram + i];
+      }
+      if (total == 0) {
+         return 0;
+      }
+      long rank = Math.max(1, (long) Math.ceil(total * percentile / 100));
+      long count = 0;
+      for (int i = 0; i < LibaioContext.STATS_BUCKETS; i++) {
+         count += values[histogram + i];
+         if (count >= rank) {
+            return bucketLowerBound(i);
+         }
+      }
+      return bucketLowerBound(LibaioContext.STATS_BUCKETS - 1);
+   }
+
+   @Override
+   public String toString() {
+      return "LibaioStats{reads=" + getReads() + ", writes=" + getWrites() +
+         ", inFlightReads=" + getInFlightReads() + ", inFlightWrites=" + getInFlightWrites() +
+         ", maxInFlight=" + getMaxInFlight() + ", ringReaps=" + getRingReaps() +
+         ", syscallReaps=" + getSyscallReaps() + ", submitEagain=" + getSubmitEagain() +
+         ", writeP50=" + getWritePercentile(50) + ", writeP99=" + getWritePercentile(99) + "}";
+   }
+}
@@ -0,0 +1,137 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.util;
+
+import java.util.concurrent.atomic.AtomicIntegerArray;
+import java.util.concurrent.atomic.AtomicLong;
+
+import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
+
+/**
+ * An index addressed table of callbacks.
+ * <br>
+ * A callback is registered before a submit, and only its slot id is passed to the native layer.
+ * When the native layer reports a completion by slot id the callback is released from here.
+ * This way the native layer doesn't need to hold JNI references towards the callbacks.
+ * <br>
+ * It is lock free: the ids that are not in use are on a stack whose top is changed with a compare and set,
+ * so the submitters and the poller never wait on each other.
+ */
+public class CallbackSlots<Callback extends SubmitInfo> {
+
+   private static final int FREE = 0;
+   private static final int IN_USE = 1;
+
+   private final SubmitInfo[] callbacks;
+
+   // FREE or IN_USE for every slot, a release of a slot that is not in use is refused
+   private final AtomicIntegerArray states;
+
+   // the stack of the ids that are not in use: next[slot] is the id below slot, -1 at the bottom
+   private final int[] next;
+
+   // the id on top of the stack + 1 (0 when it is empty) on the low 32 bits, and a version on the high 32 bits,
+   // changed on every push and pop so a stale top can't be set back (ABA)
+   private final AtomicLong top;
+
+   private final int size;
+
+   public CallbackSlots(int size) {
+      this.callbacks = new SubmitInfo[size];
+      this.states = new AtomicIntegerArray(size);
+      this.next = new int[size];
+      this.size = size;
+      for (int i = 0; i < size; i++) {
+         next[i] = i + 1 < size ? i + 1 : -1;
+      }
+      this.top = new AtomicLong(size > 0 ? 1 : 0);
+   }
+
+   /**
+    * @param callback the callback to hold, it could be null
+    * @return the slot id for the callback, or -1 if there are no slots available
+    */
+   public int register(Callback callback) {
+      int slot = pop();
+      if (slot >= 0) {
+         callbacks[slot] = callback;
+         // publishes the callback to the thread that will release the slot
+         states.set(slot, IN_USE);
+      }
+      return slot;
+   }
+
+   /**
+    * @param slot a slot id returned by {@link #register(SubmitInfo)}
+    * @return the callback that was registered at slot, the slot will be available for new registrations
+    * @throws IllegalStateException if the slot is not in use
+    */
+   public Callback release(int slot) {
+      if (!states.compareAndSet(slot, IN_USE, FREE)) {
+         throw new IllegalStateException("Slot " + slot + " is not in use");
+      }
+      Callback callback = (Callback) callbacks[slot];
+      callbacks[slot] = null;
+      push(slot);
+      return callback;
+   }
+
+   /**
+    * It counts the slots one by one, it is meant for checks and not for every submit.
+    *
+    * @return the number of slots in use
+    */
+   public int used() {
+      int used = 0;
+      for (int i = 0; i < size; i++) {
+         if (states.get(i) == IN_USE) {
+            used++;
+         }
+      }
+      return used;
+   }
+
+   private int pop() {
+      while (true) {
+         long current = top.get();
+         int slot = (int) current - 1;
+         if (slot < 0) {
+            return -1;
+         }
+         // a stale next only makes the compare and set fail, as the version changed
+         long below = next[slot] + 1;
+         if (top.compareAndSet(current, version(current) | below)) {
+            return slot;
+         }
+      }
+   }
+
+   private void push(int slot) {
+      while (true) {
+         long current = top.get();
+         next[slot] = (int) current - 1;
+         if (top.compareAndSet(current, version(current) | (slot + 1))) {
+            return;
+         }
+      }
+   }
+
+   private static long version(long current) {
+      return ((current >>> 32) + 1) << 32;
+   }
+}
@@ -0,0 +1,138 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.test;
+
+import java.util.HashSet;
+import java.util.concurrent.atomic.AtomicInteger;
+
+import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
+import org.apache.activemq.artemis.nativo.jlibaio.util.CallbackSlots;
+import org.junit.Assert;
+import org.junit.Test;
+
+public class CallbackSlotsTest {
+
+   @Test
+   public void testRegisterAndRelease() {
+      CallbackSlots<MyInfo> slots = new CallbackSlots<>(100);
+
+      MyInfo[] infos = new MyInfo[100];
+      int[] ids = new int[100];
+      HashSet<Integer> uniqueIds = new HashSet<>();
+
+      for (int i = 0; i < 100; i++) {
+         infos[i] = new MyInfo();
+         ids[i] = slots.register(infos[i]);
+         Assert.assertTrue(ids[i] >= 0 && ids[i] < 100);
+         uniqueIds.add(ids[i]);
+      }
+
+      Assert.assertEquals(100, uniqueIds.size());
+      Assert.assertEquals(100, slots.used());
+
+      // it is full
+      Assert.assertEquals(-1, slots.register(new MyInfo()));
+
+      // releasing out of order
+      for (int i = 99; i >= 0; i -= 2) {
+         Assert.assertSame(infos[i], slots.release(ids[i]));
+      }
+
+      Assert.assertEquals(50, slots.used());
+
+      // the released slots are reused
+      for (int i = 0; i < 50; i++) {
+         Assert.assertNotEquals(-1, slots.register(new MyInfo()));
+      }
+
+      Assert.assertEquals(-1, slots.register(new MyInfo()));
+      Assert.assertEquals(100, slots.used());
+   }
+
+   @Test
+   public void testNullCallback() {
+      CallbackSlots<MyInfo> slots = new CallbackSlots<>(1);
+
+      int id = slots.register(null);
+      Assert.assertEquals(0, id);
+      Assert.assertNull(slots.release(id));
+      Assert.assertEquals(0, slots.used());
+   }
+
+   @Test
+   public void testReleaseNotInUse() {
+      CallbackSlots<MyInfo> slots = new CallbackSlots<>(2);
+
+      int id = slots.register(new MyInfo());
+      slots.release(id);
+      try {
+         slots.release(id);
+         Assert.fail("the slot was already released");
+      } catch (IllegalStateException expected) {
+      }
+
+      // the double release didn't hand out the slot twice
+      HashSet<Integer> uniqueIds = new HashSet<>();
+      uniqueIds.add(slots.register(new MyInfo()));
+      uniqueIds.add(slots.register(new MyInfo()));
+      Assert.assertEquals(2, uniqueIds.size());
+      Assert.assertEquals(-1, slots.register(new MyInfo()));
+   }
+
+   @Test
+   public void testConcurrentRegisterAndRelease() throws Exception {
+      CallbackSlots<MyInfo> slots = new CallbackSlots<>(16);
+      AtomicInteger failures = new AtomicInteger();
+      Thread[] threads = new Thread[4];
+
+      for (int t = 0; t < threads.length; t++) {
+         threads[t] = new Thread(() -> {
+            MyInfo info = new MyInfo();
+            for (int i = 0; i < 100_000; i++) {
+               int id = slots.register(info);
+               try {
+                  // 4 threads holding one slot each can't run out of 16, and a slot given twice returns the other callback
+                  if (id < 0 || slots.release(id) != info) {
+                     failures.incrementAndGet();
+                  }
+               } catch (IllegalStateException e) {
+                  failures.incrementAndGet();
+               }
+            }
+         });
+         threads[t].start();
+      }
+      for (Thread thread : threads) {
+         thread.join();
+      }
+
+      Assert.assertEquals(0, failures.get());
+      Assert.assertEquals(0, slots.used());
+   }
+
+   static class MyInfo implements SubmitInfo {
+
+      @Override
+      public void onError(int errno, String message) {
+      }
+
+      @Override
+      public void done() {
+      }
+   }
+}
@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements. See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package org.apache.activemq.artemis.nativo.jlibaio.test;
+
+import java.io.File;
+import java.nio.ByteBuffer;
+import java.util.HashSet;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicInteger;
+
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioContext;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioEngine;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioFile;
+import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
+import org.junit.Assert;
+import org.junit.Assume;
+import org.junit.BeforeClass;
+import org.junit.Rule;
+import org.junit.Test;
+import org.junit.rules.TemporaryFolder;
+
+public class LibaioEngineTest {
+
+   @BeforeClass
+   public static void testAIO() {
+      Assume.assumeTrue(LibaioContext.isLoaded());
+   }
+
+   @Rule
+   public TemporaryFolder folder;
+
+   public LibaioEngineTest() {
+      folder = new TemporaryFolder(new File("./target"));
+   }
+
+   @Test
+   public void testShardedWrites() throws Exception {
+      testShardedWrites(LibaioEngine.Routing.FD, null);
+   }
+
+   @Test
+   public void testShardedWritesByDevicePinned() throws Exception {
+      testShardedWrites(LibaioEngine.Routing.DEVICE, new int[]{0});
+   }
+
+   @Test
+   public void testShardedWritesOnNumaNode() throws Exception {
+      // node 0 is there even without NUMA support
+      testShardedWrites(LibaioEngine.Routing.FD, null, new int[]{0});
+   }
+
+   private void testShardedWrites(LibaioEngine.Routing routing, int[] cpus) throws Exception {
+      testShardedWrites(routing, cpus, null);
+   }
+
+   private void testShardedWrites(LibaioEngine.Routing routing, int[] cpus, int[] numaNodes) throws Exception {
+      final int files = 8;
+      final int writes = 100;
+
+      ByteBuffer buffer = numaNodes == null ? LibaioContext.newAlignedBuffer(4096, 4096) : LibaioContext.newAlignedBuffer(4096, 4096, numaNodes[0]);
+      LibaioEngine<SubmitInfo> engine = new LibaioEngine<>(4, 50, true, false, routing, cpus, numaNodes);
+      LibaioFile[] openFiles = new LibaioFile[files];
+      try {
+         Assert.assertEquals(4 * 50, engine.getTotalMaxIO());
+         if (numaNodes != null) {
+            Assert.assertEquals(numaNodes[0], engine.getShard(0).getNumaNode());
+         }
+
+         final CountDownLatch latch = new CountDownLatch(files * writes);
+         final AtomicInteger errors = new AtomicInteger();
+         final HashSet<String> pollers = new HashSet<>();
+
+         SubmitInfo callback = new SubmitInfo() {
+            @Override
+            public void onError(int errno, String message) {
+               errors.incrementAndGet();
+            }
+
+            @Override
+            public void done() {
+               synchronized (pollers) {
+                  pollers.add(Thread.currentThread().getName());
+               }
+               latch.countDown();
+            }
+         };
+
+         for (int i = 0; i < files; i++) {
+            openFiles[i] = engine.openFile(folder.newFile(), true);
+         }
+
+         for (int i = 0; i < writes; i++) {
+            for (LibaioFile file : openFiles) {
+               file.write(i * 4096, 4096, buffer, callback);
+            }
+         }
+
+         Assert.assertTrue(latch.await(10, TimeUnit.SECONDS));
+         Assert.assertEquals(0, errors.get());
+
+         synchronized (pollers) {
+            for (String poller : pollers) {
+               Assert.assertTrue(poller, poller.startsWith("libaio-poller-"));
+            }
+            if (routing == LibaioEngine.Routing.DEVICE) {
+               // the files are all on the same device
+               Assert.assertEquals(1, pollers.size());
+            }
+         }
+      } finally {
+         for (LibaioFile file : openFiles) {
+            if (file != null) {
+               file.close();
+            }
+         }
+         engine.close();
+         LibaioContext.freeBuffer(buffer);
+      }
+   }
+}
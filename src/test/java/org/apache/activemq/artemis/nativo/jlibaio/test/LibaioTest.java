@@ -23,11 +23,20 @@ import java.io.IOException;
 import java.lang.ref.Cleaner;
 import java.lang.ref.WeakReference;
 import java.nio.ByteBuffer;
+import java.nio.file.Files;
+import java.util.HashSet;
 import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.TimeUnit;
 import java.util.concurrent.atomic.AtomicInteger;
+import java.util.stream.LongStream;
 
+import org.apache.activemq.artemis.nativo.jlibaio.AlignedBufferPool;
+import org.apache.activemq.artemis.nativo.jlibaio.BlockAlignment;
 import org.apache.activemq.artemis.nativo.jlibaio.LibaioContext;
 import org.apache.activemq.artemis.nativo.jlibaio.LibaioFile;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioMappedFile;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioSequentialReader;
+import org.apache.activemq.artemis.nativo.jlibaio.LibaioStats;
 import org.apache.activemq.artemis.nativo.jlibaio.SubmitInfo;
 import org.junit.After;
 import org.junit.Assert;
@@ -151,6 +160,83 @@ public class LibaioTest {
       LibaioContext.freeBuffer(buffer);
    }
 
+   @Test
+   public void testAsyncFill() throws Exception {
+      testAsyncFill(10 * 1024 * 1024 + 100 * 1024, false);
+   }
+
+   @Test
+   public void testAsyncFillZeroRange() throws Exception {
+      testAsyncFill(10 * 1024 * 1024 + 100 * 1024, true);
+   }
+
+   private void testAsyncFill(int size, boolean zeroRange) throws Exception {
+      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = fileDescriptor.newBuffer(size);
+      try {
+         TestInfo fillCallback = new TestInfo();
+         fileDescriptor.fill(fileDescriptor.getBlockSize(), size, 4, zeroRange, fillCallback);
+
+         // only the callback of the fill is delivered
+         TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(fillCallback, callbacks[0]);
+         Assert.assertFalse(fillCallback.error);
+         Assert.assertEquals(size, fileDescriptor.getSize());
+
+         fileDescriptor.read(0, size, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+         for (int i = 0; i < size; i++) {
+            Assert.assertEquals(0, buffer.get());
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testFallocateModes() throws Exception {
+      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096 * 3, 4096);
+      TestInfo[] callbacks = new TestInfo[1];
+      try {
+         fileDescriptor.fallocate(0, 0, 4096 * 3, false);
+         Assert.assertEquals(4096 * 3, fileDescriptor.getSize());
+
+         // beyond the end of the file without changing its size
+         fileDescriptor.fallocate(LibaioContext.FALLOCATE_KEEP_SIZE, 4096 * 3, 4096, true);
+         Assert.assertEquals(4096 * 3, fileDescriptor.getSize());
+
+         for (int i = 0; i < 4096 * 3; i++) {
+            buffer.put(i, (byte) 'a');
+         }
+         fileDescriptor.write(0, 4096 * 3, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+
+         fileDescriptor.fallocate(LibaioContext.FALLOCATE_PUNCH_HOLE, 4096, 4096, false);
+         Assert.assertEquals(4096 * 3, fileDescriptor.getSize());
+
+         boolean zeroRange = true;
+         try {
+            fileDescriptor.fallocate(LibaioContext.FALLOCATE_ZERO_RANGE, 4096 * 2, 4096, false);
+         } catch (IOException e) {
+            // not every file system supports it
+            zeroRange = false;
+         }
+
+         fileDescriptor.read(0, 4096 * 3, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+         for (int i = 0; i < 4096 * 3; i++) {
+            byte expected = i < 4096 || (i >= 4096 * 2 && !zeroRange) ? (byte) 'a' : 0;
+            Assert.assertEquals(expected, buffer.get(i));
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
    @Test
    public void testInitAndFallocate10K() throws Exception {
       testInit(10 * 4096);
@@ -183,93 +269,1072 @@ public class LibaioTest {
       ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
 
       try {
-         for (int i = 0; i < 4096; i++) {
-            buffer.put((byte) 'a');
-         }
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'a');
+         }
+
+         TestInfo callback = new TestInfo();
+         TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+
+         for (int i = 0; i < LIBAIO_QUEUE_SIZE / 2; i++) {
+            for (LibaioFile file : fileDescriptor) {
+               file.write(i * 4096, 4096, buffer, callback);
+            }
+         }
+
+         Assert.assertEquals(LIBAIO_QUEUE_SIZE, control.poll(callbacks, LIBAIO_QUEUE_SIZE, LIBAIO_QUEUE_SIZE));
+
+         for (Object returnedCallback : callbacks) {
+            Assert.assertSame(returnedCallback, callback);
+         }
+
+         for (LibaioFile file : fileDescriptor) {
+            ByteBuffer bigbuffer = LibaioContext.newAlignedBuffer(4096 * 25, 4096);
+            file.read(0, 4096 * 25, bigbuffer, callback);
+            Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+            for (Object returnedCallback : callbacks) {
+               Assert.assertSame(returnedCallback, callback);
+            }
+
+            for (int i = 0; i < 4096 * 25; i++) {
+               Assert.assertEquals((byte) 'a', bigbuffer.get());
+            }
+
+            LibaioContext.freeBuffer(bigbuffer);
+
+            file.close();
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+      }
+   }
+
+   @Test
+   public void testSubmitWriteAndRead() throws Exception {
+      TestInfo callback = new TestInfo();
+
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+
+      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+
+      // ByteBuffer buffer = ByteBuffer.allocateDirect(4096);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+      try {
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'a');
+         }
+
+         buffer.rewind();
+
+         fileDescriptor.write(0, 4096, buffer, callback);
+
+         int retValue = control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE);
+         Assert.assertEquals(1, retValue);
+
+         Assert.assertSame(callback, callbacks[0]);
+
+         LibaioContext.freeBuffer(buffer);
+
+         buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'B');
+         }
+
+         fileDescriptor.write(0, 4096, buffer, null);
+
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+         buffer.rewind();
+
+         fileDescriptor.read(0, 4096, buffer, null);
+
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals('B', buffer.get());
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testAlignedBufferPool() throws Exception {
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+
+      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+
+      try (AlignedBufferPool pool = LibaioContext.newAlignedBufferPool(4096, false, true)) {
+         ByteBuffer buffer = pool.acquire(4096);
+         Assert.assertEquals(4096, buffer.capacity());
+         Assert.assertEquals(4096, pool.getOutstandingBytes());
+         // the rest of the slab went to the pool
+         Assert.assertEquals(pool.getReservedBytes() - 4096, pool.getPooledBytes());
+
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals(0, buffer.get(i));
+            buffer.put(i, (byte) 'a');
+         }
+
+         fileDescriptor.write(0, 4096, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+         long reserved = pool.getReservedBytes();
+         pool.release(buffer);
+         Assert.assertEquals(0, pool.getOutstandingBytes());
+         Assert.assertEquals(reserved, pool.getPooledBytes());
+
+         // a recycled buffer is zeroed again, and it doesn't reserve more memory
+         buffer = pool.acquire(4096);
+         Assert.assertEquals(reserved, pool.getReservedBytes());
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals(0, buffer.get(i));
+         }
+
+         fileDescriptor.read(0, 4096, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals('a', buffer.get(i));
+         }
+
+         // a different size class
+         ByteBuffer bigBuffer = pool.acquire(4096 * 3);
+         Assert.assertEquals(4096 * 3, bigBuffer.capacity());
+         Assert.assertEquals(4096 + 4096 * 4, pool.getOutstandingBytes());
+
+         pool.release(bigBuffer);
+         pool.release(buffer);
+         Assert.assertEquals(0, pool.getOutstandingBytes());
+         Assert.assertEquals(pool.getReservedBytes(), pool.getPooledBytes());
+
+         // released twice, or never acquired from the pool
+         try {
+            pool.release(buffer);
+            Assert.fail("Exception expected");
+         } catch (RuntimeException expected) {
+         }
+         ByteBuffer otherBuffer = LibaioContext.newAlignedBuffer(4096, 4096);
+         try {
+            pool.release(otherBuffer);
+            Assert.fail("Exception expected");
+         } catch (RuntimeException expected) {
+         } finally {
+            LibaioContext.freeBuffer(otherBuffer);
+         }
+         Assert.assertEquals(pool.getReservedBytes(), pool.getPooledBytes());
+
+         try {
+            pool.acquire(100);
+            Assert.fail("Exception expected");
+         } catch (RuntimeException expected) {
+         }
+      } finally {
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testWritevAndReadv() throws Exception {
+      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer header = LibaioContext.newAlignedBuffer(4096, 4096);
+      ByteBuffer body = LibaioContext.newAlignedBuffer(4096 * 2, 4096);
+      TestInfo[] callbacks = new TestInfo[1];
+      try {
+         for (int i = 0; i < 4096; i++) {
+            header.put(i, (byte) 'h');
+         }
+         for (int i = 0; i < 4096 * 2; i++) {
+            body.put(i, (byte) 'b');
+         }
+
+         TestInfo callback = new TestInfo();
+         fileDescriptor.writev(0, new ByteBuffer[]{header, body}, callback);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+         Assert.assertSame(callback, callbacks[0]);
+         Assert.assertFalse(callback.error);
+         Assert.assertEquals(4096 * 3, fileDescriptor.getSize());
+
+         LibaioContext.memsetBuffer(header, 4096);
+         LibaioContext.memsetBuffer(body, 4096 * 2);
+
+         // the body is read first this time
+         fileDescriptor.readv(0, new ByteBuffer[]{body, header}, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+         for (int i = 0; i < 4096 * 2; i++) {
+            Assert.assertEquals(i < 4096 ? 'h' : 'b', body.get(i));
+         }
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals('b', header.get(i));
+         }
+
+         try {
+            fileDescriptor.writev(0, new ByteBuffer[]{header, header, header, header}, null);
+            Assert.fail("Exception expected");
+         } catch (IOException expected) {
+         }
+      } finally {
+         LibaioContext.freeBuffer(header);
+         LibaioContext.freeBuffer(body);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testWriteSync() throws Exception {
+      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer header = LibaioContext.newAlignedBuffer(4096, 4096);
+      ByteBuffer body = LibaioContext.newAlignedBuffer(4096 * 2, 4096);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096 * 3, 4096);
+      TestInfo[] callbacks = new TestInfo[1];
+      try {
+         for (int i = 0; i < 4096; i++) {
+            header.put(i, (byte) 'h');
+         }
+         for (int i = 0; i < 4096 * 2; i++) {
+            body.put(i, (byte) 'b');
+         }
+
+         fileDescriptor.writeSync(0, 4096, header);
+         fileDescriptor.read(0, 4096, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals('h', buffer.get(i));
+         }
+
+         // only the second half of the body
+         body.position(4096);
+         fileDescriptor.writeSync(4096, new ByteBuffer[]{header, body});
+         Assert.assertEquals(4096, body.position());
+         Assert.assertEquals(4096 * 3, fileDescriptor.getSize());
+
+         fileDescriptor.read(0, 4096 * 3, buffer, null);
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+         for (int i = 0; i < 4096 * 3; i++) {
+            Assert.assertEquals(i < 4096 * 2 ? 'h' : 'b', buffer.get(i));
+         }
+      } finally {
+         LibaioContext.freeBuffer(header);
+         LibaioContext.freeBuffer(body);
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   /**
+    * This file is making use of libaio without O_DIRECT
+    * We won't need special buffers on this case.
+    */ public void testSubmitWriteAndReadRegularBuffers() throws Exception {
+      TestInfo callback = new TestInfo();
+
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+
+      File file = temporaryFolder.newFile("test.bin");
+
+      fillupFile(file, LIBAIO_QUEUE_SIZE);
+
+      LibaioFile fileDescriptor = control.openFile(file, false);
+
+      final int BUFFER_SIZE = 50;
+
+      ByteBuffer buffer = ByteBuffer.allocateDirect(BUFFER_SIZE);
+
+      try {
+         for (int i = 0; i < BUFFER_SIZE; i++) {
+            buffer.put((byte) 'a');
+         }
+
+         buffer.rewind();
+
+         fileDescriptor.write(0, BUFFER_SIZE, buffer, callback);
+
+         int retValue = control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE);
+         logger.debug("Return from poll::" + retValue);
+         Assert.assertEquals(1, retValue);
+
+         Assert.assertSame(callback, callbacks[0]);
+
+         buffer.rewind();
+
+         for (int i = 0; i < BUFFER_SIZE; i++) {
+            buffer.put((byte) 'B');
+         }
+
+         fileDescriptor.write(0, BUFFER_SIZE, buffer, null);
+
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+         buffer.rewind();
+
+         fileDescriptor.read(0, 50, buffer, null);
+
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+         for (int i = 0; i < BUFFER_SIZE; i++) {
+            Assert.assertEquals('B', buffer.get());
+         }
+      } finally {
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testSubmitWriteBatch() throws Exception {
+      File file = temporaryFolder.newFile("test.bin");
+
+      fillupFile(file, LIBAIO_QUEUE_SIZE);
+
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(file, true);
+
+      final int BATCH_SIZE = LIBAIO_QUEUE_SIZE / 2;
+
+      long[] positions = new long[BATCH_SIZE];
+      int[] sizes = new int[BATCH_SIZE];
+      ByteBuffer[] buffers = new ByteBuffer[BATCH_SIZE];
+      TestInfo[] batchCallbacks = new TestInfo[BATCH_SIZE];
+
+      for (int i = 0; i < BATCH_SIZE; i++) {
+         positions[i] = i * 4096;
+         sizes[i] = 4096;
+         buffers[i] = LibaioContext.newAlignedBuffer(4096, 4096);
+         for (int j = 0; j < 4096; j++) {
+            buffers[i].put((byte) ('a' + (i % 20)));
+         }
+         batchCallbacks[i] = new TestInfo();
+      }
+
+      ByteBuffer bigbuffer = LibaioContext.newAlignedBuffer(4096 * BATCH_SIZE, 4096);
+
+      try {
+         Assert.assertEquals(BATCH_SIZE, fileDescriptor.writeBatch(positions, sizes, buffers, batchCallbacks, BATCH_SIZE));
+
+         TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+         Assert.assertEquals(BATCH_SIZE, control.poll(callbacks, BATCH_SIZE, LIBAIO_QUEUE_SIZE));
+
+         for (int i = 0; i < BATCH_SIZE; i++) {
+            Assert.assertFalse(callbacks[i].isError());
+         }
+
+         fileDescriptor.read(0, 4096 * BATCH_SIZE, bigbuffer, new TestInfo());
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+
+         for (int i = 0; i < BATCH_SIZE; i++) {
+            for (int j = 0; j < 4096; j++) {
+               Assert.assertEquals((byte) ('a' + (i % 20)), bigbuffer.get());
+            }
+         }
+
+         boolean exceptionThrown = false;
+         try {
+            // the batch is all or nothing, there is no space for this many iocbs
+            fileDescriptor.writeBatch(new long[LIBAIO_QUEUE_SIZE + 1], new int[LIBAIO_QUEUE_SIZE + 1],
+                                      new ByteBuffer[LIBAIO_QUEUE_SIZE + 1], new TestInfo[LIBAIO_QUEUE_SIZE + 1], LIBAIO_QUEUE_SIZE + 1);
+         } catch (IOException expected) {
+            exceptionThrown = true;
+         }
+
+         Assert.assertTrue(exceptionThrown);
+      } finally {
+         for (ByteBuffer buffer : buffers) {
+            LibaioContext.freeBuffer(buffer);
+         }
+         LibaioContext.freeBuffer(bigbuffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testCallbackSlots() throws Exception {
+      control.close();
+      control = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true, LibaioContext.CONTEXT_CALLBACK_SLOTS, -1);
+
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+
+      File file = temporaryFolder.newFile("test.bin");
+
+      fillupFile(file, LIBAIO_QUEUE_SIZE);
+
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(file, true);
+
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+      try {
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'S');
+         }
+
+         // every slot is used more than once
+         for (int round = 0; round < 3; round++) {
+            TestInfo[] submitted = new TestInfo[LIBAIO_QUEUE_SIZE];
+            for (int i = 0; i < LIBAIO_QUEUE_SIZE; i++) {
+               submitted[i] = new TestInfo();
+               fileDescriptor.write(i * 4096, 4096, buffer, submitted[i]);
+            }
+
+            Assert.assertEquals(LIBAIO_QUEUE_SIZE, control.poll(callbacks, LIBAIO_QUEUE_SIZE, LIBAIO_QUEUE_SIZE));
+
+            HashSet<TestInfo> polled = new HashSet<>();
+            for (TestInfo callback : callbacks) {
+               Assert.assertFalse(callback.isError());
+               polled.add(callback);
+            }
+            for (TestInfo callback : submitted) {
+               Assert.assertTrue(polled.contains(callback));
+            }
+         }
+
+         TestInfo errorCallback = new TestInfo();
+         // odd positions will have failures through O_DIRECT
+         fileDescriptor.read(3, 4096, buffer, errorCallback);
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(errorCallback, callbacks[0]);
+         Assert.assertTrue(callbacks[0].isError());
+         Assert.assertNotNull(callbacks[0].getErrorMessage());
+
+         buffer.rewind();
+         TestInfo readCallback = new TestInfo();
+         fileDescriptor.read(0, 4096, buffer, readCallback);
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(readCallback, callbacks[0]);
+
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals('S', buffer.get());
+         }
+
+         callbacks = null;
+         errorCallback = null;
+         readCallback = null;
+
+         TestInfo.checkLeaks();
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testCallbackSlotsBlockedPoll() throws Exception {
+      final LibaioContext<SubmitInfo> blockedContext = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true, LibaioContext.CONTEXT_CALLBACK_SLOTS, -1);
+      Thread t = new Thread() {
+         @Override
+         public void run() {
+            blockedContext.poll();
+         }
+      };
+
+      t.start();
+
+      int NUMBER_OF_BLOCKS = LIBAIO_QUEUE_SIZE * 10;
+
+      final CountDownLatch latch = new CountDownLatch(NUMBER_OF_BLOCKS + 1);
+
+      File file = temporaryFolder.newFile("sub-file.txt");
+      LibaioFile<SubmitInfo> aioFile = blockedContext.openFile(file, true);
+      aioFile.fill(aioFile.getBlockSize(), NUMBER_OF_BLOCKS * 4096);
+
+      final AtomicInteger errors = new AtomicInteger(0);
+      final AtomicInteger messages = new AtomicInteger(0);
+
+      class MyCallback implements SubmitInfo {
+
+         @Override
+         public void onError(int errno, String message) {
+            errors.incrementAndGet();
+            if (message != null && !message.isEmpty()) {
+               messages.incrementAndGet();
+            }
+         }
+
+         @Override
+         public void done() {
+            latch.countDown();
+         }
+      }
+
+      MyCallback callback = new MyCallback();
+
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+      try {
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'a');
+         }
+
+         for (int i = 0; i < NUMBER_OF_BLOCKS; i++) {
+            aioFile.write(i * 4096, 4096, buffer, callback);
+         }
+
+         // odd positions will have failures through O_DIRECT, done is still called
+         aioFile.write(3, 4096, buffer, callback);
+
+         Assert.assertTrue(latch.await(10, TimeUnit.SECONDS));
+         Assert.assertEquals(1, errors.get());
+         // the error message is produced on the Java side from the errno
+         Assert.assertEquals(1, messages.get());
+      } finally {
+         blockedContext.close();
+         t.join();
+         LibaioContext.freeBuffer(buffer);
+      }
+   }
+
+   @Test
+   public void testEventFd() throws Exception {
+      Assert.assertEquals(-1, control.getEventFd());
+
+      LibaioContext<TestInfo> eventContext = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true, LibaioContext.CONTEXT_EVENTFD, -1);
+      LibaioFile<TestInfo> fileDescriptor = eventContext.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      try {
+         Assert.assertTrue(eventContext.getEventFd() >= 0);
+
+         // nothing to reap, and it doesn't block
+         Assert.assertEquals(0, eventContext.pollReady(callbacks));
+
+         TestInfo callback = new TestInfo();
+         fileDescriptor.write(0, 4096, buffer, callback);
+
+         int reaped = 0;
+         long deadline = System.currentTimeMillis() + 5000;
+         while (reaped == 0 && System.currentTimeMillis() < deadline) {
+            reaped = eventContext.pollReady(callbacks);
+         }
+         Assert.assertEquals(1, reaped);
+         Assert.assertSame(callback, callbacks[0]);
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+         eventContext.close();
+      }
+   }
+
+   @Test
+   public void testSequentialReader() throws Exception {
+      final int blocks = 11;
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      try {
+         for (int i = 0; i < blocks; i++) {
+            buffer.clear();
+            while (buffer.hasRemaining()) {
+               buffer.put((byte) ('a' + i));
+            }
+            fileDescriptor.writeSync(i * 4096L, 4096, buffer);
+         }
+
+         // 2 blocks per chunk: the last chunk is a single block
+         try (LibaioSequentialReader reader = fileDescriptor.newSequentialReader(8192, 3)) {
+            Assert.assertEquals(blocks * 4096L, reader.getSize());
+            int block = 0;
+            ByteBuffer chunk;
+            while ((chunk = reader.next()) != null) {
+               Assert.assertEquals(block * 4096L, reader.position());
+               Assert.assertEquals(block == blocks - 1 ? 4096 : 8192, chunk.remaining());
+               while (chunk.hasRemaining()) {
+                  Assert.assertEquals((byte) ('a' + block + chunk.position() / 4096), chunk.get());
+               }
+               block += 2;
+            }
+            Assert.assertEquals(blocks + 1, block);
+            Assert.assertNull(reader.next());
+         }
+
+         // the chunks follow the alignment of the file
+         int alignment = fileDescriptor.getAlignment().getPreferredAlignment();
+         try {
+            fileDescriptor.newSequentialReader(alignment / 2, 3);
+            Assert.fail("the chunk size is not a multiple of " + alignment);
+         } catch (IllegalArgumentException expected) {
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testOrderedDelivery() throws Exception {
+      control.close();
+      control = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true, LibaioContext.CONTEXT_ORDERED, -1);
+
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      TestInfo[] submitted = new TestInfo[LIBAIO_QUEUE_SIZE];
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(64 * 1024, 4096);
+      try {
+         for (int i = 0; i < LIBAIO_QUEUE_SIZE; i++) {
+            submitted[i] = new TestInfo();
+            // mixing sizes, so the kernel is more likely to complete them out of order
+            fileDescriptor.write(i * 64 * 1024L, i % 2 == 0 ? 64 * 1024 : 4096, buffer, submitted[i]);
+         }
+
+         int delivered = 0;
+         while (delivered < LIBAIO_QUEUE_SIZE) {
+            int reaped = control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE);
+            for (int i = 0; i < reaped; i++) {
+               Assert.assertSame(submitted[delivered++], callbacks[i]);
+            }
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testTimedPoll() throws Exception {
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      try {
+         // nothing in flight: it gives up at the deadline
+         long start = System.nanoTime();
+         Assert.assertEquals(0, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE, TimeUnit.MILLISECONDS.toNanos(50)));
+         Assert.assertTrue(System.nanoTime() - start >= TimeUnit.MILLISECONDS.toNanos(40));
+
+         TestInfo callback = new TestInfo();
+         fileDescriptor.write(0, 4096, buffer, callback);
+
+         // it returns what completed, even if it's fewer than min
+         int reaped = 0;
+         for (int i = 0; i < 100 && reaped == 0; i++) {
+            reaped = control.poll(callbacks, 2, LIBAIO_QUEUE_SIZE, TimeUnit.MILLISECONDS.toNanos(50));
+         }
+         Assert.assertEquals(1, reaped);
+         Assert.assertSame(callback, callbacks[0]);
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testInFlightLimit() throws Exception {
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      try {
+         Assert.assertTrue(fileDescriptor.setInFlightLimit(1));
+
+         TestInfo callback = new TestInfo();
+         Assert.assertEquals(LibaioContext.SUBMIT_OK, fileDescriptor.tryWrite(0, 4096, buffer, callback));
+         Assert.assertEquals(LibaioContext.SUBMIT_FILE_LIMIT, fileDescriptor.tryWrite(4096, 4096, buffer, new TestInfo()));
+
+         try {
+            fileDescriptor.write(4096, 4096, buffer, new TestInfo());
+            Assert.fail("the file is at its limit");
+         } catch (IOException expected) {
+         }
+
+         // with a wait it parks until it gives up, as nothing completes while this thread is submitting
+         control.setAdmissionControl(10, TimeUnit.MILLISECONDS.toNanos(20));
+         long start = System.nanoTime();
+         Assert.assertEquals(LibaioContext.SUBMIT_FILE_LIMIT, fileDescriptor.tryWrite(4096, 4096, buffer, new TestInfo()));
+         Assert.assertTrue(System.nanoTime() - start >= TimeUnit.MILLISECONDS.toNanos(15));
+         control.setAdmissionControl(0, 0);
+
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(callback, callbacks[0]);
+
+         // a batch takes a slot for every write or none of them
+         try {
+            fileDescriptor.writeBatch(new long[]{4096, 8192}, new int[]{4096, 4096}, new ByteBuffer[]{buffer, buffer},
+                                      new TestInfo[]{new TestInfo(), new TestInfo()}, 2);
+            Assert.fail("the batch is over the limit of the file");
+         } catch (IOException expected) {
+         }
+
+         // the completion gave the slot back
+         Assert.assertEquals(LibaioContext.SUBMIT_OK, fileDescriptor.tryWrite(4096, 4096, buffer, callback));
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertFalse(callback.error);
+
+         // a vectored submit refused for its heap buffer gives its slot back to this file
+         try {
+            fileDescriptor.writev(0, new ByteBuffer[]{buffer, ByteBuffer.allocate(4096)}, new TestInfo());
+            Assert.fail("a heap buffer can't be submitted");
+         } catch (RuntimeException expected) {
+         }
+         Assert.assertEquals(LibaioContext.SUBMIT_OK, fileDescriptor.tryWrite(4096, 4096, buffer, callback));
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertFalse(callback.error);
+
+         // a control file has no context to be limited on
+         LibaioFile controlFile = LibaioContext.openControlFile(temporaryFolder.newFile("control.bin").getAbsolutePath(), false);
+         try {
+            Assert.assertFalse(controlFile.setInFlightLimit(1));
+         } finally {
+            controlFile.close();
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testWriteChain() throws Exception {
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4 * 4096, 4096);
+      try {
+         for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4096; j++) {
+               buffer.put((byte) ('a' + i));
+            }
+         }
+         buffer.rewind();
+
+         // three records, their sync, then the commit record
+         ByteBuffer[] buffers = new ByteBuffer[4];
+         long[] positions = new long[4];
+         for (int i = 0; i < 4; i++) {
+            buffer.limit((i + 1) * 4096).position(i * 4096);
+            buffers[i] = buffer.slice();
+            positions[i] = i * 4096L;
+         }
+         buffer.clear();
+
+         TestInfo callback = new TestInfo();
+         fileDescriptor.writeChain(positions, buffers, 3, callback);
+
+         // a single completion for the whole chain
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(callback, callbacks[0]);
+         Assert.assertFalse(callback.error);
+
+         ByteBuffer read = LibaioContext.newAlignedBuffer(4 * 4096, 4096);
+         try {
+            TestInfo readCallback = new TestInfo();
+            fileDescriptor.read(0, 4 * 4096, read, readCallback);
+            Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+            for (int i = 0; i < 4 * 4096; i++) {
+               Assert.assertEquals((byte) ('a' + i / 4096), read.get(i));
+            }
+         } finally {
+            LibaioContext.freeBuffer(read);
+         }
+
+         try {
+            fileDescriptor.writeChain(positions, buffers, 5, new TestInfo());
+            Assert.fail("the barrier is after the last write");
+         } catch (IOException expected) {
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testFillReserve() throws Exception {
+      control.close();
+      control = new LibaioContext<>(2, true, true);
+      Assert.assertEquals(2, LibaioContext.getTotalMaxIO());
+
+      TestInfo[] callbacks = new TestInfo[2];
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      ByteBuffer[] buffers = new ByteBuffer[] {buffer, buffer, buffer};
+      long[] positions = new long[] {0, 4096, 8192};
+      try {
+         LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+         try {
+            // the three writes and the sync don't fit on a queue of 2 without the reserve
+            fileDescriptor.writeChain(positions, buffers, 2, new TestInfo());
+            Assert.fail("the chain needs more iocbs than the queue has");
+         } catch (IOException expected) {
+         } finally {
+            fileDescriptor.close();
+         }
+         control.close();
+
+         control = new LibaioContext<>(2, true, true, LibaioContext.CONTEXT_FILL_RESERVE, -1);
+         Assert.assertEquals(2 + LibaioContext.FILL_IOCBS, LibaioContext.getTotalMaxIO());
+         fileDescriptor = control.openFile(temporaryFolder.newFile("test2.bin"), true);
+         try {
+            TestInfo callback = new TestInfo();
+            fileDescriptor.writeChain(positions, buffers, 2, callback);
+            Assert.assertEquals(1, control.poll(callbacks, 1, 2));
+            Assert.assertSame(callback, callbacks[0]);
+            Assert.assertFalse(callback.error);
+         } finally {
+            fileDescriptor.close();
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+      }
+   }
+
+   @Test
+   public void testLockedMemory() throws Exception {
+      control.close();
+      control = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true, LibaioContext.CONTEXT_HUGE_PAGES, -1);
+
+      // honoring RLIMIT_MEMLOCK, it is either everything (the events and the slab, on huge pages) or nothing
+      long locked = control.getLockedBytes();
+      Assert.assertTrue(String.valueOf(locked), locked == 0 || locked >= 2 * 1024 * 1024);
+
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      try {
+         for (int i = 0; i < LIBAIO_QUEUE_SIZE; i++) {
+            fileDescriptor.write(i * 4096L, 4096, buffer, new TestInfo());
+         }
+         int reaped = 0;
+         while (reaped < LIBAIO_QUEUE_SIZE) {
+            reaped += control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE);
+         }
+         for (TestInfo callback : callbacks) {
+            Assert.assertFalse(callback.error);
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
+
+   @Test
+   public void testAlignment() throws Exception {
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      try {
+         BlockAlignment alignment = fileDescriptor.getAlignment();
+         Assert.assertEquals(fileDescriptor.getBlockSize(), alignment.getFileSystemBlockSize());
+
+         int minimum = alignment.getMinimumAlignment();
+         Assert.assertTrue(alignment.toString(), minimum > 0 && Integer.bitCount(minimum) == 1);
+         Assert.assertTrue(alignment.toString(), alignment.getPreferredAlignment() >= minimum);
+
+         // the file was opened with O_DIRECT, so a write at the minimum alignment needs to work
+         ByteBuffer buffer = LibaioContext.newAlignedBuffer(Math.max(minimum, 4096), Math.max(minimum, 4096));
+         try {
+            TestInfo callback = new TestInfo();
+            fileDescriptor.write(minimum, minimum, buffer, callback);
+            TestInfo[] callbacks = new TestInfo[1];
+            Assert.assertEquals(1, control.poll(callbacks, 1, 1));
+            Assert.assertFalse(callback.error);
+         } finally {
+            LibaioContext.freeBuffer(buffer);
+         }
+      } finally {
+         fileDescriptor.close();
+      }
+
+      try {
+         control.openDevice(temporaryFolder.newFile("notADevice.bin").getPath(), true);
+         Assert.fail("a regular file is not a block device");
+      } catch (IOException expected) {
+      }
+   }
+
+   @Test
+   public void testMappedFile() throws Exception {
+      File file = temporaryFolder.newFile("test.bin");
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(file, false);
+      try {
+         LibaioMappedFile mapped = fileDescriptor.map(2 * 4096);
+         try {
+            // preallocated to the size of the mapping
+            Assert.assertEquals(2 * 4096, fileDescriptor.getSize());
 
-         TestInfo callback = new TestInfo();
-         TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+            ByteBuffer view = mapped.getBuffer();
+            for (int i = 0; i < 100; i++) {
+               view.put(i * 10, (byte) ('a' + i % 26));
+               mapped.written(i * 10, 1);
+            }
+            view.putLong(4096, 42L);
+            mapped.written(4096, Long.BYTES);
+            mapped.commit();
 
-         for (int i = 0; i < LIBAIO_QUEUE_SIZE / 2; i++) {
-            for (LibaioFile file : fileDescriptor) {
-               file.write(i * 4096, 4096, buffer, callback);
+            mapped.startFlush(0, 4096);
+            mapped.flush(0, 4096);
+
+            try {
+               mapped.written(2 * 4096 - 1, 2);
+               Assert.fail("out of the mapping");
+            } catch (IndexOutOfBoundsException expected) {
             }
+         } finally {
+            mapped.close();
          }
 
-         Assert.assertEquals(LIBAIO_QUEUE_SIZE, control.poll(callbacks, LIBAIO_QUEUE_SIZE, LIBAIO_QUEUE_SIZE));
+         byte[] content = Files.readAllBytes(file.toPath());
+         Assert.assertEquals(2 * 4096, content.length);
+         for (int i = 0; i < 100; i++) {
+            Assert.assertEquals((byte) ('a' + i % 26), content[i * 10]);
+         }
+         Assert.assertEquals(42L, ByteBuffer.wrap(content, 4096, Long.BYTES).getLong());
+      } finally {
+         fileDescriptor.close();
+      }
+   }
 
-         for (Object returnedCallback : callbacks) {
-            Assert.assertSame(returnedCallback, callback);
+   @Test
+   public void testMappedControlFile() throws Exception {
+      File file = temporaryFolder.newFile("control.bin");
+      LibaioFile controlFile = LibaioContext.openControlFile(file.getAbsolutePath(), false);
+      try {
+         LibaioMappedFile mapped = controlFile.map(4096);
+         try {
+            Assert.assertEquals(4096, controlFile.getSize());
+            mapped.getBuffer().putLong(0, 42L);
+            mapped.written(0, Long.BYTES);
+            mapped.commit();
+         } finally {
+            mapped.close();
          }
 
-         for (LibaioFile file : fileDescriptor) {
-            ByteBuffer bigbuffer = LibaioContext.newAlignedBuffer(4096 * 25, 4096);
-            file.read(0, 4096 * 25, bigbuffer, callback);
-            Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         byte[] content = Files.readAllBytes(file.toPath());
+         Assert.assertEquals(42L, ByteBuffer.wrap(content, 0, Long.BYTES).getLong());
+      } finally {
+         controlFile.close();
+      }
+   }
 
-            for (Object returnedCallback : callbacks) {
-               Assert.assertSame(returnedCallback, callback);
-            }
+   @Test
+   public void testBlockedPollBatchWithTimeout() throws Exception {
+      final LibaioContext<SubmitInfo> blockedContext = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true);
 
-            for (int i = 0; i < 4096 * 25; i++) {
-               Assert.assertEquals((byte) 'a', bigbuffer.get());
+      try {
+         blockedContext.poll(4, -1);
+         Assert.fail("a batch needs a timeout");
+      } catch (IllegalArgumentException expected) {
+      }
+
+      Thread t = new Thread() {
+         @Override
+         public void run() {
+            blockedContext.poll(4, TimeUnit.MILLISECONDS.toNanos(10));
+         }
+      };
+      t.start();
+
+      LibaioFile<SubmitInfo> aioFile = blockedContext.openFile(temporaryFolder.newFile("test.bin"), true);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      try {
+         final CountDownLatch latch = new CountDownLatch(1);
+         aioFile.write(0, 4096, buffer, new SubmitInfo() {
+            @Override
+            public void onError(int errno, String message) {
             }
 
-            LibaioContext.freeBuffer(bigbuffer);
+            @Override
+            public void done() {
+               latch.countDown();
+            }
+         });
 
-            file.close();
-         }
+         // a single completion is still delivered, once the batch times out
+         Assert.assertTrue(latch.await(5, TimeUnit.SECONDS));
       } finally {
+         aioFile.close();
+         blockedContext.close();
          LibaioContext.freeBuffer(buffer);
       }
+
+      t.join(5000);
+      Assert.assertFalse(t.isAlive());
    }
 
    @Test
-   public void testSubmitWriteAndRead() throws Exception {
-      TestInfo callback = new TestInfo();
-
+   public void testStats() throws Exception {
       TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
-
-      LibaioFile fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
-
-      // ByteBuffer buffer = ByteBuffer.allocateDirect(4096);
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
       ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
-
       try {
-         for (int i = 0; i < 4096; i++) {
-            buffer.put((byte) 'a');
+         Assert.assertEquals(0, control.getStats().getWrites());
+         control.setStatsEnabled(true);
+
+         for (int i = 0; i < LIBAIO_QUEUE_SIZE; i++) {
+            fileDescriptor.write(i * 4096, 4096, buffer, new TestInfo());
          }
+         Assert.assertEquals(LIBAIO_QUEUE_SIZE, control.poll(callbacks, LIBAIO_QUEUE_SIZE, LIBAIO_QUEUE_SIZE));
 
-         buffer.rewind();
+         fileDescriptor.read(0, 4096, buffer, new TestInfo());
+         Assert.assertEquals(1, control.poll(callbacks, 1, 1));
 
-         fileDescriptor.write(0, 4096, buffer, callback);
+         LibaioStats stats = control.getStats();
+         Assert.assertEquals(LIBAIO_QUEUE_SIZE, stats.getWrites());
+         Assert.assertEquals(1, stats.getReads());
+         Assert.assertEquals(0, stats.getInFlightWrites());
+         Assert.assertEquals(0, stats.getInFlightReads());
+         Assert.assertTrue(stats.getMaxInFlight() >= 1);
+         Assert.assertTrue(stats.getRingReaps() + stats.getSyscallReaps() >= 2);
+         Assert.assertEquals(LIBAIO_QUEUE_SIZE, LongStream.of(stats.getWriteHistogram()).sum());
+         Assert.assertEquals(1, LongStream.of(stats.getReadHistogram()).sum());
+         Assert.assertTrue(stats.getWritePercentile(99) > 0);
+         Assert.assertTrue(stats.getWritePercentile(99) <= stats.getWriteNanos());
+      } finally {
+         control.setStatsEnabled(false);
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
 
-         int retValue = control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE);
-         Assert.assertEquals(1, retValue);
+   @Test
+   public void testStatsBuckets() {
+      Assert.assertEquals(0, LibaioStats.bucketLowerBound(0));
+      Assert.assertEquals(4, LibaioStats.bucketLowerBound(4));
+      Assert.assertEquals(8, LibaioStats.bucketLowerBound(8));
+      Assert.assertEquals(10, LibaioStats.bucketLowerBound(9));
+      for (int i = 1; i < LibaioStats.getBuckets(); i++) {
+         Assert.assertTrue(LibaioStats.bucketLowerBound(i) > LibaioStats.bucketLowerBound(i - 1));
+      }
+   }
 
-         Assert.assertSame(callback, callbacks[0]);
+   @Test
+   public void testHybridPoll() throws Exception {
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
 
-         LibaioContext.freeBuffer(buffer);
+      File file = temporaryFolder.newFile("test.bin");
 
-         buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+      fillupFile(file, LIBAIO_QUEUE_SIZE);
+
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(file, true);
 
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+      try {
          for (int i = 0; i < 4096; i++) {
-            buffer.put((byte) 'B');
+            buffer.put((byte) 'h');
          }
 
-         fileDescriptor.write(0, 4096, buffer, null);
-
+         // nothing is counted while the hybrid poll is disabled
+         fileDescriptor.write(0, 4096, buffer, new TestInfo());
          Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertEquals(0, control.getSpinHits() + control.getParks());
 
-         buffer.rewind();
+         control.setHybridPoll(0, TimeUnit.MILLISECONDS.toNanos(100));
 
-         fileDescriptor.read(0, 4096, buffer, null);
+         for (int i = 0; i < 10; i++) {
+            fileDescriptor.write(i * 4096, 4096, buffer, new TestInfo());
+            Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+            Assert.assertFalse(callbacks[0].isError());
+         }
 
+         // unless the kernel completed the write before the poll, every poll is either a hit or a park
+         Assert.assertTrue(control.getSpinHits() + control.getParks() <= 10);
+
+         control.setHybridPoll(0, 0);
+         long spinHits = control.getSpinHits();
+         long parks = control.getParks();
+         fileDescriptor.write(0, 4096, buffer, new TestInfo());
          Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertEquals(spinHits, control.getSpinHits());
+         Assert.assertEquals(parks, control.getParks());
 
-         for (int i = 0; i < 4096; i++) {
-            Assert.assertEquals('B', buffer.get());
+         boolean exceptionThrown = false;
+         try {
+            control.setHybridPoll(-1, 0);
+         } catch (IllegalArgumentException expected) {
+            exceptionThrown = true;
          }
+         Assert.assertTrue(exceptionThrown);
       } finally {
          LibaioContext.freeBuffer(buffer);
          fileDescriptor.close();
@@ -277,11 +1342,20 @@ public class LibaioTest {
    }
 
    @Test
-   /**
-    * This file is making use of libaio without O_DIRECT
-    * We won't need special buffers on this case.
-    */ public void testSubmitWriteAndReadRegularBuffers() throws Exception {
-      TestInfo callback = new TestInfo();
+   public void testIoUringEngine() throws Exception {
+      Assume.assumeTrue(LibaioContext.isIoUringSupported());
+
+      int previousEngine = LibaioContext.getDefaultEngine();
+      Assert.assertEquals(LibaioContext.ENGINE_IO_URING, LibaioContext.setDefaultEngine(LibaioContext.ENGINE_IO_URING));
+
+      control.close();
+      try {
+         control = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true);
+      } finally {
+         LibaioContext.setDefaultEngine(previousEngine);
+      }
+
+      Assert.assertEquals(LibaioContext.ENGINE_IO_URING, control.getEngine());
 
       TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
 
@@ -289,47 +1363,154 @@ public class LibaioTest {
 
       fillupFile(file, LIBAIO_QUEUE_SIZE);
 
-      LibaioFile fileDescriptor = control.openFile(file, false);
-
-      final int BUFFER_SIZE = 50;
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(file, true);
 
-      ByteBuffer buffer = ByteBuffer.allocateDirect(BUFFER_SIZE);
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
 
       try {
-         for (int i = 0; i < BUFFER_SIZE; i++) {
-            buffer.put((byte) 'a');
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'u');
+         }
+
+         for (int i = 0; i < LIBAIO_QUEUE_SIZE; i++) {
+            fileDescriptor.write(i * 4096, 4096, buffer, new TestInfo());
          }
+         Assert.assertEquals(LIBAIO_QUEUE_SIZE, control.poll(callbacks, LIBAIO_QUEUE_SIZE, LIBAIO_QUEUE_SIZE));
+         for (TestInfo callback : callbacks) {
+            Assert.assertFalse(callback.isError());
+         }
+
+         TestInfo errorCallback = new TestInfo();
+         // odd positions will have failures through O_DIRECT
+         fileDescriptor.read(3, 4096, buffer, errorCallback);
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(errorCallback, callbacks[0]);
+         Assert.assertTrue(callbacks[0].isError());
 
          buffer.rewind();
+         TestInfo readCallback = new TestInfo();
+         fileDescriptor.read((LIBAIO_QUEUE_SIZE - 1) * 4096, 4096, buffer, readCallback);
+         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertSame(readCallback, callbacks[0]);
+         Assert.assertFalse(readCallback.isError());
 
-         fileDescriptor.write(0, BUFFER_SIZE, buffer, callback);
+         for (int i = 0; i < 4096; i++) {
+            Assert.assertEquals('u', buffer.get());
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+         fileDescriptor.close();
+      }
+   }
 
-         int retValue = control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE);
-         logger.debug("Return from poll::" + retValue);
-         Assert.assertEquals(1, retValue);
+   @Test
+   public void testIoUringRegisteredBuffersAndFiles() throws Exception {
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(8192, 4096);
+      try {
+         if (control.getEngine() == LibaioContext.ENGINE_LIBAIO) {
+            // nothing to register on libaio
+            Assert.assertFalse(control.registerBuffers(buffer));
+         }
+      } finally {
+         LibaioContext.freeBuffer(buffer);
+      }
 
-         Assert.assertSame(callback, callbacks[0]);
+      Assume.assumeTrue(LibaioContext.isIoUringSupported());
 
-         buffer.rewind();
+      int previousEngine = LibaioContext.getDefaultEngine();
+      LibaioContext.setDefaultEngine(LibaioContext.ENGINE_IO_URING);
+      control.close();
+      try {
+         control = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true);
+      } finally {
+         LibaioContext.setDefaultEngine(previousEngine);
+      }
 
-         for (int i = 0; i < BUFFER_SIZE; i++) {
-            buffer.put((byte) 'B');
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(temporaryFolder.newFile("test.bin"), true);
+      buffer = LibaioContext.newAlignedBuffer(8192, 4096);
+      ByteBuffer unregistered = LibaioContext.newAlignedBuffer(4096, 4096);
+      try {
+         try {
+            Assume.assumeTrue(control.registerBuffers(buffer));
+         } catch (IOException e) {
+            // RLIMIT_MEMLOCK could be too low for it on older kernels
+            Assume.assumeNoException(e);
          }
+         Assert.assertTrue(fileDescriptor.register());
+         Assert.assertTrue(fileDescriptor.register());
 
-         fileDescriptor.write(0, BUFFER_SIZE, buffer, null);
+         for (int i = 0; i < 8192; i++) {
+            buffer.put((byte) (i < 4096 ? 'a' : 'b'));
+         }
+         for (int i = 0; i < 4096; i++) {
+            unregistered.put((byte) 'c');
+         }
 
+         // the second half of the registered buffer, and a buffer that isn't registered at all
+         ByteBuffer half = buffer.duplicate();
+         half.position(4096);
+         fileDescriptor.write(0, 4096, half.slice(), new TestInfo());
+         fileDescriptor.write(4096, 4096, unregistered, new TestInfo());
+         Assert.assertEquals(2, control.poll(callbacks, 2, LIBAIO_QUEUE_SIZE));
+         Assert.assertFalse(callbacks[0].isError());
+         Assert.assertFalse(callbacks[1].isError());
+
+         buffer.clear();
+         fileDescriptor.read(0, 8192, buffer, new TestInfo());
          Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+         Assert.assertFalse(callbacks[0].isError());
+         for (int i = 0; i < 8192; i++) {
+            Assert.assertEquals(i < 4096 ? 'b' : 'c', buffer.get());
+         }
 
-         buffer.rewind();
+         control.unregisterBuffers();
+      } finally {
+         fileDescriptor.close();
+         LibaioContext.freeBuffer(buffer);
+         LibaioContext.freeBuffer(unregistered);
+      }
+   }
 
-         fileDescriptor.read(0, 50, buffer, null);
+   @Test
+   public void testDurableWrite() throws Exception {
+      TestInfo[] callbacks = new TestInfo[LIBAIO_QUEUE_SIZE];
 
-         Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+      File file = temporaryFolder.newFile("test.bin");
 
-         for (int i = 0; i < BUFFER_SIZE; i++) {
-            Assert.assertEquals('B', buffer.get());
+      fillupFile(file, LIBAIO_QUEUE_SIZE);
+
+      LibaioFile<TestInfo> fileDescriptor = control.openFile(file, true);
+
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+      try {
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'd');
+         }
+
+         for (int i = 0; i < LIBAIO_QUEUE_SIZE; i++) {
+            // mixing durable and regular writes on the same file
+            fileDescriptor.write(i * 4096, 4096, buffer, new TestInfo(), i % 2 == 0);
+         }
+
+         Assert.assertEquals(LIBAIO_QUEUE_SIZE, control.poll(callbacks, LIBAIO_QUEUE_SIZE, LIBAIO_QUEUE_SIZE));
+         for (TestInfo callback : callbacks) {
+            Assert.assertFalse(callback.isError());
+         }
+
+         ByteBuffer bigbuffer = LibaioContext.newAlignedBuffer(4096 * LIBAIO_QUEUE_SIZE, 4096);
+         try {
+            fileDescriptor.read(0, 4096 * LIBAIO_QUEUE_SIZE, bigbuffer, new TestInfo());
+            Assert.assertEquals(1, control.poll(callbacks, 1, LIBAIO_QUEUE_SIZE));
+            for (int i = 0; i < 4096 * LIBAIO_QUEUE_SIZE; i++) {
+               Assert.assertEquals('d', bigbuffer.get());
+            }
+         } finally {
+            LibaioContext.freeBuffer(bigbuffer);
          }
       } finally {
+         LibaioContext.freeBuffer(buffer);
          fileDescriptor.close();
       }
    }
@@ -691,6 +1872,73 @@ public class LibaioTest {
       t.join();
    }
 
+   @Test
+   public void testGroupCommit() throws Exception {
+      final LibaioContext<SubmitInfo> blockedContext = new LibaioContext<>(LIBAIO_QUEUE_SIZE, true, true);
+      Thread t = new Thread() {
+         @Override
+         public void run() {
+            blockedContext.poll();
+         }
+      };
+
+      t.start();
+
+      int NUMBER_OF_BLOCKS = LIBAIO_QUEUE_SIZE * 4;
+
+      File file1 = temporaryFolder.newFile("group1.bin");
+      File file2 = temporaryFolder.newFile("group2.bin");
+      LibaioFile<SubmitInfo>[] files = new LibaioFile[]{blockedContext.openFile(file1, true), blockedContext.openFile(file2, true)};
+      for (LibaioFile<SubmitInfo> file : files) {
+         file.fill(file.getBlockSize(), NUMBER_OF_BLOCKS * 4096);
+      }
+
+      final CountDownLatch latch = new CountDownLatch(NUMBER_OF_BLOCKS * files.length);
+      final AtomicInteger errors = new AtomicInteger(0);
+
+      SubmitInfo callback = new SubmitInfo() {
+         @Override
+         public void onError(int errno, String message) {
+            errors.incrementAndGet();
+         }
+
+         @Override
+         public void done() {
+            latch.countDown();
+         }
+      };
+
+      ByteBuffer buffer = LibaioContext.newAlignedBuffer(4096, 4096);
+
+      try {
+         for (int i = 0; i < 4096; i++) {
+            buffer.put((byte) 'g');
+         }
+
+         // the completions of both files are interleaved
+         for (int i = 0; i < NUMBER_OF_BLOCKS; i++) {
+            for (LibaioFile<SubmitInfo> file : files) {
+               file.write(i * 4096, 4096, buffer, callback);
+            }
+         }
+
+         Assert.assertTrue(latch.await(10, TimeUnit.SECONDS));
+         Assert.assertEquals(0, errors.get());
+
+         // at most one sync per file per round of completions
+         long syncs = blockedContext.getSyncs();
+         Assert.assertTrue(syncs > 0);
+         Assert.assertTrue(syncs <= NUMBER_OF_BLOCKS * files.length);
+      } finally {
+         blockedContext.close();
+         t.join();
+         for (LibaioFile<SubmitInfo> file : files) {
+            file.close();
+         }
+         LibaioContext.freeBuffer(buffer);
+      }
+   }
+
    private void fillupFile(File file, int blocks) throws IOException {
       FileOutputStream fileOutputStream = new FileOutputStream(file);
       byte[] bufferWrite = new byte[4096];